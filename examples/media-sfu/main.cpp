@@ -51,19 +51,13 @@ int main() {
 
 		track->setMediaHandler(std::make_shared<rtc::RtcpReceivingSession>());
 
+		// The router consumes RTP packets from the publisher and forwards them to subscribers
+		auto router = std::make_shared<rtc::Router>();
+		router->addPublisher(track);
+
+		track->onMessage([](rtc::binary var) {}, nullptr);
+
 		const rtc::SSRC targetSSRC = 42;
-		track->onMessage(
-		    [&receivers, targetSSRC](rtc::binary message) {
-			    // This is an RTP packet
-			    auto rtp = reinterpret_cast<rtc::RtpHeader *>(message.data());
-			    rtp->setSsrc(targetSSRC);
-			    for (auto pc : receivers) {
-				    if (pc->track != nullptr && pc->track->isOpen()) {
-					    pc->track->send(message);
-				    }
-			    }
-		    },
-		    nullptr);
 
 		pc->setLocalDescription();
 
@@ -100,8 +94,10 @@ int main() {
 
 			r->track = r->conn->addTrack(media);
 
-			r->track->onOpen([r]() {
-				r->track->requestKeyframe(); // So the receiver can start playing immediately
+			r->track->onOpen([router, publisher = track, wtrack = std::weak_ptr(r->track)]() {
+				// A keyframe is requested so the receiver can start playing immediately
+				if (auto subscriber = wtrack.lock())
+					router->subscribe(subscriber, publisher);
 			});
 			r->track->onMessage([](rtc::binary var) {}, nullptr);
 
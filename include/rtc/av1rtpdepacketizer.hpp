@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_AV1_RTP_DEPACKETIZER_H
+#define RTC_AV1_RTP_DEPACKETIZER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+#include "videortpdepacketizer.hpp"
+
+namespace rtc {
+
+/// RTP depacketization for AV1
+/// Frames are output as temporal units in low overhead bitstream format, starting with a temporal
+/// delimiter and with a size field in every OBU, as expected by AV1RtpPacketizer.
+class RTC_CPP_EXPORT AV1RtpDepacketizer final : public VideoRtpDepacketizer {
+public:
+	AV1RtpDepacketizer(Output output = Output::Contiguous);
+
+private:
+	bool isFrameStart(const message_ptr &packet) const override;
+	void depacketize(const std::vector<message_ptr> &packets,
+	                 impl::FrameAssembler &assembler) const override;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif /* RTC_AV1_RTP_DEPACKETIZER_H */
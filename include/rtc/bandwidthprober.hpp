@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_BANDWIDTH_PROBER_H
+#define RTC_BANDWIDTH_PROBER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "mediahandler.hpp"
+#include "rtppacketizationconfig.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace rtc {
+
+// Bandwidth probing, to quickly discover the available capacity instead of slowly ramping up.
+// A probe is a short cluster of padding-only RTP packets sent at a target bitrate in addition to
+// media. A PacingHandler in the chain sends the cluster at its bitrate without delaying media,
+// and a TransportCcSender measures its delivery rate from feedback, raises the estimation
+// accordingly, and reports the discovered capacity with onProbeResult().
+//
+// Probes take sequence numbers from the packetizer configuration, so the handler must directly
+// follow the packetizer. The cluster is sent along with the next outgoing frame.
+class RTC_CPP_EXPORT BandwidthProber final : public MediaHandler {
+public:
+	static const size_t MinClusterPackets = 5;
+	static const size_t MaxClusterPackets = 200;
+
+	BandwidthProber(shared_ptr<RtpPacketizationConfig> rtpConfig,
+	                std::chrono::milliseconds clusterDuration = std::chrono::milliseconds(15));
+
+	// Request a probe cluster at the bitrate in bits per second
+	void probe(unsigned int bitrate);
+
+	void outgoing(message_vector &messages, const message_callback &send) override;
+
+private:
+	const shared_ptr<RtpPacketizationConfig> mRtpConfig;
+	const std::chrono::milliseconds mClusterDuration;
+
+	std::mutex mMutex;
+	std::vector<unsigned int> mPending;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif // RTC_BANDWIDTH_PROBER_H
@@ -63,6 +63,14 @@ enum class CertificateType {
 
 enum class TransportPolicy { All = RTC_TRANSPORT_POLICY_ALL, Relay = RTC_TRANSPORT_POLICY_RELAY };
 
+// DTLS-SRTP protection profiles, see RFC 5764 and RFC 7714
+enum class SrtpProfile {
+	Aes128CmHmacSha1_80, // mandatory, always offered
+	Aes128CmHmacSha1_32,
+	AeadAes128Gcm, // OpenSSL and GnuTLS only, requires libSRTP with GCM support
+	AeadAes256Gcm  // OpenSSL and GnuTLS only, requires libSRTP with GCM support
+};
+
 struct RTC_CPP_EXPORT Configuration {
 	// ICE settings
 	std::vector<IceServer> iceServers;
@@ -89,6 +97,10 @@ struct RTC_CPP_EXPORT Configuration {
 	// Local maximum message size for Data Channels
 	optional<size_t> maxMessageSize;
 
+	// SRTP protection profiles in order of preference, empty for default (AES-GCM first)
+	// Unsupported profiles are skipped, AES128_CM_HMAC_SHA1_80 is always offered as last resort
+	std::vector<SrtpProfile> srtpProfiles;
+
 	// Certificates and private keys
 	optional<string> certificatePemFile;
 	optional<string> keyPemFile;
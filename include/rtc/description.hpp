@@ -120,6 +120,7 @@ public:
 		};
 
 		std::vector<int> extIds();
+		std::vector<int> extIds() const;
 		ExtMap *extMap(int id);
 		const ExtMap *extMap(int id) const;
 		void addExtMap(ExtMap map);
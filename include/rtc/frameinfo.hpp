@@ -17,6 +17,15 @@ struct RTC_CPP_EXPORT FrameInfo {
 	FrameInfo(uint8_t payloadType, uint32_t timestamp) : payloadType(payloadType), timestamp(timestamp){};
 	uint8_t payloadType; // Indicates codec of the frame
 	uint32_t timestamp = 0; // RTP Timestamp
+
+	// Frame data as a list of slices referencing the received buffers, only filled when the
+	// depacketizer is set to output slices instead of a contiguous copy
+	struct Slice {
+		binary_ptr buffer;
+		size_t offset;
+		size_t size;
+	};
+	std::vector<Slice> slices;
 };
 
 } // namespace rtc
@@ -36,8 +36,8 @@ RTC_CPP_EXPORT std::shared_future<void> Cleanup();
 
 struct SctpSettings {
 	// For the following settings, not set means optimized default
-	optional<size_t> recvBufferSize;                // in bytes
-	optional<size_t> sendBufferSize;                // in bytes
+	optional<size_t> recvBufferSize;                // in bytes, max size as buffers grow on demand
+	optional<size_t> sendBufferSize;                // in bytes, max size as buffers grow on demand
 	optional<size_t> maxChunksOnQueue;              // in chunks
 	optional<size_t> initialCongestionWindow;       // in MTUs
 	optional<size_t> maxBurst;                      // in MTUs
@@ -52,6 +52,37 @@ struct SctpSettings {
 
 RTC_CPP_EXPORT void SetSctpSettings(SctpSettings s);
 
+struct CertificateCacheSettings {
+	// Number of certificates to keep pre-generated in the background for each certificate type in
+	// use, 0 means certificates are generated on demand
+	size_t poolSize = 0;
+	// Duration during which a certificate is shared between PeerConnections before being rotated,
+	// zero means each PeerConnection gets its own certificate
+	std::chrono::milliseconds lifetime = std::chrono::milliseconds::zero();
+};
+
+struct CertificateCacheStats {
+	size_t hits = 0;   // certificates taken from the pool or shared
+	size_t misses = 0; // certificates generated on demand
+};
+
+RTC_CPP_EXPORT void SetCertificateCacheSettings(CertificateCacheSettings s);
+RTC_CPP_EXPORT CertificateCacheStats GetCertificateCacheStats();
+
+// DTLS handshakes and certificate generation run on a dedicated pool, so the count of threads is
+// the max number of concurrent handshakes. Not set means half the hardware concurrency. It is
+// applied on next initialization.
+RTC_CPP_EXPORT void SetCryptoConcurrency(int count);
+
+struct CryptoStats {
+	size_t tasks = 0;   // tasks executed on the crypto pool
+	size_t pending = 0; // tasks currently queued
+	std::chrono::microseconds averageQueueWait = std::chrono::microseconds::zero();
+	std::chrono::microseconds maxQueueWait = std::chrono::microseconds::zero();
+};
+
+RTC_CPP_EXPORT CryptoStats GetCryptoStats();
+
 RTC_CPP_EXPORT std::ostream &operator<<(std::ostream &out, LogLevel level);
 
 } // namespace rtc
@@ -13,32 +13,26 @@
 #if RTC_ENABLE_MEDIA
 
 #include "common.hpp"
-#include "mediahandler.hpp"
-#include "message.hpp"
 #include "nalunit.hpp"
-#include "rtp.hpp"
-
-#include <iterator>
+#include "videortpdepacketizer.hpp"
 
 namespace rtc {
 
 /// RTP depacketization for H264
-class RTC_CPP_EXPORT H264RtpDepacketizer : public MediaHandler {
+class RTC_CPP_EXPORT H264RtpDepacketizer : public VideoRtpDepacketizer {
 public:
 	using Separator = NalUnit::Separator;
 
-	H264RtpDepacketizer(Separator separator = Separator::LongStartSequence);
+	H264RtpDepacketizer(Separator separator = Separator::LongStartSequence,
+	                    Output output = Output::Contiguous);
 	virtual ~H264RtpDepacketizer() = default;
 
-	void incoming(message_vector &messages, const message_callback &send) override;
-
 private:
-	std::vector<message_ptr> mRtpBuffer;
-	const NalUnit::Separator mSeparator;
+	bool isFrameStart(const message_ptr &packet) const override;
+	void depacketize(const std::vector<message_ptr> &packets,
+	                 impl::FrameAssembler &assembler) const override;
 
-	void addSeparator(binary &accessUnit);
-	message_vector buildFrames(message_vector::iterator firstPkt, message_vector::iterator lastPkt,
-	                           uint8_t payloadType, uint32_t timestamp);
+	const Separator mSeparator;
 };
 
 } // namespace rtc
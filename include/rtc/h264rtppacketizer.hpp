@@ -42,7 +42,11 @@ public:
 	void outgoing(message_vector &messages, const message_callback &send) override;
 
 private:
-	shared_ptr<NalUnits> splitMessage(binary_ptr message);
+	// Send units in a single packet, as an STAP-A if there are more than one
+	void aggregate(const binary &frame, const NalUnitView *units, size_t count, bool mark,
+	               message_vector &result);
+	// Send a unit larger than the maximum fragment size as fragmentation units, in place
+	void fragment(const byte *nalu, size_t size, bool mark, message_vector &result);
 
 	const uint16_t maxFragmentSize;
 	const Separator separator;
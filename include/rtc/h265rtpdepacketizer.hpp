@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_H265_RTP_DEPACKETIZER_H
+#define RTC_H265_RTP_DEPACKETIZER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+#include "h265nalunit.hpp"
+#include "videortpdepacketizer.hpp"
+
+namespace rtc {
+
+/// RTP depacketization for H265 (RFC 7798)
+class RTC_CPP_EXPORT H265RtpDepacketizer final : public VideoRtpDepacketizer {
+public:
+	using Separator = NalUnit::Separator;
+
+	H265RtpDepacketizer(Separator separator = Separator::LongStartSequence,
+	                    Output output = Output::Contiguous);
+
+private:
+	bool isFrameStart(const message_ptr &packet) const override;
+	void depacketize(const std::vector<message_ptr> &packets,
+	                 impl::FrameAssembler &assembler) const override;
+
+	const Separator mSeparator;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif /* RTC_H265_RTP_DEPACKETIZER_H */
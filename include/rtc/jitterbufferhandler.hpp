@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_JITTER_BUFFER_HANDLER_H
+#define RTC_JITTER_BUFFER_HANDLER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "mediahandler.hpp"
+#include "rtp.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rtc {
+
+// Receiving-side handler reordering RTP packets by sequence number and requesting missing ones
+// with NACKs. It should be placed before depacketizers. Packets are held at most maxDelay while
+// waiting for missing ones, then missing packets are considered lost. Since handlers only run
+// on traffic, held packets are released when the next incoming packet or RTCP report arrives.
+// If the sequence number jumps by more than the window, or a run of packets arrives behind the
+// released ones, for instance when the sender restarts, the stream is resynchronized.
+class RTC_CPP_EXPORT JitterBufferHandler final : public MediaHandler {
+public:
+	static const size_t DefaultWindowSize = 512;
+	static constexpr std::chrono::milliseconds DefaultMaxDelay{200};
+	static const unsigned int MaxNackRetries = 10;
+	static const unsigned int MaxLatePackets = 16; // consecutive, before resynchronizing
+
+	JitterBufferHandler(std::chrono::milliseconds maxDelay = DefaultMaxDelay,
+	                    size_t windowSize = DefaultWindowSize);
+
+	// NACKs for the same packet are retried once per round-trip time
+	void setRoundTripTime(std::chrono::milliseconds rtt);
+
+	// If RTX (RFC 4588) is negotiated, RTX packets are unwrapped to the original stream
+	void media(const Description::Media &desc) override;
+	void incoming(message_vector &messages, const message_callback &send) override;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Slot {
+		message_ptr message;
+		uint16_t sequenceNumber = 0;
+		bool missing = false;
+		clock::time_point time; // arrival, or detection if missing
+		clock::time_point nacked;
+		unsigned int retries = 0;
+	};
+
+	struct Stream {
+		std::vector<Slot> slots;
+		bool started = false;
+		uint16_t next = 0;     // next sequence number to release
+		uint16_t highest = 0;  // highest received sequence number
+		unsigned int late = 0; // consecutive packets behind next
+	};
+
+	Slot &slot(Stream &stream, uint16_t sequenceNumber) const {
+		return stream.slots[sequenceNumber % stream.slots.size()];
+	}
+
+	bool unwrapRtx(message_ptr &message);
+	void push(Stream &stream, message_ptr message, clock::time_point now, message_vector &out);
+	void reset(Stream &stream, uint16_t sequenceNumber, message_vector &out);
+	void release(Stream &stream, clock::time_point now, message_vector &out);
+	message_ptr makeNack(SSRC ssrc, Stream &stream, clock::time_point now);
+
+	const std::chrono::milliseconds mMaxDelay;
+	const size_t mWindowSize;
+
+	std::mutex mMutex;
+	std::unordered_map<SSRC, Stream> mStreams;
+	std::unordered_map<uint8_t, uint8_t> mRtxPayloadTypes; // original payload type by RTX one
+	std::unordered_map<SSRC, SSRC> mRtxSsrcs;              // media SSRC by RTX SSRC
+	std::chrono::milliseconds mRoundTripTime;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif // RTC_JITTER_BUFFER_HANDLER_H
@@ -38,7 +38,10 @@ public:
 	virtual bool requestKeyframe(const message_callback &send);
 	virtual bool requestBitrate(unsigned int bitrate, const message_callback &send);
 
-	void addToChain(shared_ptr<MediaHandler> handler);
+	/// Returns the target bitrate estimated for sending, if a handler in the chain estimates it
+	virtual optional<unsigned int> targetBitrate() const;
+
+	void addToChain(shared_ptr<MediaHandler> handler); // no-op if already in the chain
 	void setNext(shared_ptr<MediaHandler> handler);
 	shared_ptr<MediaHandler> next();
 	shared_ptr<const MediaHandler> next() const;
@@ -61,6 +61,13 @@ enum NalUnitStartSequenceMatch {
 
 static const size_t H264_NAL_HEADER_SIZE = 1;
 static const size_t H265_NAL_HEADER_SIZE = 2;
+
+/// Location of a NAL unit inside a buffer, without separator
+struct RTC_CPP_EXPORT NalUnitView {
+	size_t offset;
+	size_t size;
+};
+
 /// Nal unit
 struct RTC_CPP_EXPORT NalUnit : binary {
 	enum class Type { H264, H265 };
@@ -102,6 +109,11 @@ struct RTC_CPP_EXPORT NalUnit : binary {
 		StartSequence = RTC_NAL_SEPARATOR_START_SEQUENCE, // LongStartSequence or ShortStartSequence
 	};
 
+	/// Locate the NAL units in a buffer without copying them
+	/// @note For start sequence separators, any 0x00 0x00 0x01 sequence ends the current unit,
+	/// and trailing zero bytes before it are not part of the unit.
+	static std::vector<NalUnitView> Split(const binary &data, Separator separator);
+
 	static NalUnitStartSequenceMatch StartSequenceMatchSucc(NalUnitStartSequenceMatch match,
 	                                                        std::byte _byte, Separator separator) {
 		assert(separator != Separator::Length);
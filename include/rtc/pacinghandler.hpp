@@ -12,34 +12,96 @@
 #if RTC_ENABLE_MEDIA
 
 #include "mediahandler.hpp"
+#include "rtp.hpp"
 #include "utils.hpp"
 
-#include <atomic>
-#include <queue>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace rtc {
 
 // Paced sending of RTP packets. It takes a stream of RTP packets that can have an uneven bitrate
-// and delivers them in a smoother manner by sending a fixed size of them on an interval
+// and delivers them in a smoother manner, in bursts of at most sendInterval worth of data.
+//
+// Packets are queued by priority: audio first, then retransmissions, video, and padding last.
+// Streams are classified from the media descriptions, RTX streams being identified with
+// "ssrc-group:FID" attributes or RTX payload types. The rate can be changed at any time, for
+// instance from the estimation of a TransportCcSender. Video, retransmissions and padding queued
+// for longer than the maximum queue delay, if set, are dropped, whole frames at a time for video.
+// Probes generated by a BandwidthProber are sent at the bitrate of their cluster with a separate
+// budget, after media, so they do not delay it.
+//
+// The same instance may be shared by the tracks of a peer connection so they are paced
+// together. Handlers following it in the chain process packets when they are released, outside
+// of the internal lock. As there is a single chain after it, when the instance is shared, the
+// handlers following it must be the same for all tracks, like a shared TransportCcSender. Chains
+// may be built the same way for all tracks, as adding a handler already in the chain does nothing.
 class RTC_CPP_EXPORT PacingHandler : public MediaHandler {
 public:
-	PacingHandler(double bitsPerSecond, std::chrono::milliseconds sendInterval);
+	enum class Priority { Audio = 0, Retransmission = 1, Video = 2, Padding = 3 };
 
+	PacingHandler(double bitsPerSecond, std::chrono::microseconds sendInterval);
+
+	// Change the pacing rate in bits per second
+	void setBitrate(double bitsPerSecond);
+	double bitrate() const;
+
+	// Set the maximum time packets other than audio can wait in queue, 0 means no limit. The
+	// default is no limit. Dropped packets are not retransmitted by a preceding
+	// RtcpNackResponder.
+	void setMaxQueueDelay(std::chrono::milliseconds delay);
+
+	// Total size of queued packets in bytes
+	size_t queuedBytes() const;
+
+	void media(const Description::Media &desc) override;
 	void outgoing(message_vector &messages, const message_callback &send) override;
 
 private:
-	std::atomic<bool> mHaveScheduled = false;
+	using clock = std::chrono::steady_clock;
 
+	struct Entry {
+		message_ptr message;
+		shared_ptr<message_callback> send;
+		clock::time_point time;
+		uint32_t probeCluster = 0;
+		unsigned int probeBitrate = 0; // 0 if not a probe
+	};
+
+	Priority classify(const message_ptr &message) const;
+	void process(clock::time_point now);
+	bool sendProbe(clock::time_point now);
+	size_t sendFront(Priority priority);
+	void dropStale(clock::time_point now);
+	void flush();
+	void release(Entry entry);
+	void schedule(clock::time_point time);
+
+	mutable std::mutex mMutex;
 	double mBytesPerSecond;
-	double mBudget;
+	double mBudget = 0.; // in bytes, may be negative after a packet over budget
+	const std::chrono::microseconds mSendInterval;
+	std::chrono::milliseconds mMaxQueueDelay;
+	clock::time_point mLastRun;
+	optional<clock::time_point> mScheduled;
+
+	double mProbeBudget = 0.; // in bytes, for the current probe cluster
+	clock::time_point mProbeLastRun;
+	optional<uint32_t> mProbeCluster;
 
-	std::chrono::milliseconds mSendInterval;
-	std::chrono::time_point<std::chrono::high_resolution_clock> mLastRun;
+	std::array<std::deque<Entry>, 4> mQueues; // indexed by priority
+	size_t mQueuedBytes = 0;
 
-	std::mutex mMutex;
-	std::queue<message_ptr> mRtpBuffer;
+	std::vector<Entry> mReleased; // sent by flush() once the lock is released
+	bool mFlushing = false;
 
-	void schedule(const message_callback &send);
+	std::unordered_map<SSRC, Priority> mStreamPriorities;
+	std::unordered_set<uint8_t> mRtxPayloadTypes;
 };
 
 } // namespace rtc
@@ -75,6 +75,17 @@ public:
 		HaveRemotePranswer = RTC_SIGNALING_HAVE_REMOTE_PRANSWER,
 	};
 
+	// Resources currently held by the connection
+	struct Footprint {
+		size_t dataChannels = 0;
+		size_t tracks = 0;
+		bool sctpTransport = false;    // SCTP is started only once a DataChannel needs it
+		size_t sctpSendBufferSize = 0; // SCTP buffers grow on demand
+		size_t sctpRecvBufferSize = 0;
+		size_t bufferedAmount = 0;  // bytes waiting to be sent on DataChannels
+		size_t availableAmount = 0; // bytes received but not read yet
+	};
+
 	PeerConnection();
 	PeerConnection(Configuration config);
 	~PeerConnection();
@@ -125,6 +136,7 @@ public:
 	size_t bytesSent();
 	size_t bytesReceived();
 	optional<std::chrono::milliseconds> rtt();
+	Footprint footprint();
 };
 
 RTC_CPP_EXPORT std::ostream &operator<<(std::ostream &out, PeerConnection::State state);
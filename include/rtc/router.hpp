@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_ROUTER_H
+#define RTC_ROUTER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+#include "rtp.hpp"
+#include "track.hpp"
+
+#include <chrono>
+
+namespace rtc {
+
+namespace impl {
+
+struct Router;
+
+}
+
+// Selective forwarding of RTP streams from publisher tracks to subscriber tracks, as in an SFU.
+//
+// Packets are forwarded without depacketizing. The SSRC, sequence number, timestamp, and payload
+// type are rewritten so each subscriber receives a continuous stream, including when it is
+// switched to another publisher or another simulcast layer. Header extensions are removed as
+// their IDs are negotiated separately on each side. A packet is rewritten once for all
+// subscribers with the same output and fanned out with Track::Fanout.
+//
+// Keyframe requests (PLI or FIR) from subscribers are aggregated and sent to the publisher at most
+// once per keyframe request interval.
+//
+// The router inserts a handler at the beginning of the media handler chains of the tracks. RTP
+// packets received on publisher tracks are consumed by the router, so their chains must not
+// depacketize. Subscribers should have an RtcpNackResponder to answer retransmission requests.
+// They should not have an RtcpSrReporter, as the router doesn't maintain the RTP timestamp of its
+// configuration, so reports would map the forwarded timestamps to the wrong wallclock time.
+class RTC_CPP_EXPORT Router final : private CheshireCat<impl::Router> {
+public:
+	Router(std::chrono::milliseconds keyframeRequestInterval = std::chrono::milliseconds(500));
+	~Router();
+
+	void addPublisher(shared_ptr<Track> track);
+	void removePublisher(shared_ptr<Track> track);
+
+	// Subscribe the track to the publisher, or switch it if it is already subscribed. If layer is
+	// set, only the stream with this SSRC is forwarded, for instance a simulcast layer. A keyframe
+	// is requested and the subscriber switches when it starts. The stream is sent with the first
+	// SSRC of the subscriber track description.
+	void subscribe(shared_ptr<Track> subscriber, shared_ptr<Track> publisher,
+	               optional<SSRC> layer = nullopt);
+	void unsubscribe(shared_ptr<Track> subscriber);
+
+	// Request a keyframe from the publisher, subject to rate limiting
+	void requestKeyframe(shared_ptr<Track> publisher);
+
+private:
+	using CheshireCat<impl::Router>::impl;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif // RTC_ROUTER_H
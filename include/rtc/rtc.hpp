@@ -28,15 +28,22 @@
 #if RTC_ENABLE_MEDIA
 
 // Media
+#include "av1rtpdepacketizer.hpp"
 #include "av1rtppacketizer.hpp"
 #include "h264rtppacketizer.hpp"
 #include "h264rtpdepacketizer.hpp"
+#include "h265rtpdepacketizer.hpp"
 #include "h265rtppacketizer.hpp"
 #include "mediahandler.hpp"
 #include "plihandler.hpp"
 #include "rembhandler.hpp"
+#include "transportccsender.hpp"
+#include "transportccreceiver.hpp"
+#include "bandwidthprober.hpp"
+#include "router.hpp"
 #include "pacinghandler.hpp"
 #include "rtcpnackresponder.hpp"
+#include "jitterbufferhandler.hpp"
 #include "rtcpreceivingsession.hpp"
 #include "rtcpsrreporter.hpp"
 #include "rtppacketizer.hpp"
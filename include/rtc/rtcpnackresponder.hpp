@@ -12,9 +12,12 @@
 #if RTC_ENABLE_MEDIA
 
 #include "mediahandler.hpp"
+#include "rtp.hpp"
 
-#include <queue>
+#include <chrono>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace rtc {
 
@@ -22,51 +25,78 @@ class RTC_CPP_EXPORT RtcpNackResponder final : public MediaHandler {
 public:
 	static const size_t DefaultMaxSize = 512;
 
-	RtcpNackResponder(size_t maxSize = DefaultMaxSize);
+	// maxSize is the number of packets kept for retransmission, maxBytes optionally limits the
+	// total size of kept packets (0 means no limit)
+	RtcpNackResponder(size_t maxSize = DefaultMaxSize, size_t maxBytes = 0);
 
+	// Limit the bitrate of retransmissions in bits per second, 0 means no limit. Retransmissions
+	// exceeding the budget are skipped, the peer will request them again.
+	void setMaxRetransmissionBitrate(unsigned int bitrate);
+
+	// If RTX (RFC 4588) is negotiated, with an RTX payload type with "apt=" and an
+	// "ssrc-group:FID" attribute, retransmissions are sent on the RTX stream. Retransmissions go
+	// through the handlers following this one in the outgoing chain, like a PacingHandler.
+	void media(const Description::Media &desc) override;
 	void incoming(message_vector &messages, const message_callback &send) override;
 	void outgoing(message_vector &messages, const message_callback &send) override;
 
 private:
-	// Packet storage
-	class RTC_CPP_EXPORT Storage {
-
-		/// Packet storage element
-		struct RTC_CPP_EXPORT Element {
-			Element(binary_ptr packet, uint16_t sequenceNumber, shared_ptr<Element> next = nullptr);
-			const binary_ptr packet;
-			const uint16_t sequenceNumber;
-			/// Pointer to newer element
-			shared_ptr<Element> next = nullptr;
-		};
+	using clock = std::chrono::steady_clock;
 
-	private:
-		/// Oldest packet in storage
-		shared_ptr<Element> oldest = nullptr;
-		/// Newest packet in storage
-		shared_ptr<Element> newest = nullptr;
-		/// Inner storage
-		std::unordered_map<uint16_t, shared_ptr<Element>> storage{};
-		std::mutex mutex;
+	struct RtxStream {
+		SSRC ssrc;
+		uint16_t sequenceNumber;
+	};
 
-		/// Maximum storage size
-		const size_t maxSize;
+	void handleNack(RtcpNack *nack, size_t length, const message_callback &send);
+	void updateRoundTripTime(const RtcpReportBlock *block);
+	bool consumeBudget(size_t size, clock::time_point now);
+	message_ptr makeRtxPacket(const binary_ptr &packet);
 
-		/// Returns current size
-		size_t size();
+	// Packet storage, a fixed-capacity ring indexed by sequence number modulo capacity
+	class RTC_CPP_EXPORT Storage {
+		struct Slot {
+			binary_ptr packet; // null if the slot is empty
+			size_t size = 0;   // stored size, as the packet is emptied if dropped while paced
+			uint16_t sequenceNumber = 0;
+			clock::time_point resent; // last retransmission, default if never resent
+		};
 
 	public:
-		Storage(size_t _maxSize);
+		Storage(size_t maxSize, size_t maxBytes = 0);
+
+		/// Returns packet with given sequence number unless it was resent after notBefore
+		optional<binary_ptr> get(uint16_t sequenceNumber,
+		                         clock::time_point notBefore = clock::time_point::max());
 
-		/// Returns packet with given sequence number
-		optional<binary_ptr> get(uint16_t sequenceNumber);
+		/// Marks packet with given sequence number as resent
+		void setResent(uint16_t sequenceNumber, clock::time_point time);
 
 		/// Stores packet
 		/// @param packet Packet
 		void store(binary_ptr packet);
+
+	private:
+		void evict(Slot &slot);
+
+		std::vector<Slot> mSlots;
+		const size_t mMaxBytes;
+		size_t mBytes = 0;
+		size_t mCount = 0;
+		uint16_t mOldest = 0; // oldest stored sequence number if mCount > 0
+		uint16_t mNewest = 0; // newest stored sequence number if mCount > 0
+		std::mutex mMutex;
 	};
 
 	const shared_ptr<Storage> mStorage;
+
+	std::mutex mMutex;
+	std::unordered_map<SSRC, RtxStream> mRtxStreams;       // by media SSRC
+	std::unordered_map<uint8_t, uint8_t> mRtxPayloadTypes; // by media payload type
+	std::chrono::microseconds mRoundTripTime{0};           // 0 if unknown
+	unsigned int mMaxBitrate = 0;
+	double mBudget = 0.; // in bytes
+	clock::time_point mBudgetTime;
 };
 
 } // namespace rtc
@@ -53,6 +53,9 @@ public:
 	///   3 - 270 degrees
 	uint8_t videoOrientation = 0;
 
+	// Header extensions are written with one-byte headers, or two-byte headers if an ID is above
+	// 14 or a value is longer than 16 bytes (RFC 8285)
+
 	// MID Extension Header
 	uint8_t midId = 0;
 	optional<std::string> mid;
@@ -69,6 +72,16 @@ public:
 	uint16_t playoutDelayMin = 0;
 	uint16_t playoutDelayMax = 0;
 
+	// the negotiated ID of the abs-send-time header extension, the time is set on packetization
+	// then updated on sending by TransportCcSender if present
+	// http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time
+	uint8_t absSendTimeId = 0;
+
+	// the negotiated ID of the transport-wide sequence number header extension, the number is
+	// shared by all tracks so it is only reserved here and written by TransportCcSender
+	// https://datatracker.ietf.org/doc/html/draft-holmer-rmcat-transport-wide-cc-extensions-01
+	uint8_t transportCcId = 0;
+
 	/// Construct RTP configuration used in packetization process
 	/// @param ssrc SSRC of source
 	/// @param cname CNAME of source
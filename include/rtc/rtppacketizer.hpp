@@ -36,13 +36,31 @@ public:
 protected:
 	/// Creates RTP packet for given payload
 	/// @note This function increase sequence number after packetization.
+	/// @deprecated Packetizers don't call this overload anymore, so overriding it has no effect
+	/// on the packets they create. Override the overload below instead.
 	/// @param payload RTP payload
 	/// @param setMark Set marker flag in RTP packet if true
-	virtual message_ptr packetize(shared_ptr<binary> payload, bool mark);
+	[[deprecated("Override the in-place overload instead")]] virtual message_ptr
+	packetize(shared_ptr<binary> payload, bool mark);
+
+	/// Creates RTP packet whose payload is prefix followed by data, read in place
+	/// @note This function increase sequence number after packetization. All packets go through
+	/// it, including the ones created with the overload above, so this is the one to override to
+	/// customize packets. Derived classes overriding it should declare
+	/// `using RtpPacketizer::packetize;` so the other overload stays visible.
+	/// @param prefix Bytes to write before the data, like a fragmentation header
+	/// @param data Payload data, typically a part of the frame being packetized. If null, the
+	/// payload is left for the caller to write in place after the RTP header.
+	/// @param setMark Set marker flag in RTP packet if true
+	virtual message_ptr packetize(const byte *prefix, size_t prefixSize, const byte *data,
+	                              size_t size, bool mark);
 
 private:
 	static const auto RtpHeaderSize = 12;
 	static const auto RtpExtHeaderCvoSize = 8;
+
+	struct HeaderTemplate;
+	unique_ptr<HeaderTemplate> mHeaderTemplate; // rebuilt when the configuration changes
 };
 
 // Generic audio RTP packetizer
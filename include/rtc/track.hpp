@@ -24,6 +24,11 @@ class Track;
 
 class RTC_CPP_EXPORT Track final : private CheshireCat<impl::Track>, public Channel {
 public:
+	// Send the same message on multiple tracks, spreading media handling and encryption over the
+	// thread pool. Messages fanned out are kept in order on each track, however they are not
+	// ordered relatively to messages sent directly with send().
+	static void Fanout(const std::vector<shared_ptr<Track>> &tracks, message_variant data);
+
 	Track(impl_ptr<impl::Track> impl);
 	~Track() override;
 
@@ -46,6 +51,10 @@ public:
 	bool requestKeyframe();
 	bool requestBitrate(unsigned int bitrate);
 
+	// Called with the target bitrate for sending when a media handler estimates it, for instance
+	// TransportCcSender. The estimation is checked on incoming traffic.
+	void onTargetBitrate(std::function<void(unsigned int bitrate)> callback);
+
 	void setMediaHandler(shared_ptr<MediaHandler> handler);
 	void chainMediaHandler(shared_ptr<MediaHandler> handler);
 	shared_ptr<MediaHandler> getMediaHandler();
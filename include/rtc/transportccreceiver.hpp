@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_TRANSPORT_CC_RECEIVER_H
+#define RTC_TRANSPORT_CC_RECEIVER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "mediahandler.hpp"
+#include "rtp.hpp"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace rtc {
+
+// Receiving-side handler for transport-wide congestion control
+// (draft-holmer-rmcat-transport-wide-cc-extensions-01). It records the arrival time of packets
+// carrying a transport-wide sequence number and periodically sends feedback to the sender. Since
+// handlers only run on traffic, feedback is sent when packets arrive. As sequence numbers are
+// shared by all streams of the transport, the same instance should be added at the end of the
+// chains of all receiving tracks of a peer connection.
+class RTC_CPP_EXPORT TransportCcReceiver final : public MediaHandler {
+public:
+	static constexpr std::chrono::milliseconds DefaultFeedbackInterval{100};
+	static const size_t MaxPacketsPerFeedback = 400;
+
+	TransportCcReceiver(std::chrono::milliseconds feedbackInterval = DefaultFeedbackInterval);
+
+	// The extension ID is read from the "extmap" attributes of the media
+	void media(const Description::Media &desc) override;
+	void incoming(message_vector &messages, const message_callback &send) override;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	message_ptr makeFeedback();
+
+	const std::chrono::milliseconds mFeedbackInterval;
+	const clock::time_point mStartTime;
+
+	std::mutex mMutex;
+	int mExtId = 0;
+	std::map<int64_t, std::chrono::microseconds> mArrivals; // by unwrapped sequence number
+	optional<int64_t> mLastSequenceNumber;                   // highest received, unwrapped
+	optional<int64_t> mNextSequenceNumber;                   // first one not reported yet
+	SSRC mMediaSsrc = 0;
+	uint8_t mFeedbackCount = 0;
+	clock::time_point mLastFeedback;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif // RTC_TRANSPORT_CC_RECEIVER_H
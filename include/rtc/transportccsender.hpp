@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_TRANSPORT_CC_SENDER_H
+#define RTC_TRANSPORT_CC_SENDER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "mediahandler.hpp"
+#include "rtp.hpp"
+#include "utils.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace rtc {
+
+namespace impl {
+class BandwidthEstimator;
+}
+
+// Sending-side handler for transport-wide congestion control
+// (draft-holmer-rmcat-transport-wide-cc-extensions-01). It stamps outgoing RTP packets with
+// transport-wide sequence numbers and estimates the available bandwidth from the feedback of the
+// receiver. It also updates the abs-send-time extension if negotiated. It should be the last
+// handler of the chain, after pacing, so send times are accurate. As sequence numbers are shared
+// by all streams of the transport, the same instance should be added at the end of the chains of
+// all sending tracks of a peer connection. After a shared PacingHandler, it is only linked once.
+class RTC_CPP_EXPORT TransportCcSender final : public MediaHandler {
+public:
+	static const unsigned int DefaultInitialBitrate = 300000;
+	static const unsigned int DefaultMinBitrate = 30000;
+	static const unsigned int DefaultMaxBitrate = 10000000;
+	static const size_t HistorySize = 8192;
+
+	TransportCcSender(unsigned int initialBitrate = DefaultInitialBitrate,
+	                  unsigned int minBitrate = DefaultMinBitrate,
+	                  unsigned int maxBitrate = DefaultMaxBitrate);
+	~TransportCcSender();
+
+	// Called when the estimated target bitrate changes
+	void onTargetBitrate(std::function<void(unsigned int bitrate)> callback);
+
+	// Called with the capacity measured by probe clusters, see BandwidthProber
+	void onProbeResult(std::function<void(unsigned int bitrate)> callback);
+
+	optional<unsigned int> targetBitrate() const override;
+
+	// The extension ID is read from the "extmap" attributes of the media
+	void media(const Description::Media &desc) override;
+	void incoming(message_vector &messages, const message_callback &send) override;
+	void outgoing(message_vector &messages, const message_callback &send) override;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Sent {
+		clock::time_point time;
+		size_t size = 0;
+		uint16_t sequenceNumber = 0;
+		bool valid = false;
+		optional<uint32_t> probeCluster;
+	};
+
+	bool stamp(message_ptr &message, uint16_t sequenceNumber);
+	void stampAbsSendTime(message_ptr &message);
+	void processFeedback(const uint8_t *data, size_t size, clock::time_point now);
+
+	mutable std::mutex mMutex;
+	int mExtId = 0;
+	int mAbsSendTimeExtId = 0;
+	uint16_t mSequenceNumber = 0;
+	std::vector<Sent> mHistory; // indexed by sequence number modulo its size
+	unique_ptr<impl::BandwidthEstimator> mEstimator;
+	optional<uint8_t> mLastFeedbackCount;
+	unsigned int mLastTargetBitrate = 0;
+
+	synchronized_callback<unsigned int> mTargetBitrateCallback;
+	synchronized_callback<unsigned int> mProbeResultCallback;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif // RTC_TRANSPORT_CC_SENDER_H
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_VIDEO_RTP_DEPACKETIZER_H
+#define RTC_VIDEO_RTP_DEPACKETIZER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+#include "mediahandler.hpp"
+#include "message.hpp"
+#include "rtp.hpp"
+
+#include <deque>
+
+namespace rtc {
+
+namespace impl {
+class FrameAssembler;
+}
+
+/// Base for depacketizers reassembling frames spread over several RTP packets
+class RTC_CPP_EXPORT VideoRtpDepacketizer : public MediaHandler {
+public:
+	enum class Output {
+		Contiguous, // frame is copied into the message
+		Slices,     // message is empty and FrameInfo::slices reference the received packets
+	};
+
+	virtual ~VideoRtpDepacketizer() = default;
+
+	void incoming(message_vector &messages, const message_callback &send) override;
+
+protected:
+	VideoRtpDepacketizer(Output output);
+
+	// Return the payload bounds of an RTP packet, excluding header and padding
+	static std::pair<size_t, size_t> GetPayload(const message_ptr &packet);
+
+private:
+	struct Frame {
+		uint32_t timestamp;
+		uint8_t payloadType;
+		bool marker = false;
+		std::vector<message_ptr> packets; // sorted by sequence number
+	};
+
+	// Return true if the packet can be the first one of a frame
+	virtual bool isFrameStart(const message_ptr &packet) const = 0;
+	// Add the units contained in the packets of a frame to the assembler
+	virtual void depacketize(const std::vector<message_ptr> &packets,
+	                         impl::FrameAssembler &assembler) const = 0;
+
+	void push(message_ptr packet);
+	bool isComplete(const Frame &frame) const;
+	message_ptr buildFrame(const Frame &frame) const;
+
+	const Output mOutput;
+	std::deque<Frame> mFrames; // sorted by timestamp
+	optional<uint32_t> mLastTimestamp;
+	optional<uint16_t> mLastSequenceNumber;
+	size_t mLatePackets = 0; // in a row
+	bool mMarkerSeen = false;
+};
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif /* RTC_VIDEO_RTP_DEPACKETIZER_H */
@@ -0,0 +1,155 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "av1rtpdepacketizer.hpp"
+
+#include "impl/frameassembler.hpp"
+#include "impl/internals.hpp"
+
+#include <utility>
+
+namespace rtc {
+
+namespace {
+
+// Aggregation header: Z|Y|W W|N|-|-|-
+const uint8_t zMask = 0b10000000;
+const uint8_t yMask = 0b01000000;
+const uint8_t wMask = 0b00110000;
+const uint8_t wBitshift = 4;
+
+// OBU header: 0|type type type type|X|S|0
+const uint8_t obuTypeMask = 0b01111000;
+const uint8_t obuTypeBitshift = 3;
+const uint8_t obuHasExtensionMask = 0b00000100;
+const uint8_t obuHasSizeMask = 0b00000010;
+
+const uint8_t obuTypeTemporalDelimiter = 2;
+const uint8_t obuTypeTileList = 8;
+
+const byte obuTemporalDelimiter[] = {byte(0x12), byte(0x00)};
+
+// Read a LEB128 value (https://aomediacodec.github.io/av1-spec/#leb128), advancing offset
+optional<size_t> ReadLeb128(const message_ptr &packet, size_t &offset, size_t end) {
+	size_t value = 0;
+	for (int i = 0; i < 8 && offset < end; ++i) {
+		auto b = std::to_integer<uint8_t>(packet->at(offset++));
+		value |= size_t(b & 0x7F) << (i * 7);
+		if (!(b & 0x80))
+			return value;
+	}
+	return nullopt;
+}
+
+} // namespace
+
+AV1RtpDepacketizer::AV1RtpDepacketizer(Output output) : VideoRtpDepacketizer(output) {}
+
+bool AV1RtpDepacketizer::isFrameStart(const message_ptr &packet) const {
+	auto [begin, end] = GetPayload(packet);
+	return begin == end || !(std::to_integer<uint8_t>(packet->at(begin)) & zMask);
+}
+
+void AV1RtpDepacketizer::depacketize(const std::vector<message_ptr> &packets,
+                                     impl::FrameAssembler &assembler) const {
+	// The temporal delimiter is generated before the first OBU, so nothing is emitted if all OBUs
+	// are dropped
+	bool delimited = false;
+	auto beginObu = [&]() {
+		if (!std::exchange(delimited, true)) {
+			assembler.beginUnit();
+			assembler.addGenerated(obuTemporalDelimiter, sizeof(obuTemporalDelimiter));
+			assembler.endUnit();
+		}
+		assembler.beginUnit();
+	};
+
+	// OBU elements may be fragmented over packets, dropped OBUs are skipped until they end
+	bool dropping = false;
+	for (const auto &packet : packets) {
+		auto [begin, end] = GetPayload(packet);
+		if (begin == end) {
+			PLOG_VERBOSE << "AV1 RTP packet has empty payload";
+			continue;
+		}
+
+		const uint8_t aggregationHeader = std::to_integer<uint8_t>(packet->at(begin));
+		const bool continuation = aggregationHeader & zMask;
+		const bool continued = aggregationHeader & yMask;
+		const unsigned int count = (aggregationHeader & wMask) >> wBitshift;
+
+		if (!continuation || !assembler.inUnit()) {
+			assembler.endUnit();
+			dropping = continuation; // missing the beginning of the OBU
+		}
+
+		size_t offset = begin + 1;
+		for (unsigned int i = 0; offset < end; ++i) {
+			// With W = 0, all elements are preceded by their length, otherwise all but the last
+			size_t elementSize;
+			if (count == 0 || i + 1 < count) {
+				auto length = ReadLeb128(packet, offset, end);
+				if (!length || *length > end - offset) {
+					PLOG_WARNING << "Invalid AV1 OBU element length";
+					assembler.endUnit();
+					return;
+				}
+				elementSize = *length;
+			} else {
+				elementSize = end - offset;
+			}
+
+			const bool first = i == 0;
+			const bool last = offset + elementSize == end;
+			if (first && continuation) {
+				if (!dropping)
+					assembler.addPayload(packet, offset, elementSize);
+			} else {
+				assembler.endUnit();
+				dropping = false;
+				if (elementSize > 0) {
+					const uint8_t obuHeader = std::to_integer<uint8_t>(packet->at(offset));
+					const uint8_t type = (obuHeader & obuTypeMask) >> obuTypeBitshift;
+					const size_t headerSize = (obuHeader & obuHasExtensionMask) ? 2 : 1;
+
+					// Temporal delimiters are generated, tile lists are to be ignored
+					if (type == obuTypeTemporalDelimiter || type == obuTypeTileList ||
+					    headerSize > elementSize) {
+						dropping = true;
+					} else if (obuHeader & obuHasSizeMask) {
+						beginObu();
+						assembler.addPayload(packet, offset, elementSize);
+					} else {
+						// Set the size flag and insert the size field after the header
+						const byte header[2] = {byte(obuHeader | obuHasSizeMask),
+						                        headerSize > 1 ? packet->at(offset + 1) : byte(0)};
+						beginObu();
+						assembler.addGenerated(header, headerSize);
+						assembler.addLengthField(impl::FrameAssembler::LengthField::Leb128);
+						assembler.addPayload(packet, offset + headerSize,
+						                     elementSize - headerSize);
+					}
+				}
+			}
+
+			offset += elementSize;
+
+			// The last element continues in the next packet only if Y is set
+			if (last && !continued)
+				assembler.endUnit();
+		}
+	}
+
+	assembler.endUnit();
+}
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
@@ -211,10 +211,11 @@ void AV1RtpPacketizer::outgoing(message_vector &messages,
 		if (fragments.size() == 0)
 			continue;
 
-		for (size_t i = 0; i < fragments.size() - 1; i++)
-			result.push_back(packetize(fragments[i], false));
-
-		result.push_back(packetize(fragments[fragments.size() - 1], true));
+		for (size_t i = 0; i < fragments.size(); i++) {
+			const auto &fragment = fragments[i];
+			const bool mark = i + 1 == fragments.size();
+			result.push_back(packetize(nullptr, 0, fragment->data(), fragment->size(), mark));
+		}
 	}
 
 	messages.swap(result);
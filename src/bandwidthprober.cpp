@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "bandwidthprober.hpp"
+
+#include "impl/internals.hpp"
+#include "impl/probepacket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace rtc {
+
+namespace {
+
+// Cluster identifiers are unique among all probers as feedback is transport-wide
+std::atomic<uint32_t> NextCluster = 0;
+
+} // namespace
+
+BandwidthProber::BandwidthProber(shared_ptr<RtpPacketizationConfig> rtpConfig,
+                                 std::chrono::milliseconds clusterDuration)
+    : mRtpConfig(std::move(rtpConfig)), mClusterDuration(clusterDuration) {
+	if (!mRtpConfig)
+		throw std::invalid_argument("RTP configuration is null");
+}
+
+void BandwidthProber::probe(unsigned int bitrate) {
+	if (bitrate == 0)
+		throw std::invalid_argument("Probe bitrate must be positive");
+
+	std::lock_guard lock(mMutex);
+	mPending.push_back(bitrate);
+}
+
+void BandwidthProber::outgoing(message_vector &messages, const message_callback &) {
+	// Probes follow a frame, so they take its timestamp and the next sequence numbers
+	if (std::none_of(messages.begin(), messages.end(),
+	                 [](const message_ptr &m) { return m->type != Message::Control; }))
+		return;
+
+	std::vector<unsigned int> pending;
+	{
+		std::lock_guard lock(mMutex);
+		pending.swap(mPending);
+	}
+
+	const size_t packetSize = sizeof(RtpHeader) + impl::ProbePaddingSize;
+	for (unsigned int bitrate : pending) {
+		const double bytes =
+		    std::chrono::duration<double>(mClusterDuration).count() * double(bitrate) / 8;
+		const size_t count = std::clamp(size_t(bytes / double(packetSize)) + 1,
+		                                MinClusterPackets, MaxClusterPackets);
+
+		const impl::ProbeInfo info{NextCluster++, bitrate};
+		PLOG_DEBUG << "Sending probe cluster " << info.cluster << " at " << bitrate << " bps, "
+		           << count << " packets";
+
+		for (size_t i = 0; i < count; ++i)
+			messages.push_back(impl::MakeProbePacket(mRtpConfig->ssrc, mRtpConfig->payloadType,
+			                                         mRtpConfig->sequenceNumber++,
+			                                         mRtpConfig->timestamp, info));
+	}
+}
+
+} // namespace rtc
+
+#endif /* RTC_ENABLE_MEDIA */
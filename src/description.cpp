@@ -593,6 +593,10 @@ void Description::removeAttribute(const string &attr) {
 }
 
 std::vector<int> Description::Entry::extIds() {
+	return std::as_const(*this).extIds();
+}
+
+std::vector<int> Description::Entry::extIds() const {
 	std::vector<int> result;
 	for (auto it = mExtMaps.begin(); it != mExtMaps.end(); ++it)
 		result.push_back(it->first);
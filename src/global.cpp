@@ -16,7 +16,9 @@
 //
 #include "global.hpp"
 
+#include "impl/certificate.hpp"
 #include "impl/init.hpp"
+#include "impl/threadpool.hpp"
 
 #include <mutex>
 
@@ -88,6 +90,31 @@ std::shared_future<void> Cleanup() { return impl::Init::Instance().cleanup(); }
 
 void SetSctpSettings(SctpSettings s) { impl::Init::Instance().setSctpSettings(std::move(s)); }
 
+void SetCertificateCacheSettings(CertificateCacheSettings s) {
+	impl::CertificateCache::Instance().setSettings(std::move(s));
+}
+
+CertificateCacheStats GetCertificateCacheStats() {
+	return impl::CertificateCache::Instance().stats();
+}
+
+void SetCryptoConcurrency(int count) { impl::Init::Instance().setCryptoConcurrency(count); }
+
+CryptoStats GetCryptoStats() {
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+
+	auto stats = impl::ThreadPool::CryptoInstance().stats();
+	CryptoStats result;
+	result.tasks = stats.executed;
+	result.pending = stats.pending;
+	if (stats.executed > 0)
+		result.averageQueueWait = duration_cast<microseconds>(stats.totalWait) / stats.executed;
+
+	result.maxQueueWait = duration_cast<microseconds>(stats.maxWait);
+	return result;
+}
+
 RTC_CPP_EXPORT std::ostream &operator<<(std::ostream &out, LogLevel level) {
 	switch (level) {
 	case LogLevel::Fatal:
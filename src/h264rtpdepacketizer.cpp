@@ -11,158 +11,101 @@
 #include "h264rtpdepacketizer.hpp"
 #include "nalunit.hpp"
 
+#include "impl/frameassembler.hpp"
 #include "impl/internals.hpp"
 
-#include <algorithm>
-
 namespace rtc {
 
-const binary naluLongStartCode = {byte{0}, byte{0}, byte{0}, byte{1}};
-const binary naluShortStartCode = {byte{0}, byte{0}, byte{1}};
+namespace {
 
 const uint8_t naluTypeSTAPA = 24;
 const uint8_t naluTypeFUA = 28;
 
-H264RtpDepacketizer::H264RtpDepacketizer(Separator separator) : mSeparator(separator) {
+} // namespace
+
+H264RtpDepacketizer::H264RtpDepacketizer(Separator separator, Output output)
+    : VideoRtpDepacketizer(output), mSeparator(separator) {
 	if (separator != Separator::StartSequence && separator != Separator::LongStartSequence &&
-	    separator != Separator::ShortStartSequence) {
+	    separator != Separator::ShortStartSequence && separator != Separator::Length) {
 		throw std::invalid_argument("Invalid separator");
 	}
 }
 
-void H264RtpDepacketizer::addSeparator(binary &accessUnit) {
-	if (mSeparator == Separator::StartSequence || mSeparator == Separator::LongStartSequence) {
-		accessUnit.insert(accessUnit.end(), naluLongStartCode.begin(), naluLongStartCode.end());
-	} else if (mSeparator == Separator::ShortStartSequence) {
-		accessUnit.insert(accessUnit.end(), naluShortStartCode.begin(), naluShortStartCode.end());
-	} else {
-		throw std::invalid_argument("Invalid separator");
-	}
-}
+bool H264RtpDepacketizer::isFrameStart(const message_ptr &packet) const {
+	auto [begin, end] = GetPayload(packet);
+	if (end - begin < 2)
+		return true;
 
-message_vector H264RtpDepacketizer::buildFrames(message_vector::iterator begin,
-                                                message_vector::iterator end, uint8_t payloadType,
-                                                uint32_t timestamp) {
-	message_vector out = {};
-	auto accessUnit = binary{};
-	auto frameInfo = std::make_shared<FrameInfo>(payloadType, timestamp);
-
-	for (auto it = begin; it != end; ++it) {
-		auto pkt = it->get();
-		auto pktParsed = reinterpret_cast<const rtc::RtpHeader *>(pkt->data());
-		auto rtpHeaderSize = pktParsed->getSize() + pktParsed->getExtensionHeaderSize();
-		auto rtpPaddingSize = 0;
-
-		if (pktParsed->padding()) {
-			rtpPaddingSize = std::to_integer<uint8_t>(pkt->at(pkt->size() - 1));
-		}
+	auto nalUnitHeader = NalUnitHeader{std::to_integer<uint8_t>(packet->at(begin))};
+	auto nalUnitFragmentHeader =
+	    NalUnitFragmentHeader{std::to_integer<uint8_t>(packet->at(begin + 1))};
+	return nalUnitHeader.unitType() != naluTypeFUA || nalUnitFragmentHeader.isStart();
+}
 
-		if (pkt->size() == rtpHeaderSize + rtpPaddingSize) {
+void H264RtpDepacketizer::depacketize(const std::vector<message_ptr> &packets,
+                                      impl::FrameAssembler &assembler) const {
+	for (const auto &packet : packets) {
+		auto [begin, end] = GetPayload(packet);
+		if (begin == end) {
 			PLOG_VERBOSE << "H.264 RTP packet has empty payload";
 			continue;
 		}
 
-		auto nalUnitHeader = NalUnitHeader{std::to_integer<uint8_t>(pkt->at(rtpHeaderSize))};
+		auto nalUnitHeader = NalUnitHeader{std::to_integer<uint8_t>(packet->at(begin))};
 
 		if (nalUnitHeader.unitType() == naluTypeFUA) {
+			if (end - begin < sizeof(NalUnitHeader) + sizeof(NalUnitFragmentHeader)) {
+				PLOG_VERBOSE << "H.264 FU-A packet is too small";
+				assembler.endUnit();
+				continue;
+			}
+
 			auto nalUnitFragmentHeader = NalUnitFragmentHeader{
-			    std::to_integer<uint8_t>(pkt->at(rtpHeaderSize + sizeof(NalUnitHeader)))};
+			    std::to_integer<uint8_t>(packet->at(begin + sizeof(NalUnitHeader)))};
 
 			// RFC 6184: When set to one, the Start bit indicates the start of a fragmented NAL
 			// unit. When the following FU payload is not the start of a fragmented NAL unit
 			// payload, the Start bit is set to zero.
-			if (nalUnitFragmentHeader.isStart() || accessUnit.empty()) {
-				addSeparator(accessUnit);
-				accessUnit.emplace_back(
-				    byte(nalUnitHeader.idc() | nalUnitFragmentHeader.unitType()));
+			if (nalUnitFragmentHeader.isStart() || !assembler.inUnit()) {
+				assembler.beginNalUnit(mSeparator);
+				const byte header{uint8_t(nalUnitHeader.idc() | nalUnitFragmentHeader.unitType())};
+				assembler.addGenerated(&header, 1);
 			}
 
-			accessUnit.insert(accessUnit.end(),
-			                  pkt->begin() + rtpHeaderSize + sizeof(NalUnitHeader) +
-			                      sizeof(NalUnitFragmentHeader),
-			                  pkt->end());
+			size_t offset = begin + sizeof(NalUnitHeader) + sizeof(NalUnitFragmentHeader);
+			assembler.addPayload(packet, offset, end - offset);
+			if (nalUnitFragmentHeader.isEnd())
+				assembler.endUnit();
+
 		} else if (nalUnitHeader.unitType() > 0 && nalUnitHeader.unitType() < 24) {
-			addSeparator(accessUnit);
-			accessUnit.insert(accessUnit.end(), pkt->begin() + rtpHeaderSize, pkt->end());
-		} else if (nalUnitHeader.unitType() == naluTypeSTAPA) {
-			auto currOffset = rtpHeaderSize + sizeof(NalUnitHeader);
+			assembler.beginNalUnit(mSeparator);
+			assembler.addPayload(packet, begin, end - begin);
+			assembler.endUnit();
 
-			while (currOffset + sizeof(uint16_t) < pkt->size()) {
-				auto naluSize = std::to_integer<uint16_t>(pkt->at(currOffset)) << 8 |
-				                std::to_integer<uint16_t>(pkt->at(currOffset + 1));
+		} else if (nalUnitHeader.unitType() == naluTypeSTAPA) {
+			size_t offset = begin + sizeof(NalUnitHeader);
+			while (offset + sizeof(uint16_t) < end) {
+				size_t naluSize = std::to_integer<size_t>(packet->at(offset)) << 8 |
+				                  std::to_integer<size_t>(packet->at(offset + 1));
 
-				currOffset += sizeof(uint16_t);
+				offset += sizeof(uint16_t);
 
-				if (pkt->size() < currOffset + naluSize) {
-					throw std::runtime_error("H264 STAP-A declared size is larger than buffer");
+				if (end < offset + naluSize) {
+					PLOG_VERBOSE << "H.264 STAP-A declared size is larger than buffer";
+					break;
 				}
 
-				addSeparator(accessUnit);
-				accessUnit.insert(accessUnit.end(), pkt->begin() + currOffset,
-				                  pkt->begin() + currOffset + naluSize);
-
-				currOffset += naluSize;
+				assembler.beginNalUnit(mSeparator);
+				assembler.addPayload(packet, offset, naluSize);
+				assembler.endUnit();
+				offset += naluSize;
 			}
-		} else {
-			throw std::runtime_error("Unknown H264 RTP Packetization");
-		}
-	}
-
-	if (!accessUnit.empty()) {
-		out.emplace_back(
-		    make_message(std::move(accessUnit), Message::Binary, 0, nullptr, frameInfo));
-	}
 
-	return out;
-}
-
-void H264RtpDepacketizer::incoming(message_vector &messages, const message_callback &) {
-	messages.erase(std::remove_if(messages.begin(), messages.end(),
-	                              [&](message_ptr message) {
-		                              if (message->type == Message::Control) {
-			                              return false;
-		                              }
-
-		                              if (message->size() < sizeof(RtpHeader)) {
-			                              PLOG_VERBOSE << "RTP packet is too small, size="
-			                                           << message->size();
-			                              return true;
-		                              }
-
-		                              mRtpBuffer.push_back(std::move(message));
-		                              return true;
-	                              }),
-	               messages.end());
-
-	while (mRtpBuffer.size() != 0) {
-		uint8_t payload_type = 0;
-		uint32_t current_timestamp = 0;
-		size_t packets_in_timestamp = 0;
-
-		for (const auto &pkt : mRtpBuffer) {
-			auto p = reinterpret_cast<const rtc::RtpHeader *>(pkt->data());
-
-			if (current_timestamp == 0) {
-				current_timestamp = p->timestamp();
-				payload_type =
-				    p->payloadType(); // should all be the same for data of the same codec
-			} else if (current_timestamp != p->timestamp()) {
-				break;
-			}
-
-			packets_in_timestamp++;
-		}
-
-		if (packets_in_timestamp == mRtpBuffer.size()) {
-			break;
+		} else {
+			PLOG_VERBOSE << "Unknown H.264 RTP packetization, type="
+			             << int(nalUnitHeader.unitType());
+			assembler.endUnit();
 		}
-
-		auto begin = mRtpBuffer.begin();
-		auto end = mRtpBuffer.begin() + (packets_in_timestamp - 1);
-
-		auto frames = buildFrames(begin, end + 1, payload_type, current_timestamp);
-		messages.insert(messages.end(), frames.begin(), frames.end());
-		mRtpBuffer.erase(mRtpBuffer.begin(), mRtpBuffer.begin() + packets_in_timestamp);
 	}
 }
 
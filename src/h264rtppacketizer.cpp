@@ -13,74 +13,18 @@
 #include "impl/internals.hpp"
 
 #include <algorithm>
-#include <cassert>
-
-#ifdef _WIN32
-#include <winsock2.h>
-#else
-#include <arpa/inet.h>
-#endif
+#include <cstring>
 
 namespace rtc {
 
-shared_ptr<NalUnits> H264RtpPacketizer::splitMessage(binary_ptr message) {
-	auto nalus = std::make_shared<NalUnits>();
-	if (separator == Separator::Length) {
-		size_t index = 0;
-		while (index < message->size()) {
-			assert(index + 4 < message->size());
-			if (index + 4 >= message->size()) {
-				LOG_WARNING << "Invalid NAL Unit data (incomplete length), ignoring!";
-				break;
-			}
-			uint32_t length;
-			std::memcpy(&length, message->data() + index, sizeof(uint32_t));
-			length = ntohl(length);
-			auto naluStartIndex = index + 4;
-			auto naluEndIndex = naluStartIndex + length;
-
-			assert(naluEndIndex <= message->size());
-			if (naluEndIndex > message->size()) {
-				LOG_WARNING << "Invalid NAL Unit data (incomplete unit), ignoring!";
-				break;
-			}
-			auto begin = message->begin() + naluStartIndex;
-			auto end = message->begin() + naluEndIndex;
-			nalus->push_back(std::make_shared<NalUnit>(begin, end));
-			index = naluEndIndex;
-		}
-	} else {
-		NalUnitStartSequenceMatch match = NUSM_noMatch;
-		size_t index = 0;
-		while (index < message->size()) {
-			match = NalUnit::StartSequenceMatchSucc(match, (*message)[index++], separator);
-			if (match == NUSM_longMatch || match == NUSM_shortMatch) {
-				match = NUSM_noMatch;
-				break;
-			}
-		}
+namespace {
 
-		size_t naluStartIndex = index;
-
-		while (index < message->size()) {
-			match = NalUnit::StartSequenceMatchSucc(match, (*message)[index], separator);
-			if (match == NUSM_longMatch || match == NUSM_shortMatch) {
-				auto sequenceLength = match == NUSM_longMatch ? 4 : 3;
-				size_t naluEndIndex = index - sequenceLength;
-				match = NUSM_noMatch;
-				auto begin = message->begin() + naluStartIndex;
-				auto end = message->begin() + naluEndIndex + 1;
-				nalus->push_back(std::make_shared<NalUnit>(begin, end));
-				naluStartIndex = index + 1;
-			}
-			index++;
-		}
-		auto begin = message->begin() + naluStartIndex;
-		auto end = message->end();
-		nalus->push_back(std::make_shared<NalUnit>(begin, end));
-	}
-	return nalus;
-}
+const uint8_t NalTypeStapA = 24;
+const uint8_t NalTypeFuA = 28;
+const size_t StapAHeaderSize = 1;
+const size_t AggregationLengthSize = 2;
+
+} // namespace
 
 H264RtpPacketizer::H264RtpPacketizer(shared_ptr<RtpPacketizationConfig> rtpConfig,
                                      uint16_t maxFragmentSize)
@@ -94,21 +38,92 @@ H264RtpPacketizer::H264RtpPacketizer(Separator separator,
 
 void H264RtpPacketizer::outgoing(message_vector &messages, [[maybe_unused]] const message_callback &send) {
 	message_vector result;
-	for(const auto &message : messages) {
-		auto nalus = splitMessage(message);
-		auto fragments = nalus->generateFragments(maxFragmentSize);
-		if (fragments.size() == 0)
-			continue;
-
-		for (size_t i = 0; i < fragments.size() - 1; i++)
-			result.push_back(packetize(fragments[i], false));
+	for (const auto &message : messages) {
+		auto nalus = NalUnit::Split(*message, separator);
+
+		// Consecutive small units are aggregated in STAP-A packets (RFC 6184 5.7.1)
+		size_t first = 0;
+		size_t aggregateSize = StapAHeaderSize;
+		for (size_t i = 0; i < nalus.size(); ++i) {
+			const size_t size = nalus[i].size;
+			if (size > maxFragmentSize) {
+				aggregate(*message, nalus.data() + first, i - first, false, result);
+				fragment(message->data() + nalus[i].offset, size, i + 1 == nalus.size(), result);
+				first = i + 1;
+				aggregateSize = StapAHeaderSize;
+				continue;
+			}
 
-		result.push_back(packetize(fragments[fragments.size() - 1], true));
+			if (i > first && aggregateSize + AggregationLengthSize + size > maxFragmentSize) {
+				aggregate(*message, nalus.data() + first, i - first, false, result);
+				first = i;
+				aggregateSize = StapAHeaderSize;
+			}
+			aggregateSize += AggregationLengthSize + size;
+		}
+		aggregate(*message, nalus.data() + first, nalus.size() - first, true, result);
 	}
 
 	messages.swap(result);
 }
 
+void H264RtpPacketizer::aggregate(const binary &frame, const NalUnitView *units, size_t count,
+                                  bool mark, message_vector &result) {
+	if (count == 0)
+		return;
+
+	if (count == 1) {
+		const auto &unit = units[0];
+		result.push_back(packetize(nullptr, 0, frame.data() + unit.offset, unit.size, mark));
+		return;
+	}
+
+	// The STAP-A header has the highest NRI and the forbidden bit if any unit has it
+	uint8_t header = NalTypeStapA;
+	size_t size = StapAHeaderSize;
+	for (size_t i = 0; i < count; ++i) {
+		const uint8_t unitHeader = std::to_integer<uint8_t>(frame[units[i].offset]);
+		header |= unitHeader & 0x80;
+		header = uint8_t((header & 0x9F) | std::max(header & 0x60, unitHeader & 0x60));
+		size += AggregationLengthSize + units[i].size;
+	}
+
+	// Write the aggregation directly in the packet
+	auto message = packetize(nullptr, 0, nullptr, size, mark);
+	auto p = reinterpret_cast<byte *>(reinterpret_cast<RtpHeader *>(message->data())->getBody());
+	*p++ = byte(header);
+	for (size_t i = 0; i < count; ++i) {
+		*p++ = byte(units[i].size >> 8);
+		*p++ = byte(units[i].size & 0xFF);
+		std::memcpy(p, frame.data() + units[i].offset, units[i].size);
+		p += units[i].size;
+	}
+
+	result.push_back(std::move(message));
+}
+
+void H264RtpPacketizer::fragment(const byte *nalu, size_t size, bool mark,
+                                 message_vector &result) {
+	// Fragments have roughly the same size, 2 bytes are used for FU indicator and FU header
+	const size_t count = (size + maxFragmentSize - 1) / maxFragmentSize;
+	const size_t fragmentSize = std::max((size + count - 1) / count, size_t(3)) - 2;
+
+	const uint8_t header = std::to_integer<uint8_t>(nalu[0]);
+	const byte indicator = byte((header & 0xE0) | NalTypeFuA); // F and NRI from the unit
+	const byte *payload = nalu + H264_NAL_HEADER_SIZE;
+	const size_t payloadSize = size - H264_NAL_HEADER_SIZE;
+	size_t offset = 0;
+	while (offset < payloadSize) {
+		const size_t length = std::min(fragmentSize, payloadSize - offset);
+		const bool start = offset == 0;
+		const bool end = offset + length == payloadSize;
+		const byte prefix[2] = {indicator,
+		                        byte((start ? 0x80 : 0) | (end ? 0x40 : 0) | (header & 0x1F))};
+		result.push_back(packetize(prefix, sizeof(prefix), payload + offset, length, mark && end));
+		offset += length;
+	}
+}
+
 } // namespace rtc
 
 #endif /* RTC_ENABLE_MEDIA */
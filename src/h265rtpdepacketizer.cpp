@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "h265rtpdepacketizer.hpp"
+
+#include "impl/frameassembler.hpp"
+#include "impl/internals.hpp"
+
+namespace rtc {
+
+namespace {
+
+const uint8_t naluTypeAP = 48;
+const uint8_t naluTypeFU = 49;
+
+H265NalUnitHeader ReadHeader(const message_ptr &packet, size_t offset) {
+	H265NalUnitHeader header;
+	header._first = std::to_integer<uint8_t>(packet->at(offset));
+	header._second = std::to_integer<uint8_t>(packet->at(offset + 1));
+	return header;
+}
+
+} // namespace
+
+H265RtpDepacketizer::H265RtpDepacketizer(Separator separator, Output output)
+    : VideoRtpDepacketizer(output), mSeparator(separator) {
+	if (separator != Separator::StartSequence && separator != Separator::LongStartSequence &&
+	    separator != Separator::ShortStartSequence && separator != Separator::Length) {
+		throw std::invalid_argument("Invalid separator");
+	}
+}
+
+bool H265RtpDepacketizer::isFrameStart(const message_ptr &packet) const {
+	auto [begin, end] = GetPayload(packet);
+	if (end - begin < H265_NAL_HEADER_SIZE + H265_FU_HEADER_SIZE)
+		return true;
+
+	auto fragmentHeader = H265NalUnitFragmentHeader{
+	    std::to_integer<uint8_t>(packet->at(begin + H265_NAL_HEADER_SIZE))};
+	return ReadHeader(packet, begin).unitType() != naluTypeFU || fragmentHeader.isStart();
+}
+
+void H265RtpDepacketizer::depacketize(const std::vector<message_ptr> &packets,
+                                      impl::FrameAssembler &assembler) const {
+	for (const auto &packet : packets) {
+		auto [begin, end] = GetPayload(packet);
+		if (end - begin < H265_NAL_HEADER_SIZE) {
+			PLOG_VERBOSE << "H.265 RTP packet is too small";
+			continue;
+		}
+
+		auto header = ReadHeader(packet, begin);
+		auto unitType = header.unitType();
+
+		if (unitType == naluTypeFU) {
+			if (end - begin < H265_NAL_HEADER_SIZE + H265_FU_HEADER_SIZE) {
+				PLOG_VERBOSE << "H.265 FU packet is too small";
+				assembler.endUnit();
+				continue;
+			}
+
+			auto fragmentHeader = H265NalUnitFragmentHeader{
+			    std::to_integer<uint8_t>(packet->at(begin + H265_NAL_HEADER_SIZE))};
+
+			// The NAL unit header is the payload header with the type from the FU header
+			if (fragmentHeader.isStart() || !assembler.inUnit()) {
+				header.setUnitType(fragmentHeader.unitType());
+				const byte reconstructed[H265_NAL_HEADER_SIZE] = {byte(header._first),
+				                                                  byte(header._second)};
+				assembler.beginNalUnit(mSeparator);
+				assembler.addGenerated(reconstructed, H265_NAL_HEADER_SIZE);
+			}
+
+			size_t offset = begin + H265_NAL_HEADER_SIZE + H265_FU_HEADER_SIZE;
+			assembler.addPayload(packet, offset, end - offset);
+			if (fragmentHeader.isEnd())
+				assembler.endUnit();
+
+		} else if (unitType == naluTypeAP) {
+			// DONL fields are not supported, they are absent unless sprop-max-don-diff > 0
+			size_t offset = begin + H265_NAL_HEADER_SIZE;
+			while (offset + sizeof(uint16_t) < end) {
+				size_t naluSize = std::to_integer<size_t>(packet->at(offset)) << 8 |
+				                  std::to_integer<size_t>(packet->at(offset + 1));
+
+				offset += sizeof(uint16_t);
+
+				if (end < offset + naluSize) {
+					PLOG_VERBOSE << "H.265 AP declared size is larger than buffer";
+					break;
+				}
+
+				assembler.beginNalUnit(mSeparator);
+				assembler.addPayload(packet, offset, naluSize);
+				assembler.endUnit();
+				offset += naluSize;
+			}
+
+		} else if (unitType < naluTypeAP) {
+			assembler.beginNalUnit(mSeparator);
+			assembler.addPayload(packet, begin, end - begin);
+			assembler.endUnit();
+
+		} else {
+			PLOG_VERBOSE << "Unknown H.265 RTP packetization, type=" << int(unitType);
+			assembler.endUnit();
+		}
+	}
+}
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
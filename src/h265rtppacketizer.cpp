@@ -12,74 +12,19 @@
 
 #include "impl/internals.hpp"
 
-#include <cassert>
-
-#ifdef _WIN32
-#include <winsock2.h>
-#else
-#include <arpa/inet.h>
-#endif
+#include <algorithm>
+#include <cstring>
 
 namespace rtc {
 
-shared_ptr<H265NalUnits> H265RtpPacketizer::splitMessage(binary_ptr message) {
-	auto nalus = std::make_shared<H265NalUnits>();
-	if (separator == NalUnit::Separator::Length) {
-		size_t index = 0;
-		while (index < message->size()) {
-			assert(index + 4 < message->size());
-			if (index + 4 >= message->size()) {
-				LOG_WARNING << "Invalid NAL Unit data (incomplete length), ignoring!";
-				break;
-			}
-			uint32_t length;
-			std::memcpy(&length, message->data() + index, sizeof(uint32_t));
-			length = ntohl(length);
-			auto naluStartIndex = index + 4;
-			auto naluEndIndex = naluStartIndex + length;
-
-			assert(naluEndIndex <= message->size());
-			if (naluEndIndex > message->size()) {
-				LOG_WARNING << "Invalid NAL Unit data (incomplete unit), ignoring!";
-				break;
-			}
-			auto begin = message->begin() + naluStartIndex;
-			auto end = message->begin() + naluEndIndex;
-			nalus->push_back(std::make_shared<H265NalUnit>(begin, end));
-			index = naluEndIndex;
-		}
-	} else {
-		NalUnitStartSequenceMatch match = NUSM_noMatch;
-		size_t index = 0;
-		while (index < message->size()) {
-			match = NalUnit::StartSequenceMatchSucc(match, (*message)[index++], separator);
-			if (match == NUSM_longMatch || match == NUSM_shortMatch) {
-				match = NUSM_noMatch;
-				break;
-			}
-		}
+namespace {
 
-		size_t naluStartIndex = index;
-
-		while (index < message->size()) {
-			match = NalUnit::StartSequenceMatchSucc(match, (*message)[index], separator);
-			if (match == NUSM_longMatch || match == NUSM_shortMatch) {
-				auto sequenceLength = match == NUSM_longMatch ? 4 : 3;
-				size_t naluEndIndex = index - sequenceLength;
-				match = NUSM_noMatch;
-				auto begin = message->begin() + naluStartIndex;
-				auto end = message->begin() + naluEndIndex + 1;
-				nalus->push_back(std::make_shared<H265NalUnit>(begin, end));
-				naluStartIndex = index + 1;
-			}
-			index++;
-		}
-		auto begin = message->begin() + naluStartIndex;
-		auto end = message->end();
-		nalus->push_back(std::make_shared<H265NalUnit>(begin, end));
-	}
-	return nalus;
-}
+const uint8_t NalTypeAp = 48;
+const uint8_t NalTypeFu = 49;
+const size_t ApHeaderSize = 2;
+const size_t AggregationLengthSize = 2;
+
+} // namespace
 
 H265RtpPacketizer::H265RtpPacketizer(shared_ptr<RtpPacketizationConfig> rtpConfig,
                                      uint16_t maxFragmentSize)
@@ -95,18 +40,105 @@ H265RtpPacketizer::H265RtpPacketizer(NalUnit::Separator separator,
 void H265RtpPacketizer::outgoing(message_vector &messages, [[maybe_unused]] const message_callback &send) {
 	message_vector result;
 	for (const auto &message : messages) {
-		auto nalus = splitMessage(message);
-		auto fragments = nalus->generateFragments(maxFragmentSize);
-		if (fragments.size() == 0)
+		auto nalus = NalUnit::Split(*message, separator);
+
+		// Consecutive small units are aggregated in AP packets (RFC 7798 4.4.2)
+		size_t first = 0;
+		size_t aggregateSize = ApHeaderSize;
+		for (size_t i = 0; i < nalus.size(); ++i) {
+			const size_t size = nalus[i].size;
+			if (size > maxFragmentSize) {
+				aggregate(*message, nalus.data() + first, i - first, false, result);
+				fragment(message->data() + nalus[i].offset, size, i + 1 == nalus.size(), result);
+				first = i + 1;
+				aggregateSize = ApHeaderSize;
+				continue;
+			}
+
+			if (i > first && aggregateSize + AggregationLengthSize + size > maxFragmentSize) {
+				aggregate(*message, nalus.data() + first, i - first, false, result);
+				first = i;
+				aggregateSize = ApHeaderSize;
+			}
+			aggregateSize += AggregationLengthSize + size;
+		}
+		aggregate(*message, nalus.data() + first, nalus.size() - first, true, result);
+	}
+
+	messages.swap(result);
+}
+
+void H265RtpPacketizer::aggregate(const binary &frame, const NalUnitView *units, size_t count,
+                                  bool mark, message_vector &result) {
+	if (count == 0)
+		return;
+
+	if (count == 1) {
+		const auto &unit = units[0];
+		result.push_back(packetize(nullptr, 0, frame.data() + unit.offset, unit.size, mark));
+		return;
+	}
+
+	// The AP header has the forbidden bit if any unit has it, and the lowest LayerId and TID
+	bool forbidden = false;
+	uint8_t layerId = 0x3F;
+	uint8_t tid = 0x7;
+	size_t size = ApHeaderSize;
+	for (size_t i = 0; i < count; ++i) {
+		size += AggregationLengthSize + units[i].size;
+		if (units[i].size < H265_NAL_HEADER_SIZE)
 			continue;
 
-		for (size_t i = 0; i < fragments.size() - 1; i++)
-			result.push_back(packetize(fragments[i], false));
+		const uint8_t header0 = std::to_integer<uint8_t>(frame[units[i].offset]);
+		const uint8_t header1 = std::to_integer<uint8_t>(frame[units[i].offset + 1]);
+		forbidden |= (header0 & 0x80) != 0;
+		layerId = std::min(layerId, uint8_t(((header0 & 0x01) << 5) | (header1 >> 3)));
+		tid = std::min(tid, uint8_t(header1 & 0x07));
+	}
 
-		result.push_back(packetize(fragments[fragments.size() - 1], true));
+	// Write the aggregation directly in the packet
+	auto message = packetize(nullptr, 0, nullptr, size, mark);
+	auto p = reinterpret_cast<byte *>(reinterpret_cast<RtpHeader *>(message->data())->getBody());
+	*p++ = byte((forbidden ? 0x80 : 0) | (NalTypeAp << 1) | (layerId >> 5));
+	*p++ = byte(((layerId & 0x1F) << 3) | tid);
+	for (size_t i = 0; i < count; ++i) {
+		*p++ = byte(units[i].size >> 8);
+		*p++ = byte(units[i].size & 0xFF);
+		std::memcpy(p, frame.data() + units[i].offset, units[i].size);
+		p += units[i].size;
 	}
 
-	messages.swap(result);
+	result.push_back(std::move(message));
+}
+
+void H265RtpPacketizer::fragment(const byte *nalu, size_t size, bool mark,
+                                 message_vector &result) {
+	const size_t overhead = H265_NAL_HEADER_SIZE + H265_FU_HEADER_SIZE;
+	if (size <= H265_NAL_HEADER_SIZE) {
+		result.push_back(packetize(nullptr, 0, nalu, size, mark));
+		return;
+	}
+
+	// Fragments have roughly the same size, 3 bytes are used for payload header and FU header
+	const size_t count = (size + maxFragmentSize - 1) / maxFragmentSize;
+	const size_t fragmentSize = std::max((size + count - 1) / count, overhead + 1) - overhead;
+
+	// The payload header keeps F, LayerId, and TID from the unit header
+	const uint8_t header0 = std::to_integer<uint8_t>(nalu[0]);
+	const byte payloadHeader0 = byte((header0 & 0x81) | (NalTypeFu << 1));
+	const uint8_t unitType = (header0 >> 1) & 0x3F;
+	const byte *payload = nalu + H265_NAL_HEADER_SIZE;
+	const size_t payloadSize = size - H265_NAL_HEADER_SIZE;
+	size_t offset = 0;
+	while (offset < payloadSize) {
+		const size_t length = std::min(fragmentSize, payloadSize - offset);
+		const bool start = offset == 0;
+		const bool end = offset + length == payloadSize;
+		const byte prefix[3] = {payloadHeader0, nalu[1],
+		                        byte((start ? 0x80 : 0) | (end ? 0x40 : 0) | unitType)};
+		result.push_back(packetize(prefix, sizeof(prefix), payload + offset, length, mark && end));
+		offset += length;
+	}
 }
 
 } // namespace rtc
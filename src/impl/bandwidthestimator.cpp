@@ -0,0 +1,400 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "bandwidthestimator.hpp"
+#include "internals.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace rtc::impl {
+
+namespace {
+
+using std::chrono::duration;
+using std::chrono::milliseconds;
+
+// Packets sent within this interval form a group
+const auto BurstInterval = milliseconds(5);
+
+// Trendline filter
+const size_t TrendWindowSize = 20;
+const double SmoothingCoefficient = 0.9;
+const double ThresholdGain = 4.0;
+const unsigned int MaxDeltaCount = 60;
+
+// Adaptive threshold in ms
+const double InitialThreshold = 12.5;
+const double MinThreshold = 6.0;
+const double MaxThreshold = 600.0;
+const double ThresholdUpGain = 0.0087;
+const double ThresholdDownGain = 0.039;
+const double MaxThresholdAdaptOffset = 15.0;
+const double MaxTimeOverUsing = 10.0;
+
+// Rate control
+const double DecreaseFactor = 0.85;
+const double MultiplicativeIncrease = 1.08; // per second
+const double AssumedPacketBits = 1200 * 8;
+const double MinAdditiveIncrease = 4000; // bps per second
+const auto AckedWindow = milliseconds(500);
+const auto MinAckedSpan = milliseconds(100);
+
+// Loss-based control
+const size_t MinLossPackets = 20;
+const double HighLossFraction = 0.10;
+const double LowLossFraction = 0.02;
+const double LossIncreaseFactor = 1.05;
+
+// Probing
+const size_t MinProbePackets = 4;
+const auto MaxProbeInterval = milliseconds(1000);
+const auto ProbeClusterTimeout = milliseconds(1000);
+const double MinUnsaturatedRatio = 0.9; // below this receive to send ratio, the link is saturated
+const double SaturatedUtilization = 0.95;
+
+template <typename Duration> double Milliseconds(Duration d) {
+	return duration<double, std::milli>(d).count();
+}
+
+} // namespace
+
+BandwidthEstimator::BandwidthEstimator(unsigned int initialBitrate, unsigned int minBitrate,
+                                       unsigned int maxBitrate)
+    : mMinBitrate(minBitrate), mMaxBitrate(std::max(minBitrate, maxBitrate)),
+      mThreshold(InitialThreshold),
+      mDelayBasedBitrate(std::clamp(double(initialBitrate), mMinBitrate, mMaxBitrate)),
+      mLossBasedBitrate(mDelayBasedBitrate), mRoundTripTime(DEFAULT_RTT) {}
+
+void BandwidthEstimator::onFeedback(const std::vector<PacketResult> &results,
+                                    clock::time_point now) {
+	std::vector<uint32_t> probeClusters;
+	for (const auto &result : results) {
+		if (!result.received)
+			continue;
+
+		// Probes are excluded from the acknowledged bitrate as they are not useful throughput
+		if (result.probeCluster) {
+			onProbePacket(result, now);
+			if (std::find(probeClusters.begin(), probeClusters.end(), *result.probeCluster) ==
+			    probeClusters.end())
+				probeClusters.push_back(*result.probeCluster);
+		} else {
+			updateAckedBitrate(result);
+		}
+
+		onPacket(result);
+	}
+
+	optional<double> probeCapacity;
+	for (uint32_t id : probeClusters)
+		if (auto capacity = probeCapacityEstimate(mProbeClusters[id]))
+			probeCapacity = std::max(probeCapacity.value_or(0.), *capacity);
+
+	if (probeCapacity) {
+		mProbeResult = unsigned(*probeCapacity);
+		applyProbeResult(*probeCapacity);
+	}
+
+	for (auto it = mProbeClusters.begin(); it != mProbeClusters.end();)
+		it = now - it->second.created > ProbeClusterTimeout ? mProbeClusters.erase(it)
+		                                                    : std::next(it);
+
+	updateDelayBased(now);
+	updateLossBased(results);
+}
+
+void BandwidthEstimator::setRoundTripTime(milliseconds rtt) { mRoundTripTime = rtt; }
+
+unsigned int BandwidthEstimator::targetBitrate() const {
+	double bitrate = std::min(mDelayBasedBitrate, mLossBasedBitrate);
+	return unsigned(std::clamp(bitrate, mMinBitrate, mMaxBitrate));
+}
+
+optional<unsigned int> BandwidthEstimator::ackedBitrate() const {
+	if (mAckedWindow.size() < 2)
+		return nullopt;
+
+	auto span = mAckedWindow.back().first - mAckedWindow.front().first;
+	if (span < MinAckedSpan)
+		return nullopt;
+
+	return unsigned(double(mAckedBytes) * 8.0 * 1e6 / double(span.count()));
+}
+
+optional<unsigned int> BandwidthEstimator::fetchProbeResult() {
+	return std::exchange(mProbeResult, nullopt);
+}
+
+void BandwidthEstimator::onPacket(const PacketResult &result) {
+	if (!mCurrentGroup) {
+		mCurrentGroup = Group{result.sendTime, result.sendTime, result.arrivalTime};
+		return;
+	}
+
+	auto &group = *mCurrentGroup;
+	if (result.sendTime < group.firstSendTime)
+		return; // reordered across groups
+
+	if (result.sendTime - group.firstSendTime <= BurstInterval) {
+		group.lastSendTime = std::max(group.lastSendTime, result.sendTime);
+		group.lastArrivalTime = std::max(group.lastArrivalTime, result.arrivalTime);
+		return;
+	}
+
+	if (mPreviousGroup) {
+		const auto &previous = *mPreviousGroup;
+		onGroupDelta(Milliseconds(group.lastSendTime - previous.lastSendTime),
+		             Milliseconds(group.lastArrivalTime - previous.lastArrivalTime),
+		             Milliseconds(group.lastArrivalTime));
+	}
+
+	mPreviousGroup = group;
+	mCurrentGroup = Group{result.sendTime, result.sendTime, result.arrivalTime};
+}
+
+void BandwidthEstimator::onGroupDelta(double sendDeltaMs, double arrivalDeltaMs,
+                                      double arrivalTimeMs) {
+	// Smooth the accumulated delay variation and estimate its slope with a linear regression
+	mDeltaCount = std::min(mDeltaCount + 1, MaxDeltaCount);
+	mAccumulatedDelay += arrivalDeltaMs - sendDeltaMs;
+	mSmoothedDelay =
+	    SmoothingCoefficient * mSmoothedDelay + (1.0 - SmoothingCoefficient) * mAccumulatedDelay;
+
+	if (!mFirstArrivalTimeMs)
+		mFirstArrivalTimeMs = arrivalTimeMs;
+
+	mTrendWindow.emplace_back(arrivalTimeMs - *mFirstArrivalTimeMs, mSmoothedDelay);
+	if (mTrendWindow.size() > TrendWindowSize)
+		mTrendWindow.pop_front();
+
+	double trend = mPreviousTrend;
+	if (mTrendWindow.size() == TrendWindowSize) {
+		double meanX = 0, meanY = 0;
+		for (const auto &[x, y] : mTrendWindow) {
+			meanX += x;
+			meanY += y;
+		}
+		meanX /= double(mTrendWindow.size());
+		meanY /= double(mTrendWindow.size());
+
+		double numerator = 0, denominator = 0;
+		for (const auto &[x, y] : mTrendWindow) {
+			numerator += (x - meanX) * (y - meanY);
+			denominator += (x - meanX) * (x - meanX);
+		}
+		if (denominator != 0)
+			trend = numerator / denominator;
+	}
+
+	// Overuse is signaled when the trend stays above the threshold for a while and increases
+	const double modifiedTrend = double(mDeltaCount) * trend * ThresholdGain;
+	if (modifiedTrend > mThreshold) {
+		if (mTimeOverUsing < 0)
+			mTimeOverUsing = sendDeltaMs / 2;
+		else
+			mTimeOverUsing += sendDeltaMs;
+
+		++mOveruseCounter;
+		if (mTimeOverUsing > MaxTimeOverUsing && mOveruseCounter > 1 && trend >= mPreviousTrend) {
+			mTimeOverUsing = 0;
+			mOveruseCounter = 0;
+			mUsage = Usage::Overusing;
+		}
+	} else if (modifiedTrend < -mThreshold) {
+		mTimeOverUsing = -1;
+		mOveruseCounter = 0;
+		mUsage = Usage::Underusing;
+	} else {
+		mTimeOverUsing = -1;
+		mOveruseCounter = 0;
+		mUsage = Usage::Normal;
+	}
+
+	mPreviousTrend = trend;
+	updateThreshold(modifiedTrend, arrivalTimeMs);
+}
+
+void BandwidthEstimator::updateThreshold(double modifiedTrend, double arrivalTimeMs) {
+	if (!mLastThresholdUpdateMs)
+		mLastThresholdUpdateMs = arrivalTimeMs;
+
+	// Large spikes are ignored so the threshold does not grow from a single sudden change
+	const double absTrend = std::abs(modifiedTrend);
+	if (absTrend > mThreshold + MaxThresholdAdaptOffset) {
+		mLastThresholdUpdateMs = arrivalTimeMs;
+		return;
+	}
+
+	const double gain = absTrend < mThreshold ? ThresholdDownGain : ThresholdUpGain;
+	const double elapsed = std::min(arrivalTimeMs - *mLastThresholdUpdateMs, 100.0);
+	mThreshold += gain * (absTrend - mThreshold) * elapsed;
+	mThreshold = std::clamp(mThreshold, MinThreshold, MaxThreshold);
+	mLastThresholdUpdateMs = arrivalTimeMs;
+}
+
+void BandwidthEstimator::updateAckedBitrate(const PacketResult &result) {
+	mAckedWindow.emplace_back(result.arrivalTime, result.size);
+	mAckedBytes += result.size;
+	while (result.arrivalTime - mAckedWindow.front().first > AckedWindow) {
+		mAckedBytes -= mAckedWindow.front().second;
+		mAckedWindow.pop_front();
+	}
+}
+
+void BandwidthEstimator::updateDelayBased(clock::time_point now) {
+	const double elapsed =
+	    mLastUpdate ? std::clamp(duration<double>(now - *mLastUpdate).count(), 0.0, 1.0) : 0.0;
+	mLastUpdate = now;
+
+	switch (mUsage) {
+	case Usage::Overusing:
+		mRateState = RateState::Decrease;
+		break;
+	case Usage::Underusing:
+		mRateState = RateState::Hold;
+		break;
+	case Usage::Normal:
+		if (mRateState == RateState::Hold)
+			mRateState = RateState::Increase;
+		break;
+	}
+
+	const auto acked = ackedBitrate();
+	switch (mRateState) {
+	case RateState::Hold:
+		break;
+
+	case RateState::Increase: {
+		const double previous = mDelayBasedBitrate;
+
+		// Increase multiplicatively until the link capacity is known, then additively
+		if (acked && mLinkCapacity && *acked > *mLinkCapacity * 1.5)
+			mLinkCapacity.reset(); // the capacity changed
+
+		if (mLinkCapacity) {
+			const double responseTime = duration<double>(mRoundTripTime).count() + 0.1;
+			const double increase = std::max(MinAdditiveIncrease, AssumedPacketBits / responseTime);
+			mDelayBasedBitrate += increase * elapsed;
+		} else {
+			mDelayBasedBitrate *= std::pow(MultiplicativeIncrease, elapsed);
+		}
+
+		// Don't go too far beyond what the receiver actually gets, but keep a higher bitrate
+		// reached by probing
+		if (acked && mDelayBasedBitrate > 1.5 * double(*acked) + 10000)
+			mDelayBasedBitrate = std::max(previous, 1.5 * double(*acked) + 10000);
+
+		break;
+	}
+
+	case RateState::Decrease:
+		// Decrease at most once per round-trip time, so the effect can be observed
+		if (!mLastDecrease || now - *mLastDecrease >= mRoundTripTime) {
+			const double base = acked ? double(*acked) : mDelayBasedBitrate;
+			mDelayBasedBitrate = std::min(mDelayBasedBitrate, DecreaseFactor * base);
+			if (acked)
+				mLinkCapacity = mLinkCapacity ? 0.95 * *mLinkCapacity + 0.05 * double(*acked)
+				                              : double(*acked);
+
+			mLastDecrease = now;
+		}
+		mRateState = RateState::Hold;
+		break;
+	}
+
+	mDelayBasedBitrate = std::clamp(mDelayBasedBitrate, mMinBitrate, mMaxBitrate);
+}
+
+void BandwidthEstimator::updateLossBased(const std::vector<PacketResult> &results) {
+	for (const auto &result : results)
+		++(result.received ? mLossReceived : mLossLost);
+
+	const size_t total = mLossReceived + mLossLost;
+	if (total < MinLossPackets)
+		return;
+
+	const double loss = double(mLossLost) / double(total);
+	mLossReceived = 0;
+	mLossLost = 0;
+
+	if (loss > HighLossFraction)
+		mLossBasedBitrate *= 1.0 - 0.5 * loss;
+	else if (loss < LowLossFraction)
+		mLossBasedBitrate = std::min(mLossBasedBitrate * LossIncreaseFactor, mDelayBasedBitrate);
+
+	mLossBasedBitrate = std::clamp(mLossBasedBitrate, mMinBitrate, mMaxBitrate);
+}
+
+void BandwidthEstimator::onProbePacket(const PacketResult &result, clock::time_point now) {
+	auto &cluster = mProbeClusters[*result.probeCluster];
+	if (cluster.count == 0) {
+		cluster.created = now;
+		cluster.firstSendTime = cluster.lastSendTime = result.sendTime;
+		cluster.firstArrivalTime = cluster.lastArrivalTime = result.arrivalTime;
+		cluster.lastSentSize = cluster.firstArrivalSize = result.size;
+	} else {
+		cluster.firstSendTime = std::min(cluster.firstSendTime, result.sendTime);
+		if (result.sendTime > cluster.lastSendTime) {
+			cluster.lastSendTime = result.sendTime;
+			cluster.lastSentSize = result.size;
+		}
+		if (result.arrivalTime < cluster.firstArrivalTime) {
+			cluster.firstArrivalTime = result.arrivalTime;
+			cluster.firstArrivalSize = result.size;
+		}
+		cluster.lastArrivalTime = std::max(cluster.lastArrivalTime, result.arrivalTime);
+	}
+
+	cluster.bytes += result.size;
+	++cluster.count;
+}
+
+optional<double> BandwidthEstimator::probeCapacityEstimate(const ProbeCluster &cluster) const {
+	if (cluster.count < MinProbePackets)
+		return nullopt;
+
+	const auto sendInterval = cluster.lastSendTime - cluster.firstSendTime;
+	const auto receiveInterval = cluster.lastArrivalTime - cluster.firstArrivalTime;
+	if (sendInterval <= clock::duration::zero() || sendInterval > MaxProbeInterval ||
+	    receiveInterval <= std::chrono::microseconds::zero() || receiveInterval > MaxProbeInterval)
+		return nullopt;
+
+	// The last sent packet and the first received one are outside of the measured intervals
+	const double sendRate = double(cluster.bytes - cluster.lastSentSize) * 8.0 /
+	                        duration<double>(sendInterval).count();
+	const double receiveRate = double(cluster.bytes - cluster.firstArrivalSize) * 8.0 /
+	                           duration<double>(receiveInterval).count();
+
+	// If the receive rate is significantly lower, the link was saturated and the receive rate is
+	// close to the capacity. Otherwise, as probes are sent in addition to media, the capacity is
+	// at least the delivery rate plus the acknowledged bitrate.
+	if (receiveRate < MinUnsaturatedRatio * sendRate)
+		return SaturatedUtilization * receiveRate;
+
+	return std::min(sendRate, receiveRate) + double(ackedBitrate().value_or(0));
+}
+
+void BandwidthEstimator::applyProbeResult(double bitrate) {
+	// A probe only raises the estimation, decreases are left to the controllers
+	bitrate = std::clamp(bitrate, mMinBitrate, mMaxBitrate);
+	if (bitrate <= targetBitrate())
+		return;
+
+	PLOG_DEBUG << "Probe raised the bandwidth estimation to " << unsigned(bitrate) << " bps";
+	mDelayBasedBitrate = std::max(mDelayBasedBitrate, bitrate);
+	mLossBasedBitrate = std::max(mLossBasedBitrate, bitrate);
+	mLinkCapacity.reset();
+}
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_IMPL_BANDWIDTH_ESTIMATOR_H
+#define RTC_IMPL_BANDWIDTH_ESTIMATOR_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace rtc::impl {
+
+// Send-side bandwidth estimator in the spirit of Google Congestion Control
+// (draft-ietf-rmcat-gcc-02). A delay-based controller adjusts the rate with AIMD according to
+// the trend of the one-way delay variation between packet groups, and a loss-based controller
+// caps it when the loss fraction is high. It is fed with transport-wide feedback.
+class BandwidthEstimator final {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct PacketResult {
+		clock::time_point sendTime;
+		size_t size;
+		bool received;
+		std::chrono::microseconds arrivalTime; // in the receiver clock, if received
+		optional<uint32_t> probeCluster = nullopt; // if the packet is a probe
+	};
+
+	BandwidthEstimator(unsigned int initialBitrate, unsigned int minBitrate,
+	                   unsigned int maxBitrate);
+
+	// Update the estimation with the results of a feedback, sorted by sequence number
+	void onFeedback(const std::vector<PacketResult> &results, clock::time_point now);
+	void setRoundTripTime(std::chrono::milliseconds rtt);
+
+	unsigned int targetBitrate() const;
+	optional<unsigned int> ackedBitrate() const; // receive rate observed by the receiver
+
+	// Return the capacity measured by the last probe cluster since the previous call, if any
+	optional<unsigned int> fetchProbeResult();
+
+private:
+	enum class Usage { Normal, Overusing, Underusing };
+	enum class RateState { Hold, Increase, Decrease };
+
+	struct Group {
+		clock::time_point firstSendTime;
+		clock::time_point lastSendTime;
+		std::chrono::microseconds lastArrivalTime;
+	};
+
+	struct ProbeCluster {
+		clock::time_point created;
+		clock::time_point firstSendTime, lastSendTime;
+		std::chrono::microseconds firstArrivalTime, lastArrivalTime;
+		size_t lastSentSize = 0;     // size of the last sent packet
+		size_t firstArrivalSize = 0; // size of the first received packet
+		size_t bytes = 0;
+		size_t count = 0;
+	};
+
+	void onPacket(const PacketResult &result);
+	void onGroupDelta(double sendDeltaMs, double arrivalDeltaMs, double arrivalTimeMs);
+	void updateThreshold(double modifiedTrend, double arrivalTimeMs);
+	void updateAckedBitrate(const PacketResult &result);
+	void updateDelayBased(clock::time_point now);
+	void updateLossBased(const std::vector<PacketResult> &results);
+	void onProbePacket(const PacketResult &result, clock::time_point now);
+	optional<double> probeCapacityEstimate(const ProbeCluster &cluster) const;
+	void applyProbeResult(double bitrate);
+
+	const double mMinBitrate;
+	const double mMaxBitrate;
+
+	// Packet groups and trendline filter
+	optional<Group> mCurrentGroup;
+	optional<Group> mPreviousGroup;
+	std::deque<std::pair<double, double>> mTrendWindow; // arrival time and smoothed delay in ms
+	double mAccumulatedDelay = 0;
+	double mSmoothedDelay = 0;
+	optional<double> mFirstArrivalTimeMs;
+	unsigned int mDeltaCount = 0;
+	double mPreviousTrend = 0;
+
+	// Overuse detector
+	Usage mUsage = Usage::Normal;
+	double mThreshold;
+	optional<double> mLastThresholdUpdateMs;
+	double mTimeOverUsing = -1;
+	unsigned int mOveruseCounter = 0;
+
+	// Acknowledged bitrate
+	std::deque<std::pair<std::chrono::microseconds, size_t>> mAckedWindow;
+	size_t mAckedBytes = 0;
+
+	// Rate control
+	RateState mRateState = RateState::Increase;
+	double mDelayBasedBitrate;
+	double mLossBasedBitrate;
+	optional<double> mLinkCapacity;
+	optional<clock::time_point> mLastUpdate;
+	optional<clock::time_point> mLastDecrease;
+	std::chrono::milliseconds mRoundTripTime;
+	size_t mLossReceived = 0;
+	size_t mLossLost = 0;
+
+	// Probing
+	std::map<uint32_t, ProbeCluster> mProbeClusters;
+	optional<unsigned int> mProbeResult;
+};
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif
@@ -589,12 +589,105 @@ string make_fingerprint(X509 *x509, CertificateFingerprint::Algorithm fingerprin
 
 // Common for GnuTLS, Mbed TLS, and OpenSSL
 
-future_certificate_ptr make_certificate(CertificateType type) {
-	return ThreadPool::Instance().enqueue([type, token = Init::Instance().token()]() {
+namespace {
+
+future_certificate_ptr generate_certificate(CertificateType type) {
+	return ThreadPool::CryptoInstance().enqueue([type, token = Init::Instance().token()]() {
 		return std::make_shared<Certificate>(Certificate::Generate(type, "libdatachannel"));
 	});
 }
 
+} // namespace
+
+future_certificate_ptr make_certificate(CertificateType type) {
+	return CertificateCache::Instance().get(type);
+}
+
+CertificateCache &CertificateCache::Instance() {
+	static CertificateCache *instance = new CertificateCache;
+	return *instance;
+}
+
+void CertificateCache::setSettings(CertificateCacheSettings settings) {
+	std::lock_guard lock(mMutex);
+	mSettings = std::move(settings);
+
+	if (mSettings.lifetime <= std::chrono::milliseconds::zero())
+		for (auto &[type, entry] : mEntries)
+			entry.shared = {};
+
+	// Warm up the pool for the default type and the types already in use
+	mEntries.try_emplace(CertificateType::Default);
+	for (auto &[type, entry] : mEntries) {
+		while (entry.pool.size() > mSettings.poolSize)
+			entry.pool.pop_back();
+
+		refill(type, entry);
+	}
+}
+
+CertificateCacheStats CertificateCache::stats() const {
+	std::lock_guard lock(mMutex);
+	CertificateCacheStats result;
+	result.hits = mHits;
+	result.misses = mMisses;
+	return result;
+}
+
+future_certificate_ptr CertificateCache::get(CertificateType type) {
+	std::lock_guard lock(mMutex);
+	auto &entry = mEntries[type];
+	const auto now = clock::now();
+	const bool sharing = mSettings.lifetime > std::chrono::milliseconds::zero();
+	if (sharing && entry.shared.valid() && now < entry.expiry) {
+		++mHits;
+		return entry.shared;
+	}
+
+	future_certificate_ptr certificate;
+	if (!entry.pool.empty()) {
+		++mHits;
+		certificate = std::move(entry.pool.front());
+		entry.pool.pop_front();
+	} else {
+		++mMisses;
+		certificate = generate_certificate(type);
+	}
+
+	if (sharing) {
+		PLOG_DEBUG << "Rotating shared certificate";
+		entry.shared = certificate;
+		entry.expiry = now + mSettings.lifetime;
+	}
+
+	refill(type, entry);
+	return certificate;
+}
+
+void CertificateCache::clear() {
+	std::map<CertificateType, Entry> entries;
+	{
+		std::lock_guard lock(mMutex);
+		std::swap(entries, mEntries);
+	}
+
+	// Join the background generations outside of the lock, as each pending one holds an init
+	// token until it completes
+	for (auto &[type, entry] : entries) {
+		if (entry.shared.valid())
+			entry.shared.wait();
+
+		for (auto &certificate : entry.pool)
+			certificate.wait();
+	}
+}
+
+void CertificateCache::refill(CertificateType type, Entry &entry) {
+	// Requires mMutex to be locked
+	while (entry.pool.size() < mSettings.poolSize)
+		entry.pool.push_back(generate_certificate(type));
+}
+
 CertificateFingerprint Certificate::fingerprint() const {
 	return CertificateFingerprint{CertificateFingerprint::Algorithm::Sha256, mFingerprint};
 }
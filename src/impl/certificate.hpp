@@ -12,10 +12,15 @@
 #include "description.hpp" // for CertificateFingerprint
 #include "common.hpp"
 #include "configuration.hpp" // for CertificateType
+#include "global.hpp"        // for CertificateCacheSettings
 #include "init.hpp"
 #include "tls.hpp"
 
+#include <chrono>
+#include <deque>
 #include <future>
+#include <map>
+#include <mutex>
 #include <tuple>
 
 namespace rtc::impl {
@@ -73,6 +78,38 @@ using future_certificate_ptr = std::shared_future<certificate_ptr>;
 
 future_certificate_ptr make_certificate(CertificateType type = CertificateType::Default);
 
+// Process-level cache keeping certificates pre-generated and sharing them for a limited lifetime
+class CertificateCache final {
+public:
+	static CertificateCache &Instance();
+
+	void setSettings(CertificateCacheSettings settings);
+	CertificateCacheStats stats() const;
+
+	future_certificate_ptr get(CertificateType type);
+	void clear(); // waits for pending generations, required for cleanup
+
+private:
+	CertificateCache() = default;
+	~CertificateCache() = default;
+
+	using clock = std::chrono::steady_clock;
+
+	struct Entry {
+		future_certificate_ptr shared;
+		clock::time_point expiry;
+		std::deque<future_certificate_ptr> pool;
+	};
+
+	void refill(CertificateType type, Entry &entry);
+
+	CertificateCacheSettings mSettings;
+	std::map<CertificateType, Entry> mEntries;
+	size_t mHits = 0;
+	size_t mMisses = 0;
+	mutable std::mutex mMutex;
+};
+
 } // namespace rtc::impl
 
 #endif
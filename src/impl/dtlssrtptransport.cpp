@@ -59,11 +59,12 @@ bool DtlsSrtpTransport::IsGcmSupported() {
 DtlsSrtpTransport::DtlsSrtpTransport(shared_ptr<IceTransport> lower,
                                      shared_ptr<Certificate> certificate, optional<size_t> mtu,
                                      CertificateFingerprint::Algorithm fingerprintAlgorithm,
+                                     std::vector<SrtpProfile> srtpProfiles,
                                      verifier_callback verifierCallback,
-                                     message_callback srtpRecvCallback,
+                                     media_callback srtpRecvCallback,
                                      state_callback stateChangeCallback)
-    : DtlsTransport(lower, certificate, mtu, fingerprintAlgorithm, std::move(verifierCallback),
-                    std::move(stateChangeCallback)),
+    : DtlsTransport(lower, certificate, mtu, fingerprintAlgorithm, std::move(srtpProfiles),
+                    std::move(verifierCallback), std::move(stateChangeCallback)),
       mSrtpRecvCallback(std::move(srtpRecvCallback)) { // distinct from Transport recv callback
 
 	PLOG_DEBUG << "Initializing DTLS-SRTP transport";
@@ -94,6 +95,28 @@ bool DtlsSrtpTransport::sendMedia(message_ptr message) {
 		return false;
 	}
 
+	return Transport::outgoing(protectMedia(std::move(message))); // bypass DTLS DSCP marking
+}
+
+bool DtlsSrtpTransport::sendMedia(message_vector messages) {
+	std::lock_guard lock(sendMutex);
+	if (!mInitDone) {
+		PLOG_ERROR << "SRTP media sent before keys are derived";
+		return false;
+	}
+
+	// Send each packet as soon as it is protected, so if protecting one throws, packets before it
+	// which already advanced the SRTP state are not lost
+	bool ret = false;
+	for (auto &message : messages)
+		if (message)
+			ret = Transport::outgoing(protectMedia(std::move(message))); // bypass DTLS DSCP marking
+
+	return ret;
+}
+
+message_ptr DtlsSrtpTransport::protectMedia(message_ptr message) {
+	// Requires sendMutex to be locked
 	int size = int(message->size());
 	PLOG_VERBOSE << "Send size=" << size;
 
@@ -136,17 +159,29 @@ bool DtlsSrtpTransport::sendMedia(message_ptr message) {
 		message->dscp = 36; // AF42: Assured Forwarding class 4, medium drop probability
 	}
 
-	return Transport::outgoing(message); // bypass DTLS DSCP marking
+	return message;
+}
+
+void DtlsSrtpTransport::recvMedia(message_vector messages) {
+	// Unprotect in place and drop the packets failing
+	auto it = messages.begin();
+	for (auto &message : messages)
+		if (unprotectMedia(message))
+			*it++ = std::move(message);
+
+	messages.erase(it, messages.end());
+	if (!messages.empty())
+		mSrtpRecvCallback(std::move(messages));
 }
 
-void DtlsSrtpTransport::recvMedia(message_ptr message) {
+bool DtlsSrtpTransport::unprotectMedia(message_ptr message) {
 	// The RTP header has a minimum size of 12 bytes
 	// An RTCP packet can have a minimum size of 8 bytes
 	int size = int(message->size());
 	if (size < 8) {
 		COUNTER_MEDIA_TRUNCATED++;
 		PLOG_VERBOSE << "Incoming SRTP/SRTCP packet too short, size=" << size;
-		return;
+		return false;
 	}
 
 	uint8_t value2 = to_integer<uint8_t>(*(message->begin() + 1)) & 0x7F;
@@ -167,7 +202,7 @@ void DtlsSrtpTransport::recvMedia(message_ptr message) {
 				COUNTER_SRTCP_FAIL++;
 			}
 
-			return;
+			return false;
 		}
 		PLOG_VERBOSE << "Unprotected SRTCP packet, size=" << size;
 		message->type = Message::Control;
@@ -186,7 +221,7 @@ void DtlsSrtpTransport::recvMedia(message_ptr message) {
 				PLOG_DEBUG << "SRTP unprotect error, status=" << err;
 				COUNTER_SRTP_FAIL++;
 			}
-			return;
+			return false;
 		}
 		PLOG_VERBOSE << "Unprotected SRTP packet, size=" << size;
 		message->type = Message::Binary;
@@ -194,7 +229,7 @@ void DtlsSrtpTransport::recvMedia(message_ptr message) {
 	}
 
 	message->resize(size);
-	mSrtpRecvCallback(message);
+	return true;
 }
 
 bool DtlsSrtpTransport::demuxMessage(message_ptr message) {
@@ -220,7 +255,22 @@ bool DtlsSrtpTransport::demuxMessage(message_ptr message) {
 		return false;
 
 	} else if (value1 >= 128 && value1 <= 191) {
-		recvMedia(std::move(message));
+		// Take the SRTP/SRTCP packets queued right after this one to unprotect them as a batch
+		message_vector messages{std::move(message)};
+		while (messages.size() < SRTP_RECV_BATCH_SIZE) {
+			auto next = mIncomingQueue.peek();
+			if (!next || !*next || (*next)->empty())
+				break;
+
+			uint8_t value = to_integer<uint8_t>(*(*next)->begin());
+			if (value < 128 || value > 191)
+				break;
+
+			mIncomingQueue.pop();
+			messages.push_back(std::move(*next));
+		}
+
+		recvMedia(std::move(messages));
 		return true;
 
 	} else {
@@ -238,10 +288,18 @@ void DtlsSrtpTransport::postHandshake() {
 #if USE_GNUTLS
 	PLOG_INFO << "Deriving SRTP keying material (GnuTLS)";
 
-	const srtp_profile_t srtpProfile = srtp_profile_aes128_cm_sha1_80;
-	const size_t keySize = SRTP_AES_128_KEY_LEN;
-	const size_t saltSize = SRTP_SALT_LEN;
-	const size_t keySizeWithSalt = SRTP_AES_ICM_128_KEY_LEN_WSALT;
+	gnutls_srtp_profile_t profile;
+	gnutls::check(gnutls_srtp_get_selected_profile(mSession, &profile),
+	              "Failed to get SRTP profile");
+
+	const char *profileName = gnutls_srtp_get_profile_name(profile);
+	if (!profileName)
+		throw std::runtime_error("Unknown SRTP profile");
+
+	PLOG_DEBUG << "SRTP profile is: " << profileName;
+
+	const auto [srtpProfile, keySize, saltSize] = GetProfileParams(GetProfileFromName(profileName));
+	const size_t keySizeWithSalt = keySize + saltSize;
 
 	const size_t materialLen = keySizeWithSalt * 2;
 	std::vector<unsigned char> material(materialLen);
@@ -271,13 +329,20 @@ void DtlsSrtpTransport::postHandshake() {
 
 	mbedtls_dtls_srtp_info srtpInfo;
 	mbedtls_ssl_get_dtls_srtp_negotiation_result(&mSsl, &srtpInfo);
-	if (srtpInfo.MBEDTLS_PRIVATE(chosen_dtls_srtp_profile) != MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_80)
+	SrtpProfile profile;
+	switch (srtpInfo.MBEDTLS_PRIVATE(chosen_dtls_srtp_profile)) {
+	case MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_80:
+		profile = SrtpProfile::Aes128CmHmacSha1_80;
+		break;
+	case MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_32:
+		profile = SrtpProfile::Aes128CmHmacSha1_32;
+		break;
+	default:
 		throw std::runtime_error("Failed to get SRTP profile");
+	}
 
-	const srtp_profile_t srtpProfile = srtp_profile_aes128_cm_sha1_80;
-	const size_t keySize = SRTP_AES_128_KEY_LEN;
-	const size_t saltSize = SRTP_SALT_LEN;
-	const size_t keySizeWithSalt = SRTP_AES_ICM_128_KEY_LEN_WSALT;
+	const auto [srtpProfile, keySize, saltSize] = GetProfileParams(profile);
+	const size_t keySizeWithSalt = keySize + saltSize;
 
 	if (mTlsProfile == MBEDTLS_SSL_TLS_PRF_NONE)
 		throw std::logic_error("TLS PRF type is not set");
@@ -308,7 +373,8 @@ void DtlsSrtpTransport::postHandshake() {
 
 	PLOG_DEBUG << "SRTP profile is: " << profile->name;
 
-	const auto [srtpProfile, keySize, saltSize] = getProfileParamsFromName(profile->name);
+	const auto [srtpProfile, keySize, saltSize] =
+	    GetProfileParams(GetProfileFromName(profile->name));
 	const size_t keySizeWithSalt = keySize + saltSize;
 
 	// The extractor provides the client write master key, the server write master key, the client
@@ -373,20 +439,34 @@ void DtlsSrtpTransport::postHandshake() {
 	mInitDone = true;
 }
 
-#if !USE_GNUTLS && !USE_MBEDTLS
-DtlsSrtpTransport::ProfileParams DtlsSrtpTransport::getProfileParamsFromName(string_view name) {
-	if (name == "SRTP_AES128_CM_SHA1_80")
+DtlsSrtpTransport::ProfileParams DtlsSrtpTransport::GetProfileParams(SrtpProfile profile) {
+	switch (profile) {
+	case SrtpProfile::Aes128CmHmacSha1_80:
 		return {srtp_profile_aes128_cm_sha1_80, SRTP_AES_128_KEY_LEN, SRTP_SALT_LEN};
-	if (name == "SRTP_AES128_CM_SHA1_32")
+	case SrtpProfile::Aes128CmHmacSha1_32:
 		return {srtp_profile_aes128_cm_sha1_32, SRTP_AES_128_KEY_LEN, SRTP_SALT_LEN};
-	if (name == "SRTP_AEAD_AES_128_GCM")
+	case SrtpProfile::AeadAes128Gcm:
 		return {srtp_profile_aead_aes_128_gcm, SRTP_AES_128_KEY_LEN, SRTP_AEAD_SALT_LEN};
-	if (name == "SRTP_AEAD_AES_256_GCM")
+	case SrtpProfile::AeadAes256Gcm:
 		return {srtp_profile_aead_aes_256_gcm, SRTP_AES_256_KEY_LEN, SRTP_AEAD_SALT_LEN};
+	default:
+		throw std::logic_error("Unknown SRTP profile");
+	}
+}
+
+SrtpProfile DtlsSrtpTransport::GetProfileFromName(string_view name) {
+	// OpenSSL and GnuTLS have different names for AES-CM profiles
+	if (name == "SRTP_AES128_CM_SHA1_80" || name == "SRTP_AES128_CM_HMAC_SHA1_80")
+		return SrtpProfile::Aes128CmHmacSha1_80;
+	if (name == "SRTP_AES128_CM_SHA1_32" || name == "SRTP_AES128_CM_HMAC_SHA1_32")
+		return SrtpProfile::Aes128CmHmacSha1_32;
+	if (name == "SRTP_AEAD_AES_128_GCM")
+		return SrtpProfile::AeadAes128Gcm;
+	if (name == "SRTP_AEAD_AES_256_GCM")
+		return SrtpProfile::AeadAes256Gcm;
 
 	throw std::logic_error("Unknown SRTP profile name: " + std::string(name));
 }
-#endif
 
 } // namespace rtc::impl
 
@@ -30,30 +30,34 @@ public:
 	static void Cleanup();
 	static bool IsGcmSupported();
 
+	using media_callback = std::function<void(message_vector messages)>;
+
 	DtlsSrtpTransport(shared_ptr<IceTransport> lower, certificate_ptr certificate,
 	                  optional<size_t> mtu, CertificateFingerprint::Algorithm fingerprintAlgorithm,
-	                  verifier_callback verifierCallback, message_callback srtpRecvCallback,
-	                  state_callback stateChangeCallback);
+	                  std::vector<SrtpProfile> srtpProfiles, verifier_callback verifierCallback,
+	                  media_callback srtpRecvCallback, state_callback stateChangeCallback);
 	~DtlsSrtpTransport();
 
 	bool sendMedia(message_ptr message);
+	bool sendMedia(message_vector messages); // protects and sends the batch under a single lock
 
 private:
-	void recvMedia(message_ptr message);
+	message_ptr protectMedia(message_ptr message);
+	bool unprotectMedia(message_ptr message);
+	void recvMedia(message_vector messages);
 	bool demuxMessage(message_ptr message) override;
 	void postHandshake() override;
 
-#if !USE_GNUTLS && !USE_MBEDTLS
 	struct ProfileParams {
 		srtp_profile_t srtpProfile;
 		size_t keySize;
 		size_t saltSize;
 	};
 
-	ProfileParams getProfileParamsFromName(string_view name);
-#endif
+	static ProfileParams GetProfileParams(SrtpProfile profile);
+	static SrtpProfile GetProfileFromName(string_view name);
 
-	message_callback mSrtpRecvCallback;
+	media_callback mSrtpRecvCallback;
 	srtp_t mSrtpIn, mSrtpOut;
 	std::atomic<bool> mInitDone = false;
 	std::vector<unsigned char> mClientSessionKey;
@@ -29,13 +29,62 @@ using namespace std::chrono;
 
 namespace rtc::impl {
 
+namespace {
+
+bool IsSrtpProfileSupported(SrtpProfile profile) {
+	switch (profile) {
+	case SrtpProfile::Aes128CmHmacSha1_80:
+	case SrtpProfile::Aes128CmHmacSha1_32:
+		return true;
+	case SrtpProfile::AeadAes128Gcm:
+	case SrtpProfile::AeadAes256Gcm:
+#if RTC_ENABLE_MEDIA && !USE_MBEDTLS
+		return DtlsSrtpTransport::IsGcmSupported();
+#else
+		return false; // Mbed TLS does not support AES-GCM for DTLS-SRTP
+#endif
+	default:
+		return false;
+	}
+}
+
+// Returns the SRTP profiles to offer in order of preference
+std::vector<SrtpProfile> SrtpProfilesToOffer(const std::vector<SrtpProfile> &preferred) {
+	// AES-GCM is faster than AES-CM with HMAC-SHA1 when AES is hardware-accelerated
+	static const std::vector<SrtpProfile> defaultProfiles = {SrtpProfile::AeadAes128Gcm,
+	                                                         SrtpProfile::AeadAes256Gcm,
+	                                                         SrtpProfile::Aes128CmHmacSha1_80};
+
+	std::vector<SrtpProfile> result;
+	for (auto profile : preferred.empty() ? defaultProfiles : preferred) {
+		if (!IsSrtpProfileSupported(profile)) {
+			PLOG_DEBUG << "Skipping unsupported SRTP profile " << int(profile);
+			continue;
+		}
+		if (std::find(result.begin(), result.end(), profile) == result.end())
+			result.push_back(profile);
+	}
+
+	// RFC 8827: The DTLS-SRTP protection profile SRTP_AES128_CM_HMAC_SHA1_80 MUST be supported
+	// See https://www.rfc-editor.org/rfc/rfc8827.html#section-6.5
+	if (std::find(result.begin(), result.end(), SrtpProfile::Aes128CmHmacSha1_80) == result.end())
+		result.push_back(SrtpProfile::Aes128CmHmacSha1_80);
+
+	return result;
+}
+
+} // namespace
+
 void DtlsTransport::enqueueRecv() {
 	if (mPendingRecvCount > 0)
 		return;
 
 	if (auto shared_this = weak_from_this().lock()) {
+		// Handshakes run on the crypto pool so they don't delay established connections
+		auto &pool = state() == State::Connected ? ThreadPool::Instance()
+		                                         : ThreadPool::CryptoInstance();
 		++mPendingRecvCount;
-		ThreadPool::Instance().enqueue(&DtlsTransport::doRecv, std::move(shared_this));
+		pool.enqueue(&DtlsTransport::doRecv, std::move(shared_this));
 	}
 }
 
@@ -50,6 +99,7 @@ void DtlsTransport::Cleanup() { gnutls_global_deinit(); }
 DtlsTransport::DtlsTransport(shared_ptr<IceTransport> lower, certificate_ptr certificate,
                              optional<size_t> mtu,
                              CertificateFingerprint::Algorithm fingerprintAlgorithm,
+                             std::vector<SrtpProfile> srtpProfiles,
                              verifier_callback verifierCallback, state_callback stateChangeCallback)
     : Transport(lower, std::move(stateChangeCallback)), mMtu(mtu), mCertificate(certificate),
       mFingerprintAlgorithm(fingerprintAlgorithm), mVerifierCallback(std::move(verifierCallback)),
@@ -76,10 +126,30 @@ DtlsTransport::DtlsTransport(shared_ptr<IceTransport> lower, certificate_ptr cer
 		gnutls::check(gnutls_priority_set_direct(mSession, priorities, &err_pos),
 		              "Failed to set TLS priorities");
 
-		// RFC 8827: The DTLS-SRTP protection profile SRTP_AES128_CM_HMAC_SHA1_80 MUST be supported
-		// See https://www.rfc-editor.org/rfc/rfc8827.html#section-6.5
-		gnutls::check(gnutls_srtp_set_profile(mSession, GNUTLS_SRTP_AES128_CM_HMAC_SHA1_80),
-		              "Failed to set SRTP profile");
+		// Profiles are set by name as AES-GCM ones are missing from older GnuTLS versions
+		for (auto profile : SrtpProfilesToOffer(srtpProfiles)) {
+			const char *name = nullptr;
+			switch (profile) {
+			case SrtpProfile::Aes128CmHmacSha1_32:
+				name = "SRTP_AES128_CM_HMAC_SHA1_32";
+				break;
+			case SrtpProfile::AeadAes128Gcm:
+				name = "SRTP_AEAD_AES_128_GCM";
+				break;
+			case SrtpProfile::AeadAes256Gcm:
+				name = "SRTP_AEAD_AES_256_GCM";
+				break;
+			default:
+				name = "SRTP_AES128_CM_HMAC_SHA1_80";
+				break;
+			}
+			if (gnutls_srtp_set_profile_direct(mSession, name, nullptr) != GNUTLS_E_SUCCESS) {
+				if (profile == SrtpProfile::Aes128CmHmacSha1_80)
+					throw std::runtime_error("Failed to set SRTP profile");
+
+				PLOG_WARNING << "SRTP profile " << name << " is not supported by GnuTLS";
+			}
+		}
 
 		gnutls::check(gnutls_credentials_set(mSession, GNUTLS_CRD_CERTIFICATE, creds));
 
@@ -200,7 +270,7 @@ void DtlsTransport::doRecv() {
 				if (ret == GNUTLS_E_AGAIN) {
 					// Schedule next call on timeout and return
 					auto timeout = milliseconds(gnutls_dtls_get_timeout(mSession));
-					ThreadPool::Instance().schedule(timeout, [weak_this = weak_from_this()]() {
+					ThreadPool::CryptoInstance().schedule(timeout, [weak_this = weak_from_this()]() {
 						if (auto locked = weak_this.lock())
 							locked->doRecv();
 					});
@@ -369,14 +439,10 @@ int DtlsTransport::TimeoutCallback(gnutls_transport_ptr_t ptr, unsigned int /* m
 
 #elif USE_MBEDTLS
 
-const mbedtls_ssl_srtp_profile srtpSupportedProtectionProfiles[] = {
-    MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_80,
-    MBEDTLS_TLS_SRTP_UNSET,
-};
-
 DtlsTransport::DtlsTransport(shared_ptr<IceTransport> lower, certificate_ptr certificate,
                              optional<size_t> mtu,
                              CertificateFingerprint::Algorithm fingerprintAlgorithm,
+                             std::vector<SrtpProfile> srtpProfiles,
                              verifier_callback verifierCallback, state_callback stateChangeCallback)
     : Transport(lower, std::move(stateChangeCallback)), mMtu(mtu), mCertificate(certificate),
       mFingerprintAlgorithm(fingerprintAlgorithm), mVerifierCallback(std::move(verifierCallback)),
@@ -409,7 +475,12 @@ DtlsTransport::DtlsTransport(shared_ptr<IceTransport> lower, certificate_ptr cer
 		mbedtls::check(mbedtls_ssl_conf_own_cert(&mConf, crt.get(), pk.get()));
 
 		mbedtls_ssl_conf_dtls_cookies(&mConf, NULL, NULL, NULL);
-		mbedtls_ssl_conf_dtls_srtp_protection_profiles(&mConf, srtpSupportedProtectionProfiles);
+		for (auto profile : SrtpProfilesToOffer(srtpProfiles))
+			mSrtpProfiles.push_back(profile == SrtpProfile::Aes128CmHmacSha1_32
+			                            ? MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_32
+			                            : MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_80);
+		mSrtpProfiles.push_back(MBEDTLS_TLS_SRTP_UNSET);
+		mbedtls_ssl_conf_dtls_srtp_protection_profiles(&mConf, mSrtpProfiles.data());
 
 		mbedtls::check(mbedtls_ssl_setup(&mSsl, &mConf));
 
@@ -539,11 +610,11 @@ void DtlsTransport::doRecv() {
 				}
 
 				if (ret == MBEDTLS_ERR_SSL_WANT_READ) {
-					ThreadPool::Instance().schedule(mTimerSetAt + milliseconds(mFinMs),
-					                                [weak_this = weak_from_this()]() {
-						                                if (auto locked = weak_this.lock())
-							                                locked->doRecv();
-					                                });
+					ThreadPool::CryptoInstance().schedule(mTimerSetAt + milliseconds(mFinMs),
+					                                      [weak_this = weak_from_this()]() {
+						                                      if (auto locked = weak_this.lock())
+							                                      locked->doRecv();
+					                                      });
 					return;
 				}
 
@@ -697,6 +768,7 @@ int DtlsTransport::GetTimerCallback(void *ctx) {
 #else // OPENSSL
 
 BIO_METHOD *DtlsTransport::BioMethods = NULL;
+BIO_METHOD *DtlsTransport::BioReaderMethods = NULL;
 int DtlsTransport::TransportExIndex = -1;
 std::mutex DtlsTransport::GlobalMutex;
 
@@ -714,6 +786,15 @@ void DtlsTransport::Init() {
 		BIO_meth_set_write(BioMethods, BioMethodWrite);
 		BIO_meth_set_ctrl(BioMethods, BioMethodCtrl);
 	}
+	if (!BioReaderMethods) {
+		BioReaderMethods = BIO_meth_new(BIO_TYPE_BIO, "DTLS reader");
+		if (!BioReaderMethods)
+			throw std::runtime_error("Failed to create BIO methods for DTLS reader");
+		BIO_meth_set_create(BioReaderMethods, BioMethodNew);
+		BIO_meth_set_destroy(BioReaderMethods, BioMethodFree);
+		BIO_meth_set_read(BioReaderMethods, BioMethodRead);
+		BIO_meth_set_ctrl(BioReaderMethods, BioMethodCtrl);
+	}
 	if (TransportExIndex < 0) {
 		TransportExIndex = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
 	}
@@ -726,6 +807,7 @@ void DtlsTransport::Cleanup() {
 DtlsTransport::DtlsTransport(shared_ptr<IceTransport> lower, certificate_ptr certificate,
                              optional<size_t> mtu,
                              CertificateFingerprint::Algorithm fingerprintAlgorithm,
+                             std::vector<SrtpProfile> srtpProfiles,
                              verifier_callback verifierCallback, state_callback stateChangeCallback)
     : Transport(lower, std::move(stateChangeCallback)), mMtu(mtu), mCertificate(certificate),
       mFingerprintAlgorithm(fingerprintAlgorithm), mVerifierCallback(std::move(verifierCallback)),
@@ -784,33 +866,46 @@ DtlsTransport::DtlsTransport(shared_ptr<IceTransport> lower, certificate_ptr cer
 		else
 			SSL_set_accept_state(mSsl);
 
-		mInBio = BIO_new(BIO_s_mem());
+		// The input BIO reads straight from the incoming message instead of copying it into a
+		// memory BIO
+		mInBio = BIO_new(BioReaderMethods);
 		mOutBio = BIO_new(BioMethods);
 		if (!mInBio || !mOutBio)
 			throw std::runtime_error("Failed to create BIO");
 
-		BIO_set_mem_eof_return(mInBio, BIO_EOF);
+		BIO_set_data(mInBio, this);
 		BIO_set_data(mOutBio, this);
 		SSL_set_bio(mSsl, mInBio, mOutBio);
 
-		// RFC 8827: The DTLS-SRTP protection profile SRTP_AES128_CM_HMAC_SHA1_80 MUST be supported
-		// See https://www.rfc-editor.org/rfc/rfc8827.html#section-6.5
+		string profiles;
+		for (auto profile : SrtpProfilesToOffer(srtpProfiles)) {
+			if (!profiles.empty())
+				profiles += ':';
+
+			switch (profile) {
+			case SrtpProfile::Aes128CmHmacSha1_32:
+				profiles += "SRTP_AES128_CM_SHA1_32";
+				break;
+			case SrtpProfile::AeadAes128Gcm:
+				profiles += "SRTP_AEAD_AES_128_GCM";
+				break;
+			case SrtpProfile::AeadAes256Gcm:
+				profiles += "SRTP_AEAD_AES_256_GCM";
+				break;
+			default:
+				profiles += "SRTP_AES128_CM_SHA1_80";
+				break;
+			}
+		}
+
 		// Warning: SSL_set_tlsext_use_srtp() returns 0 on success and 1 on error
-#if RTC_ENABLE_MEDIA
-		// Try to use GCM suite
-		if (!DtlsSrtpTransport::IsGcmSupported() ||
-		    SSL_set_tlsext_use_srtp(
-		        mSsl, "SRTP_AEAD_AES_256_GCM:SRTP_AEAD_AES_128_GCM:SRTP_AES128_CM_SHA1_80")) {
-			PLOG_WARNING << "AES-GCM for SRTP is not supported, falling back to default profile";
+		if (SSL_set_tlsext_use_srtp(mSsl, profiles.c_str())) {
+			PLOG_WARNING << "SRTP profiles \"" << profiles
+			             << "\" are not supported, falling back to default profile";
 			if (SSL_set_tlsext_use_srtp(mSsl, "SRTP_AES128_CM_SHA1_80"))
 				throw std::runtime_error("Failed to set SRTP profile: " +
 				                         openssl::error_string(ERR_get_error()));
 		}
-#else
-		if (SSL_set_tlsext_use_srtp(mSsl, "SRTP_AES128_CM_SHA1_80"))
-			throw std::runtime_error("Failed to set SRTP profile: " +
-			                         openssl::error_string(ERR_get_error()));
-#endif
 	} catch (...) {
 		if (mSsl)
 			SSL_free(mSsl);
@@ -920,10 +1015,10 @@ void DtlsTransport::doRecv() {
 
 	try {
 		const size_t bufferSize = 4096;
-		byte buffer[bufferSize];
+		bool closed = false;
 
 		// Process pending messages
-		while (mIncomingQueue.running()) {
+		while (mIncomingQueue.running() && !closed) {
 			auto next = mIncomingQueue.pop();
 			if (!next) {
 				// No more messages pending, handle timeout if connecting
@@ -937,7 +1032,7 @@ void DtlsTransport::doRecv() {
 			if (demuxMessage(message))
 				continue;
 
-			BIO_write(mInBio, message->data(), int(message->size()));
+			mInput = message.get();
 
 			if (state() == State::Connecting) {
 				// Continue the handshake
@@ -963,21 +1058,52 @@ void DtlsTransport::doRecv() {
 			}
 
 			if (state() == State::Connected) {
-				int ret, err;
+				// The input BIO copies the whole datagram into the SSL read buffer before any record
+				// is decrypted, and a record can't be larger than the datagram carrying it, so the
+				// first record is decrypted in place if no previous record is still buffered.
+				bool inPlace;
 				{
 					std::lock_guard lock(mSslMutex);
-					ret = SSL_read(mSsl, buffer, bufferSize);
-					err = SSL_get_error(mSsl, ret);
+					inPlace = !SSL_has_pending(mSsl);
 				}
 
-				if (err == SSL_ERROR_ZERO_RETURN) {
-					PLOG_DEBUG << "TLS connection cleanly closed";
-					break;
-				}
+				// Read all records of the datagram
+				bool first = true;
+				while (true) {
+					if (!first) {
+						// The datagram is in the SSL read buffer now, stop when no record is left
+						// instead of allocating a buffer only to get SSL_ERROR_WANT_READ
+						std::lock_guard lock(mSslMutex);
+						if (!SSL_has_pending(mSsl))
+							break;
+					}
+
+					auto plaintext = inPlace ? message : make_message(bufferSize);
+					inPlace = false;
+					first = false;
+
+					int ret, err;
+					{
+						std::lock_guard lock(mSslMutex);
+						ret = SSL_read(mSsl, plaintext->data(), int(plaintext->size()));
+						err = SSL_get_error(mSsl, ret);
+					}
+
+					if (err == SSL_ERROR_ZERO_RETURN) {
+						PLOG_DEBUG << "TLS connection cleanly closed";
+						closed = true;
+						break;
+					}
 
-				if (openssl::check_error(err))
-					recv(make_message(buffer, buffer + ret));
+					if (!openssl::check_error(err))
+						break;
+
+					plaintext->resize(ret);
+					recv(std::move(plaintext));
+				}
 			}
+
+			mInput = nullptr;
 		}
 
 		std::lock_guard lock(mSslMutex);
@@ -985,6 +1111,7 @@ void DtlsTransport::doRecv() {
 
 	} catch (const std::exception &e) {
 		PLOG_ERROR << "DTLS recv: " << e.what();
+		mInput = nullptr;
 	}
 
 	if (state() == State::Connected) {
@@ -1019,7 +1146,7 @@ void DtlsTransport::handleTimeout() {
 			throw std::runtime_error("Handshake timeout");
 
 		LOG_VERBOSE << "DTLS retransmit timeout is " << timeout.count() << "ms";
-		ThreadPool::Instance().schedule(timeout, [weak_this = weak_from_this()]() {
+		ThreadPool::CryptoInstance().schedule(timeout, [weak_this = weak_from_this()]() {
 			if (auto locked = weak_this.lock())
 				locked->doRecv();
 		});
@@ -1075,6 +1202,25 @@ int DtlsTransport::BioMethodWrite(BIO *bio, const char *in, int inl) {
 	return inl; // can't fail
 }
 
+int DtlsTransport::BioMethodRead(BIO *bio, char *out, int outl) {
+	BIO_clear_retry_flags(bio);
+	auto transport = reinterpret_cast<DtlsTransport *>(BIO_get_data(bio));
+	if (!transport)
+		return -1;
+
+	// Like a datagram socket, the whole datagram is returned at once
+	auto message = transport->mInput;
+	if (!message) {
+		BIO_set_retry_read(bio);
+		return -1;
+	}
+
+	transport->mInput = nullptr;
+	int len = std::min(outl, int(message->size()));
+	std::memcpy(out, message->data(), len);
+	return len;
+}
+
 long DtlsTransport::BioMethodCtrl(BIO * /*bio*/, int cmd, long /*num*/, void * /*ptr*/) {
 	switch (cmd) {
 	case BIO_CTRL_FLUSH:
@@ -11,6 +11,7 @@
 
 #include "certificate.hpp"
 #include "common.hpp"
+#include "configuration.hpp"
 #include "queue.hpp"
 #include "tls.hpp"
 #include "transport.hpp"
@@ -19,6 +20,7 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 namespace rtc::impl {
 
@@ -33,7 +35,8 @@ public:
 
 	DtlsTransport(shared_ptr<IceTransport> lower, certificate_ptr certificate, optional<size_t> mtu,
 	              CertificateFingerprint::Algorithm fingerprintAlgorithm,
-	              verifier_callback verifierCallback, state_callback stateChangeCallback);
+	              std::vector<SrtpProfile> srtpProfiles, verifier_callback verifierCallback,
+	              state_callback stateChangeCallback);
 	~DtlsTransport();
 
 	virtual void start() override;
@@ -86,6 +89,7 @@ protected:
 	char mMasterSecret[48];
 	char mRandBytes[64];
 	mbedtls_tls_prf_types mTlsProfile = MBEDTLS_SSL_TLS_PRF_NONE;
+	std::vector<mbedtls_ssl_srtp_profile> mSrtpProfiles; // terminated by MBEDTLS_TLS_SRTP_UNSET
 
 	static int CertificateCallback(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags);
 	static int WriteCallback(void *ctx, const unsigned char *buf, size_t len);
@@ -103,10 +107,12 @@ protected:
 	SSL *mSsl = NULL;
 	BIO *mInBio, *mOutBio;
 	std::mutex mSslMutex;
+	Message *mInput = nullptr; // datagram to be read by the input BIO
 
 	void handleTimeout();
 
 	static BIO_METHOD *BioMethods;
+	static BIO_METHOD *BioReaderMethods;
 	static int TransportExIndex;
 	static std::mutex GlobalMutex;
 
@@ -116,6 +122,7 @@ protected:
 	static int BioMethodNew(BIO *bio);
 	static int BioMethodFree(BIO *bio);
 	static int BioMethodWrite(BIO *bio, const char *in, int inl);
+	static int BioMethodRead(BIO *bio, char *out, int outl);
 	static long BioMethodCtrl(BIO *bio, int cmd, long num, void *ptr);
 #endif
 };
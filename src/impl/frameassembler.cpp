@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "frameassembler.hpp"
+
+#include <cstring>
+
+namespace rtc::impl {
+
+namespace {
+
+const byte LongStartCode[] = {byte{0}, byte{0}, byte{0}, byte{1}};
+const byte ShortStartCode[] = {byte{0}, byte{0}, byte{1}};
+
+} // namespace
+
+void FrameAssembler::beginUnit() {
+	endUnit();
+	mInUnit = true;
+}
+
+void FrameAssembler::beginNalUnit(NalUnit::Separator separator) {
+	beginUnit();
+	switch (separator) {
+	case NalUnit::Separator::Length:
+		addLengthField(LengthField::Fixed32);
+		break;
+	case NalUnit::Separator::ShortStartSequence:
+		addGenerated(ShortStartCode, sizeof(ShortStartCode));
+		break;
+	default:
+		addGenerated(LongStartCode, sizeof(LongStartCode));
+		break;
+	}
+}
+
+void FrameAssembler::endUnit() {
+	if (!mInUnit)
+		return;
+
+	mInUnit = false;
+	if (!mLengthPiece)
+		return;
+
+	// The field goes at the end of the generated buffer, pieces only reference offsets
+	auto &piece = mPieces[*mLengthPiece];
+	piece.offset = mGenerated.size();
+	size_t value = mLengthValue;
+	if (mLengthField == LengthField::Fixed32) {
+		for (int i = 3; i >= 0; --i)
+			mGenerated.push_back(byte((value >> (8 * i)) & 0xFF));
+	} else {
+		do {
+			uint8_t b = value & 0x7F;
+			value >>= 7;
+			mGenerated.push_back(byte(value ? b | 0x80 : b));
+		} while (value);
+	}
+
+	piece.size = mGenerated.size() - piece.offset;
+	mSize += piece.size;
+	mLengthPiece.reset();
+}
+
+void FrameAssembler::addLengthField(LengthField field) {
+	mLengthPiece = mPieces.size();
+	mLengthField = field;
+	mLengthValue = 0;
+	mPieces.push_back(Piece{nullptr, 0, 0});
+}
+
+void FrameAssembler::addGenerated(const byte *data, size_t size) {
+	if (size == 0)
+		return;
+
+	mPieces.push_back(Piece{nullptr, mGenerated.size(), size});
+	mGenerated.insert(mGenerated.end(), data, data + size);
+	mSize += size;
+	mLengthValue += size;
+}
+
+void FrameAssembler::addPayload(const message_ptr &packet, size_t offset, size_t size) {
+	if (size == 0)
+		return;
+
+	mPieces.push_back(Piece{packet, offset, size});
+	mSize += size;
+	mLengthValue += size;
+}
+
+message_ptr FrameAssembler::finish(shared_ptr<FrameInfo> frameInfo, bool slices) {
+	endUnit();
+
+	if (slices) {
+		auto generated = std::make_shared<binary>(std::move(mGenerated));
+		frameInfo->slices.reserve(mPieces.size());
+		for (const auto &piece : mPieces)
+			if (piece.size > 0)
+				frameInfo->slices.push_back(FrameInfo::Slice{
+				    piece.packet ? binary_ptr(piece.packet) : generated, piece.offset, piece.size});
+
+		auto message = make_message(0, Message::Binary);
+		message->frameInfo = std::move(frameInfo);
+		return message;
+	}
+
+	auto message = make_message(mSize, Message::Binary);
+	message->frameInfo = std::move(frameInfo);
+	byte *dst = message->data();
+	for (const auto &piece : mPieces) {
+		if (piece.size == 0)
+			continue;
+
+		const byte *src = piece.packet ? piece.packet->data() : mGenerated.data();
+		std::memcpy(dst, src + piece.offset, piece.size);
+		dst += piece.size;
+	}
+	return message;
+}
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_IMPL_FRAME_ASSEMBLER_H
+#define RTC_IMPL_FRAME_ASSEMBLER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+#include "frameinfo.hpp"
+#include "message.hpp"
+#include "nalunit.hpp"
+
+#include <vector>
+
+namespace rtc::impl {
+
+// Collects the pieces of a frame, either references to packet payloads or generated bytes like
+// separators and reconstructed headers, so the exact size is known before anything is copied.
+// A frame is a sequence of units (NAL units or OBUs), each one may contain a length field which
+// is filled with the size of the rest of the unit when it ends.
+class FrameAssembler final {
+public:
+	enum class LengthField { Fixed32, Leb128 };
+
+	void beginUnit(); // ends the current unit if any
+	void beginNalUnit(NalUnit::Separator separator);
+	void endUnit();
+
+	void addLengthField(LengthField field); // at most once per unit
+	void addGenerated(const byte *data, size_t size);
+	void addPayload(const message_ptr &packet, size_t offset, size_t size);
+
+	bool inUnit() const { return mInUnit; }
+	bool empty() const { return mPieces.empty(); }
+
+	// Returns a message with the contiguous frame, or an empty one with the frame as slices
+	message_ptr finish(shared_ptr<FrameInfo> frameInfo, bool slices);
+
+private:
+	struct Piece {
+		message_ptr packet; // null for generated bytes
+		size_t offset;
+		size_t size;
+	};
+
+	std::vector<Piece> mPieces;
+	binary mGenerated;
+	size_t mSize = 0;
+
+	bool mInUnit = false;
+	optional<size_t> mLengthPiece; // index of the length field piece in the current unit
+	LengthField mLengthField = LengthField::Fixed32;
+	size_t mLengthValue = 0;
+};
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif
@@ -91,6 +91,10 @@ void Init::preload() {
 }
 
 std::shared_future<void> Init::cleanup() {
+	// Pending certificate generations hold init tokens, so they must be over before releasing the
+	// global token for the cleanup to happen
+	CertificateCache::Instance().clear();
+
 	std::lock_guard lock(mMutex);
 	mGlobal.reset();
 	return mCleanupFuture;
@@ -104,6 +108,11 @@ void Init::setSctpSettings(SctpSettings s) {
 	mCurrentSctpSettings = std::move(s); // store for next init
 }
 
+void Init::setCryptoConcurrency(int count) {
+	std::lock_guard lock(mMutex);
+	mCryptoConcurrency = count; // applied on next init
+}
+
 void Init::doInit() {
 	// mMutex needs to be locked
 
@@ -123,6 +132,11 @@ void Init::doInit() {
 	PLOG_DEBUG << "Spawning " << count << " threads";
 	ThreadPool::Instance().spawn(count);
 
+	// Handshakes and key generation are limited to their own pool
+	int cryptoCount = mCryptoConcurrency > 0 ? mCryptoConcurrency : std::max(concurrency / 2, 1);
+	PLOG_DEBUG << "Spawning " << cryptoCount << " crypto threads";
+	ThreadPool::CryptoInstance().spawn(cryptoCount);
+
 #if RTC_ENABLE_WEBSOCKET
 	PollService::Instance().start();
 #endif
@@ -157,8 +171,11 @@ void Init::doCleanup() {
 
 	PLOG_DEBUG << "Global cleanup";
 
+	// Tasks on the main pool may still submit to the crypto pool, so join it first
 	ThreadPool::Instance().join();
+	ThreadPool::CryptoInstance().join();
 	ThreadPool::Instance().clear();
+	ThreadPool::CryptoInstance().clear();
 #if RTC_ENABLE_WEBSOCKET
 	PollService::Instance().join();
 #endif
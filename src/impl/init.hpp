@@ -33,6 +33,7 @@ public:
 	void preload();
 	std::shared_future<void> cleanup();
 	void setSctpSettings(SctpSettings s);
+	void setCryptoConcurrency(int count);
 
 private:
 	Init();
@@ -45,6 +46,7 @@ private:
 	weak_ptr<void> mWeak;
 	bool mInitialized = false;
 	SctpSettings mCurrentSctpSettings = {};
+	int mCryptoConcurrency = 0;
 	std::mutex mMutex;
 	std::shared_future<void> mCleanupFuture;
 
@@ -27,6 +27,8 @@
 #pragma warning(pop)
 #endif
 
+#include <chrono>
+
 namespace rtc {
 
 const size_t MAX_NUMERICNODE_LEN = 48; // Max IPv6 string representation length
@@ -38,6 +40,8 @@ const uint16_t MAX_SCTP_STREAMS_COUNT = 1024; // Max number of negotiated SCTP s
                                               // RFC 8831 recommends 65535 but usrsctp needs a lot
                                               // of memory, Chromium historically limits to 1024.
 
+const size_t INITIAL_SCTP_BUFFER_SIZE = 256 * 1024; // Initial SCTP buffer size, grown on demand
+
 const size_t DEFAULT_LOCAL_MAX_MESSAGE_SIZE = 256 * 1024; // Default local max message size
 const size_t DEFAULT_REMOTE_MAX_MESSAGE_SIZE = 65536;     // Remote max message size if not in SDP
 
@@ -45,10 +49,14 @@ const size_t DEFAULT_WS_MAX_MESSAGE_SIZE = 256 * 1024;   // Default max message
 
 const size_t RECV_QUEUE_LIMIT = 1024; // Max per-channel queue size (messages)
 
+const size_t SRTP_RECV_BATCH_SIZE = 64; // Max number of queued SRTP packets unprotected at once
+
 const int MIN_THREADPOOL_SIZE = 4; // Minimum number of threads in the global thread pool (>= 2)
 
 const size_t DEFAULT_MTU = RTC_DEFAULT_MTU; // defined in rtc.h
 
+const auto DEFAULT_RTT = std::chrono::milliseconds(100); // Round-trip time until it is measured
+
 } // namespace rtc
 
 #endif
@@ -25,11 +25,17 @@
 
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <iomanip>
-#include <set>
 #include <sstream>
 #include <thread>
 
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
 using namespace std::placeholders;
 
 namespace rtc::impl {
@@ -46,6 +52,9 @@ static LogCounter
 
 const string PemBeginCertificateTag = "-----BEGIN CERTIFICATE-----";
 
+// Maximum number of unsignaled SSRC bindings, the oldest ones are forgotten first
+const size_t MaxLearnedSsrcs = 64;
+
 PeerConnection::PeerConnection(Configuration config_) : config(std::move(config_)) {
 	PLOG_VERBOSE << "Creating PeerConnection";
 
@@ -250,10 +259,17 @@ shared_ptr<DtlsTransport> PeerConnection::initDtlsTransport() {
 
 			    switch (transportState) {
 			    case DtlsTransport::State::Connected:
-				    if (auto remote = remoteDescription(); remote && remote->hasApplication())
-					    initSctpTransport();
-				    else
+				    if (auto remote = remoteDescription(); remote && remote->hasApplication()) {
+					    // SCTP is started only once a DataChannel needs it
+					    if (hasDataChannels()) {
+						    initSctpTransport();
+					    } else {
+						    deferSctpTransport();
+						    changeState(State::Connected);
+					    }
+				    } else {
 					    changeState(State::Connected);
+				    }
 
 				    mProcessor.enqueue(&PeerConnection::openTracks, shared_from_this());
 				    break;
@@ -279,8 +295,9 @@ shared_ptr<DtlsTransport> PeerConnection::initDtlsTransport() {
 
 			// DTLS-SRTP
 			transport = std::make_shared<DtlsSrtpTransport>(
-			    lower, certificate, config.mtu, fingerprintAlgorithm, verifierCallback,
-			    weak_bind(&PeerConnection::forwardMedia, this, _1), dtlsStateChangeCallback);
+			    lower, certificate, config.mtu, fingerprintAlgorithm, config.srtpProfiles,
+			    verifierCallback, weak_bind(&PeerConnection::forwardMedia, this, _1),
+			    dtlsStateChangeCallback);
 #else
 			PLOG_WARNING << "Ignoring media support (not compiled with media support)";
 #endif
@@ -288,9 +305,9 @@ shared_ptr<DtlsTransport> PeerConnection::initDtlsTransport() {
 
 		if (!transport) {
 			// DTLS only
-			transport = std::make_shared<DtlsTransport>(lower, certificate, config.mtu,
-			                                            fingerprintAlgorithm, verifierCallback,
-			                                            dtlsStateChangeCallback);
+			transport = std::make_shared<DtlsTransport>(
+			    lower, certificate, config.mtu, fingerprintAlgorithm, config.srtpProfiles,
+			    verifierCallback, dtlsStateChangeCallback);
 		}
 
 		return emplaceTransport(this, &mDtlsTransport, std::move(transport));
@@ -363,6 +380,39 @@ shared_ptr<SctpTransport> PeerConnection::initSctpTransport() {
 	}
 }
 
+void PeerConnection::deferSctpTransport() {
+	auto lower = std::atomic_load(&mDtlsTransport);
+	if (!lower)
+		return;
+
+	PLOG_VERBOSE << "Deferring SCTP transport until a DataChannel is needed";
+
+	// Note browsers send the SCTP INIT right after the DTLS handshake when the application media
+	// is negotiated, so deferring only saves resources when the remote peer is also lazy.
+	// The SCTP transport will replace this callback when starting, messages received before are
+	// passed to it once started.
+	lower->onRecv([this, weak_this = weak_from_this()](message_ptr message) {
+		auto shared_this = weak_this.lock();
+		if (!shared_this || !message)
+			return;
+
+		mProcessor.enqueue(&PeerConnection::startSctpTransport, std::move(shared_this),
+		                   std::move(message));
+	});
+}
+
+void PeerConnection::startSctpTransport(message_ptr message) {
+	try {
+		auto transport = initSctpTransport();
+		if (transport && message)
+			transport->inject(std::move(message));
+
+	} catch (const std::exception &e) {
+		PLOG_ERROR << e.what();
+		changeState(State::Failed);
+	}
+}
+
 shared_ptr<IceTransport> PeerConnection::getIceTransport() const {
 	return std::atomic_load(&mIceTransport);
 }
@@ -530,114 +580,243 @@ void PeerConnection::forwardMessage(message_ptr message) {
 	}
 }
 
-void PeerConnection::forwardMedia([[maybe_unused]] message_ptr message) {
+void PeerConnection::forwardMedia([[maybe_unused]] message_vector messages) {
 #if RTC_ENABLE_MEDIA
-	if (!message)
+	if (messages.empty())
 		return;
 
 	// TODO: outgoing
 	if (auto handler = getMediaHandler()) {
-		message_vector messages{std::move(message)};
-
 		handler->incoming(messages, [this](message_ptr message) {
 			auto transport = std::atomic_load(&mDtlsTransport);
 			if (auto srtpTransport = std::dynamic_pointer_cast<DtlsSrtpTransport>(transport))
 				srtpTransport->send(std::move(message));
 		});
-
-		for (auto &m : messages)
-			dispatchMedia(std::move(m));
-
-	} else {
-		dispatchMedia(std::move(message));
 	}
+
+	for (auto &m : messages)
+		dispatchMedia(std::move(m));
 #endif
 }
 
 void PeerConnection::dispatchMedia([[maybe_unused]] message_ptr message) {
 #if RTC_ENABLE_MEDIA
-	std::shared_lock lock(mTracksMutex); // read-only
-	if (mTrackLines.size() == 1) {
-		if (auto track = mTrackLines.front().lock())
-			track->incoming(message);
+	// The table is replaced on renegotiation, the loaded one stays valid while it is in use
+	auto table = std::atomic_load(&mSsrcTable);
+	if (!table)
+		return;
+
+	if (auto track = table->single()) {
+		track->incoming(message);
 		return;
 	}
-	// Browsers like to compound their packets with a random SSRC.
-	// we have to do this monstrosity to distribute the report blocks
-	if (message->type == Message::Control) {
-		std::set<uint32_t> ssrcs;
-		size_t offset = 0;
-		while ((sizeof(RtcpHeader) + offset) <= message->size()) {
-			auto header = reinterpret_cast<RtcpHeader *>(message->data() + offset);
-			if (header->lengthInBytes() > message->size() - offset) {
-				COUNTER_MEDIA_TRUNCATED++;
-				break;
-			}
-			offset += header->lengthInBytes();
-			if (header->payloadType() == 205 || header->payloadType() == 206) {
-				auto rtcpfb = reinterpret_cast<RtcpFbHeader *>(header);
-				ssrcs.insert(rtcpfb->packetSenderSSRC());
-				ssrcs.insert(rtcpfb->mediaSourceSSRC());
-
-			} else if (header->payloadType() == 200) {
-				auto rtcpsr = reinterpret_cast<RtcpSr *>(header);
-				ssrcs.insert(rtcpsr->senderSSRC());
-				for (int i = 0; i < rtcpsr->header.reportCount(); ++i)
-					ssrcs.insert(rtcpsr->getReportBlock(i)->getSSRC());
-			} else if (header->payloadType() == 201) {
-				auto rtcprr = reinterpret_cast<RtcpRr *>(header);
-				ssrcs.insert(rtcprr->senderSSRC());
-				for (int i = 0; i < rtcprr->header.reportCount(); ++i)
-					ssrcs.insert(rtcprr->getReportBlock(i)->getSSRC());
-			} else if (header->payloadType() == 202) {
-				auto sdes = reinterpret_cast<RtcpSdes *>(header);
-				if (!sdes->isValid()) {
-					PLOG_WARNING << "RTCP SDES packet is invalid";
-					continue;
-				}
-				for (unsigned int i = 0; i < sdes->chunksCount(); i++) {
-					auto chunk = sdes->getChunk(i);
-					ssrcs.insert(chunk->ssrc());
-				}
+
+	// Browsers like to compound their packets with a random SSRC, so compound RTCP packets are
+	// sliced to give each track only the parts which concern it
+	if (message->type == Message::Control && dispatchRtcp(*table, message))
+		return;
+
+	uint32_t ssrc = uint32_t(message->stream);
+
+	if (auto track = table->find(ssrc)) {
+		track->incoming(message);
+		return;
+	}
+
+	// The SSRC was not signaled, for instance with simulcast, so try to route the packet with
+	// its MID or RID header extension and learn the binding for the next ones
+	if (auto track = table->route(message)) {
+		bindSsrc(ssrc, track);
+		track->incoming(message);
+		return;
+	}
+
+	// Compound RTCP packets may end up here when remote streams stop and their report blocks
+	// vanish, there is nothing to forward then
+	// PLOG_WARNING << "Track not found for SSRC " << ssrc << ", dropping";
+#endif
+}
+
+#if RTC_ENABLE_MEDIA
+bool PeerConnection::dispatchRtcp(const SsrcTable &table, const message_ptr &message) {
+	// Slices are grouped by track, there are usually only a handful of tracks per compound packet
+	std::vector<std::pair<Track *, binary>> slices;
+	auto sliceFor = [&slices](Track *track) -> binary & {
+		for (auto &[t, data] : slices)
+			if (t == track)
+				return data;
+
+		return slices.emplace_back(track, binary{}).second;
+	};
+	auto append = [](binary &data, const void *ptr, size_t size) {
+		auto b = reinterpret_cast<const byte *>(ptr);
+		data.insert(data.end(), b, b + size);
+	};
+	auto appendTo = [&](uint32_t ssrc, const void *ptr, size_t size) {
+		if (auto track = table.find(ssrc))
+			append(sliceFor(track), ptr, size);
+	};
+
+	// Converts report blocks to one RR per destination track
+	std::vector<std::pair<Track *, std::vector<const RtcpReportBlock *>>> blocks;
+	auto appendReportBlocks = [&](uint32_t senderSsrc, const RtcpReportBlock *first, int count) {
+		blocks.clear();
+		for (int i = 0; i < count; ++i) {
+			auto block = first + i;
+			auto track = table.find(block->getSSRC());
+			if (!track)
+				continue;
+
+			auto it = std::find_if(blocks.begin(), blocks.end(),
+			                       [track](const auto &p) { return p.first == track; });
+			if (it == blocks.end())
+				it = blocks.emplace(blocks.end(), track, std::vector<const RtcpReportBlock *>{});
+
+			it->second.push_back(block);
+		}
+
+		for (const auto &[track, trackBlocks] : blocks) {
+			auto &data = sliceFor(track);
+			size_t start = data.size();
+			data.resize(start + RtcpRr::SizeWithReportBlocks(uint8_t(trackBlocks.size())));
+			auto rr = reinterpret_cast<RtcpRr *>(data.data() + start);
+			rr->preparePacket(senderSsrc, uint8_t(trackBlocks.size()));
+			for (size_t i = 0; i < trackBlocks.size(); ++i)
+				*rr->getReportBlock(int(i)) = *trackBlocks[i];
+		}
+	};
+
+	bool hasSsrcs = false;
+	size_t offset = 0;
+	while ((sizeof(RtcpHeader) + offset) <= message->size()) {
+		auto header = reinterpret_cast<RtcpHeader *>(message->data() + offset);
+		size_t length = header->lengthInBytes();
+		if (length > message->size() - offset) {
+			COUNTER_MEDIA_TRUNCATED++;
+			break;
+		}
+		offset += length;
+
+		const uint8_t payloadType = header->payloadType();
+		if (payloadType == 205 || payloadType == 206) {
+			if (length < sizeof(RtcpFbHeader))
+				continue;
+
+			// Feedback concerns the media source, except REMB which lists SSRCs. REMB is sent as
+			// application layer feedback, so it must be identified by its "REMB" unique identifier.
+			auto rtcpfb = reinterpret_cast<RtcpFbHeader *>(header);
+			auto remb = reinterpret_cast<RtcpRemb *>(header);
+			hasSsrcs = true;
+			if (payloadType == 206 && header->reportCount() == 15 &&
+			    length >= RtcpRemb::SizeWithSSRCs(1) && std::memcmp(remb->_id, "REMB", 4) == 0) {
+				unsigned int count = std::min(remb->getNumSSRC(),
+				                              unsigned((length - offsetof(RtcpRemb, _ssrc)) / 4));
+				utils::small_set<Track *> tracks;
+				for (unsigned int i = 0; i < count; ++i)
+					if (auto track = table.find(ntohl(remb->_ssrc[i])))
+						tracks.insert(track);
+
+				for (auto track : tracks)
+					append(sliceFor(track), header, length);
+
+			} else if (auto track = table.find(rtcpfb->mediaSourceSSRC())) {
+				append(sliceFor(track), header, length);
 			} else {
-				// PT=203 == Goodbye
-				// PT=204 == Application Specific
-				// PT=207 == Extended Report
-				if (header->payloadType() != 203 && header->payloadType() != 204 &&
-				    header->payloadType() != 207) {
-					COUNTER_UNKNOWN_PACKET_TYPE++;
-				}
+				appendTo(rtcpfb->packetSenderSSRC(), header, length);
 			}
-		}
 
-		if (!ssrcs.empty()) {
-			for (uint32_t ssrc : ssrcs) {
-				if (auto it = mTracksBySsrc.find(ssrc); it != mTracksBySsrc.end()) {
-					if (auto track = it->second.lock())
-						track->incoming(message);
+		} else if (payloadType == 200) {
+			if (length < RtcpSr::Size(0))
+				continue;
+
+			// The sender info goes to the track receiving from the sender
+			auto rtcpsr = reinterpret_cast<RtcpSr *>(header);
+			hasSsrcs = true;
+			if (auto track = table.find(rtcpsr->senderSSRC())) {
+				auto &data = sliceFor(track);
+				size_t start = data.size();
+				append(data, header, RtcpSr::Size(0));
+				auto sr = reinterpret_cast<RtcpSr *>(data.data() + start);
+				sr->preparePacket(rtcpsr->senderSSRC(), 0);
+			}
+
+			int count = std::min(int(header->reportCount()),
+			                     int((length - RtcpSr::Size(0)) / sizeof(RtcpReportBlock)));
+			appendReportBlocks(rtcpsr->senderSSRC(), rtcpsr->getReportBlock(0), count);
+
+		} else if (payloadType == 201) {
+			if (length < RtcpRr::SizeWithReportBlocks(0))
+				continue;
+
+			auto rtcprr = reinterpret_cast<RtcpRr *>(header);
+			hasSsrcs = true;
+			int count = std::min(int(header->reportCount()),
+			                     int((length - RtcpRr::SizeWithReportBlocks(0)) /
+			                         sizeof(RtcpReportBlock)));
+			if (count > 0)
+				appendReportBlocks(rtcprr->senderSSRC(), rtcprr->getReportBlock(0), count);
+			else
+				appendTo(rtcprr->senderSSRC(), header, length);
+
+		} else if (payloadType == 202) {
+			auto sdes = reinterpret_cast<RtcpSdes *>(header);
+			if (!sdes->isValid()) {
+				PLOG_WARNING << "RTCP SDES packet is invalid";
+				continue;
+			}
+
+			// Each chunk goes in its own SDES packet
+			for (unsigned int i = 0; i < sdes->chunksCount(); i++) {
+				auto chunk = sdes->getChunk(i);
+				hasSsrcs = true;
+				if (auto track = table.find(chunk->ssrc())) {
+					auto &data = sliceFor(track);
+					size_t start = data.size();
+					size_t chunkSize = chunk->getSize();
+					data.resize(start + sizeof(RtcpHeader));
+					append(data, chunk, chunkSize);
+					auto sliced = reinterpret_cast<RtcpHeader *>(data.data() + start);
+					auto slicedLength = uint16_t((sizeof(RtcpHeader) + chunkSize) / 4 - 1);
+					sliced->prepareHeader(202, 1, slicedLength);
 				}
 			}
-			return;
+
+		} else if (payloadType == 203) {
+			// Goodbye lists SSRCs
+			int count = std::min(int(header->reportCount()),
+			                     int((length - sizeof(RtcpHeader)) / sizeof(uint32_t)));
+			auto ssrcs = reinterpret_cast<const uint32_t *>(header + 1);
+			utils::small_set<Track *> tracks;
+			for (int i = 0; i < count; ++i)
+				if (auto track = table.find(ntohl(ssrcs[i])))
+					tracks.insert(track);
+
+			hasSsrcs |= count > 0;
+			for (auto track : tracks)
+				append(sliceFor(track), header, length);
+
+		} else if (payloadType == 204 || payloadType == 207) {
+			// Application Specific and Extended Report concern the sender
+			if (length < sizeof(RtcpHeader) + sizeof(uint32_t))
+				continue;
+
+			hasSsrcs = true;
+			appendTo(ntohl(*reinterpret_cast<const uint32_t *>(header + 1)), header, length);
+
+		} else {
+			COUNTER_UNKNOWN_PACKET_TYPE++;
 		}
 	}
 
-	uint32_t ssrc = uint32_t(message->stream);
+	if (!hasSsrcs)
+		return false;
 
-	if (auto it = mTracksBySsrc.find(ssrc); it != mTracksBySsrc.end()) {
-		if (auto track = it->second.lock())
-			track->incoming(message);
-	} else {
-		/*
-		 * TODO: So the problem is that when stop sending streams, we stop getting report blocks for
-		 * those streams Therefore when we get compound RTCP packets, they are empty, and we can't
-		 * forward them. Therefore, it is expected that we don't know where to forward packets. Is
-		 * this ideal? No! Do I know how to fix it? No!
-		 */
-		// PLOG_WARNING << "Track not found for SSRC " << ssrc << ", dropping";
-		return;
-	}
-#endif
+	for (auto &[track, data] : slices)
+		track->incoming(make_message(std::move(data), Message::Control, message->stream));
+
+	return true;
 }
+#endif
 
 void PeerConnection::forwardBufferedAmount(uint16_t stream, size_t amount) {
 	[[maybe_unused]] auto [channel, found] = findDataChannel(stream);
@@ -677,6 +856,15 @@ shared_ptr<DataChannel> PeerConnection::emplaceDataChannel(string label, DataCha
 	if (sctpTransport && sctpTransport->state() == SctpTransport::State::Connected) {
 		assignDataChannels();
 		channel->open(sctpTransport);
+
+	} else if (!sctpTransport) {
+		// If SCTP was deferred, start it now
+		auto dtlsTransport = std::atomic_load(&mDtlsTransport);
+		auto local = localDescription();
+		auto remote = remoteDescription();
+		if (dtlsTransport && dtlsTransport->state() == Transport::State::Connected && local &&
+		    local->hasApplication() && remote && remote->hasApplication())
+			mProcessor.enqueue(&PeerConnection::startSctpTransport, shared_from_this(), nullptr);
 	}
 
 	return channel;
@@ -695,6 +883,11 @@ bool PeerConnection::removeDataChannel(uint16_t stream) {
 	return mDataChannels.erase(stream) != 0;
 }
 
+bool PeerConnection::hasDataChannels() {
+	std::shared_lock lock(mDataChannelsMutex); // read-only
+	return !mDataChannels.empty() || !mUnassignedDataChannels.empty();
+}
+
 uint16_t PeerConnection::maxDataChannelStream() const {
 	auto sctpTransport = std::atomic_load(&mSctpTransport);
 	return sctpTransport ? sctpTransport->maxStream() : (MAX_SCTP_STREAMS_COUNT - 1);
@@ -796,11 +989,12 @@ shared_ptr<Track> PeerConnection::emplaceTrack(Description::Media description) {
 		track = std::make_shared<Track>(weak_from_this(), std::move(description));
 		mTracks.emplace(std::make_pair(track->mid(), track));
 		mTrackLines.emplace_back(track);
+		updateSsrcTable();
 	}
 
 	auto handler = getMediaHandler();
 	if (handler)
-		handler->media(track->description());
+		handler->mediaChain(track->description());
 
 	if (track->description().isRemoved())
 		track->close();
@@ -854,8 +1048,22 @@ void PeerConnection::openTracks() {
 }
 
 void PeerConnection::closeTracks() {
-	std::shared_lock lock(mTracksMutex); // read-only
-	iterateTracks([&](shared_ptr<Track> track) { track->close(); });
+	{
+		std::shared_lock lock(mTracksMutex); // read-only
+		iterateTracks([&](shared_ptr<Track> track) { track->close(); });
+	}
+
+	// Release the strong references held by the table
+	std::atomic_store(&mSsrcTable, shared_ptr<const SsrcTable>());
+}
+
+void PeerConnection::releaseTracks() {
+	mProcessor.enqueue([weak_this = weak_from_this()]() {
+		if (auto locked = weak_this.lock()) {
+			std::unique_lock lock(locked->mTracksMutex);
+			locked->updateSsrcTable();
+		}
+	});
 }
 
 void PeerConnection::validateRemoteDescription(const Description &description) {
@@ -975,7 +1183,7 @@ void PeerConnection::processLocalDescription(Description description) {
 
 				        auto handler = getMediaHandler();
 				        if (handler)
-					        handler->media(track->description());
+					        handler->mediaChain(track->description());
 
 				        if (track->description().isRemoved())
 					        track->close();
@@ -1106,8 +1314,12 @@ void PeerConnection::processRemoteDescription(Description description) {
 		auto dtlsTransport = std::atomic_load(&mDtlsTransport);
 		auto sctpTransport = std::atomic_load(&mSctpTransport);
 		if (!sctpTransport && dtlsTransport &&
-		    dtlsTransport->state() == Transport::State::Connected)
-			initSctpTransport();
+		    dtlsTransport->state() == Transport::State::Connected) {
+			if (hasDataChannels())
+				initSctpTransport();
+			else
+				deferSctpTransport();
+		}
 	} else {
 		mProcessor.enqueue(&PeerConnection::remoteCloseDataChannels, shared_from_this());
 	}
@@ -1320,6 +1532,12 @@ CertificateFingerprint PeerConnection::remoteFingerprint() {
 void PeerConnection::updateTrackSsrcCache(const Description &description) {
 	std::unique_lock lock(mTracksMutex); // for safely writing to mTracksBySsrc
 
+	// Forget learned bindings, they are learned again from header extensions if still in use
+	for (uint32_t ssrc : mLearnedSsrcs)
+		mTracksBySsrc.erase(ssrc);
+
+	mLearnedSsrcs.clear();
+
 	// Setup SSRC -> Track mapping
 	for (unsigned int i = 0; i < description.mediaCount(); ++i)
 		std::visit( // ssrc -> track mapping
@@ -1350,6 +1568,48 @@ void PeerConnection::updateTrackSsrcCache(const Description &description) {
 		        },
 		    },
 		    description.media(i));
+
+	updateSsrcTable();
 }
 
+void PeerConnection::updateSsrcTable() {
+	// Closed tracks are left out so their references are released
+	for (auto it = mTracksBySsrc.begin(); it != mTracksBySsrc.end();) {
+		auto track = it->second.lock();
+		if (!track || track->isClosed())
+			it = mTracksBySsrc.erase(it);
+		else
+			++it;
+	}
+
+	auto unbound = [this](uint32_t ssrc) { return mTracksBySsrc.count(ssrc) == 0; };
+	mLearnedSsrcs.erase(std::remove_if(mLearnedSsrcs.begin(), mLearnedSsrcs.end(), unbound),
+	                    mLearnedSsrcs.end());
+
+	std::atomic_store(&mSsrcTable, std::make_shared<const SsrcTable>(mTracksBySsrc, mTrackLines));
+}
+
+#if RTC_ENABLE_MEDIA
+void PeerConnection::bindSsrc(uint32_t ssrc, shared_ptr<Track> track) {
+	std::unique_lock lock(mTracksMutex); // for safely writing to mTracksBySsrc
+	if (track->isClosed())
+		return;
+
+	// Another packet with the same SSRC might have been routed concurrently
+	if (auto it = mTracksBySsrc.find(ssrc); it != mTracksBySsrc.end() && !it->second.expired())
+		return;
+
+	// Bound the bindings so a peer rotating SSRCs can't grow the table indefinitely
+	if (mLearnedSsrcs.size() >= MaxLearnedSsrcs) {
+		mTracksBySsrc.erase(mLearnedSsrcs.front());
+		mLearnedSsrcs.pop_front();
+	}
+
+	PLOG_DEBUG << "Learned SSRC " << ssrc << " for track \"" << track->mid() << "\"";
+	mTracksBySsrc.insert_or_assign(ssrc, track);
+	mLearnedSsrcs.push_back(ssrc);
+	updateSsrcTable();
+}
+#endif
+
 } // namespace rtc::impl
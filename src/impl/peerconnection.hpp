@@ -16,10 +16,12 @@
 #include "init.hpp"
 #include "processor.hpp"
 #include "sctptransport.hpp"
+#include "ssrctable.hpp"
 #include "track.hpp"
 
 #include "rtc/peerconnection.hpp"
 
+#include <deque>
 #include <mutex>
 #include <shared_mutex>
 #include <unordered_map>
@@ -46,6 +48,8 @@ struct PeerConnection : std::enable_shared_from_this<PeerConnection> {
 	shared_ptr<IceTransport> initIceTransport();
 	shared_ptr<DtlsTransport> initDtlsTransport();
 	shared_ptr<SctpTransport> initSctpTransport();
+	void deferSctpTransport();
+	void startSctpTransport(message_ptr message = nullptr);
 	shared_ptr<IceTransport> getIceTransport() const;
 	shared_ptr<DtlsTransport> getDtlsTransport() const;
 	shared_ptr<SctpTransport> getSctpTransport() const;
@@ -55,12 +59,13 @@ struct PeerConnection : std::enable_shared_from_this<PeerConnection> {
 	void rollbackLocalDescription();
 	bool checkFingerprint(const std::string &fingerprint);
 	void forwardMessage(message_ptr message);
-	void forwardMedia(message_ptr message);
+	void forwardMedia(message_vector messages);
 	void forwardBufferedAmount(uint16_t stream, size_t amount);
 
 	shared_ptr<DataChannel> emplaceDataChannel(string label, DataChannelInit init);
 	std::pair<shared_ptr<DataChannel>, bool> findDataChannel(uint16_t stream);
 	bool removeDataChannel(uint16_t stream);
+	bool hasDataChannels();
 	uint16_t maxDataChannelStream() const;
 	void assignDataChannels();
 	void iterateDataChannels(std::function<void(shared_ptr<DataChannel> channel)> func);
@@ -72,6 +77,7 @@ struct PeerConnection : std::enable_shared_from_this<PeerConnection> {
 	void iterateTracks(std::function<void(shared_ptr<Track> track)> func);
 	void openTracks();
 	void closeTracks();
+	void releaseTracks(); // drops the references to closed tracks asynchronously
 
 	void validateRemoteDescription(const Description &description);
 	void processLocalDescription(Description description);
@@ -130,7 +136,12 @@ struct PeerConnection : std::enable_shared_from_this<PeerConnection> {
 
 private:
 	void dispatchMedia(message_ptr message);
+#if RTC_ENABLE_MEDIA
+	bool dispatchRtcp(const SsrcTable &table, const message_ptr &message); // false if no SSRC
+	void bindSsrc(uint32_t ssrc, shared_ptr<Track> track);
+#endif
 	void updateTrackSsrcCache(const Description &description);
+	void updateSsrcTable(); // requires mTracksMutex to be locked exclusively
 
 	const init_token mInitToken = Init::Instance().token();
 	future_certificate_ptr mCertificate;
@@ -158,8 +169,10 @@ private:
 
 	std::unordered_map<string, weak_ptr<Track>> mTracks;         // by mid
 	std::unordered_map<uint32_t, weak_ptr<Track>> mTracksBySsrc; // by SSRC
+	std::deque<uint32_t> mLearnedSsrcs; // unsignaled SSRCs in mTracksBySsrc, oldest first
 	std::vector<weak_ptr<Track>> mTrackLines;                    // by SDP order
 	std::shared_mutex mTracksMutex;
+	shared_ptr<const SsrcTable> mSsrcTable; // for lock-free demultiplexing, atomically replaced
 
 	Queue<shared_ptr<DataChannel>> mPendingDataChannels;
 	Queue<shared_ptr<Track>> mPendingTracks;
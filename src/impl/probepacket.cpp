@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "probepacket.hpp"
+
+#include <cstring>
+
+namespace rtc::impl {
+
+namespace {
+
+const byte ProbeMagic[4] = {byte('p'), byte('r'), byte('b'), byte('e')};
+const size_t ProbeInfoSize = sizeof(ProbeMagic) + 8;
+
+void WriteUint32(byte *p, uint32_t value) {
+	for (int i = 0; i < 4; ++i)
+		p[i] = byte((value >> (24 - 8 * i)) & 0xFF);
+}
+
+uint32_t ReadUint32(const byte *p) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i)
+		value = (value << 8) | std::to_integer<uint32_t>(p[i]);
+
+	return value;
+}
+
+} // namespace
+
+message_ptr MakeProbePacket(SSRC ssrc, uint8_t payloadType, uint16_t sequenceNumber,
+                            uint32_t timestamp, const ProbeInfo &info) {
+	auto message = make_message(sizeof(RtpHeader) + ProbePaddingSize);
+	std::memset(message->data(), 0, message->size());
+
+	auto rtp = reinterpret_cast<RtpHeader *>(message->data());
+	rtp->preparePacket();
+	rtp->setSsrc(ssrc);
+	rtp->setPayloadType(payloadType);
+	rtp->setSeqNumber(sequenceNumber);
+	rtp->setTimestamp(timestamp);
+	message->front() |= byte(0x20); // padding bit
+
+	byte *padding = message->data() + sizeof(RtpHeader);
+	std::memcpy(padding, ProbeMagic, sizeof(ProbeMagic));
+	WriteUint32(padding + sizeof(ProbeMagic), info.cluster);
+	WriteUint32(padding + sizeof(ProbeMagic) + 4, info.bitrate);
+	message->back() = byte(ProbePaddingSize);
+	return message;
+}
+
+optional<ProbeInfo> ReadProbeInfo(const byte *packet, size_t size) {
+	auto rtp = reinterpret_cast<const RtpHeader *>(packet);
+	if (size < sizeof(RtpHeader) || !rtp->padding() ||
+	    size < rtp->getSize() + (rtp->extension() ? sizeof(RtpExtensionHeader) : 0))
+		return nullopt;
+
+	const size_t headerSize = rtp->getSize() + rtp->getExtensionHeaderSize();
+	if (headerSize + ProbeInfoSize + 1 > size ||
+	    headerSize + std::to_integer<size_t>(packet[size - 1]) != size)
+		return nullopt;
+
+	const byte *padding = packet + headerSize;
+	if (std::memcmp(padding, ProbeMagic, sizeof(ProbeMagic)) != 0)
+		return nullopt;
+
+	return ProbeInfo{ReadUint32(padding + sizeof(ProbeMagic)),
+	                 ReadUint32(padding + sizeof(ProbeMagic) + 4)};
+}
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
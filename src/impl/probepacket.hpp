@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_IMPL_PROBE_PACKET_H
+#define RTC_IMPL_PROBE_PACKET_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+#include "message.hpp"
+#include "rtp.hpp"
+
+namespace rtc::impl {
+
+// Bandwidth probes are padding-only RTP packets. The padding describes the probe cluster, so the
+// pacer and the congestion controller recognize probes and their cluster from the packet alone.
+struct ProbeInfo {
+	uint32_t cluster;
+	unsigned int bitrate; // target bitrate of the cluster
+};
+
+const size_t ProbePaddingSize = 255; // maximum padding size
+
+message_ptr MakeProbePacket(SSRC ssrc, uint8_t payloadType, uint16_t sequenceNumber,
+                            uint32_t timestamp, const ProbeInfo &info);
+
+// Return the probe description if the RTP packet is a probe
+optional<ProbeInfo> ReadProbeInfo(const byte *packet, size_t size);
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif
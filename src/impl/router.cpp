@@ -0,0 +1,796 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "router.hpp"
+#include "internals.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+
+namespace rtc::impl {
+
+namespace {
+
+// Maximum time to wait for a keyframe before switching at the next frame anyway
+const auto MaxSwitchDelay = std::chrono::seconds(2);
+
+string ToLower(string str) {
+	std::transform(str.begin(), str.end(), str.begin(),
+	               [](char c) { return char(std::tolower(c)); });
+	return str;
+}
+
+// Parse fmtp lines like "profile-level-id=42e01f;packetization-mode=1"
+std::unordered_map<string, string> ParseParameters(const std::vector<string> &fmtps) {
+	std::unordered_map<string, string> result;
+	for (const auto &fmtp : fmtps) {
+		std::istringstream ss(fmtp);
+		string param;
+		while (std::getline(ss, param, ';')) {
+			param.erase(0, param.find_first_not_of(' '));
+			if (auto pos = param.find('='); pos != string::npos && pos > 0)
+				result.emplace(ToLower(param.substr(0, pos)), param.substr(pos + 1));
+		}
+	}
+	return result;
+}
+
+string GetParameter(const std::unordered_map<string, string> &parameters, const string &key,
+                    const string &defaultValue) {
+	auto it = parameters.find(key);
+	return it != parameters.end() ? ToLower(it->second) : defaultValue;
+}
+
+std::unordered_set<SSRC> RtxSsrcs(const Description::Media &desc) {
+	// a=ssrc-group:FID <media SSRC> <RTX SSRC>
+	std::unordered_set<SSRC> result;
+	for (const auto &attr : desc.attributes()) {
+		if (attr.compare(0, 15, "ssrc-group:FID ") != 0)
+			continue;
+
+		std::istringstream ss(attr.substr(15));
+		SSRC ssrc = 0, rtxSsrc = 0;
+		if (ss >> ssrc >> rtxSsrc)
+			result.insert(rtxSsrc);
+	}
+	return result;
+}
+
+optional<SSRC> MediaSsrc(const Description::Media &desc) {
+	auto rtxSsrcs = RtxSsrcs(desc);
+	for (SSRC ssrc : desc.getSSRCs())
+		if (rtxSsrcs.find(ssrc) == rtxSsrcs.end())
+			return ssrc;
+
+	return nullopt;
+}
+
+bool IsH264Keyframe(uint8_t type) { return type == 5 || type == 7; } // IDR or SPS
+
+bool IsH265Keyframe(uint8_t type) {
+	return (type >= 16 && type <= 21) || type == 32 || type == 33; // IRAP, VPS or SPS
+}
+
+// Returns true if the RTP payload starts a keyframe
+bool IsKeyframeStart(const string &codec, const byte *payload, size_t size) {
+	if (size == 0)
+		return false;
+
+	auto at = [payload](size_t i) { return std::to_integer<uint8_t>(payload[i]); };
+	if (codec == "h264") {
+		const uint8_t type = at(0) & 0x1F;
+		if (type == 24) { // STAP-A
+			for (size_t i = 1; i + 2 < size; i += 2 + ((size_t(at(i)) << 8) | at(i + 1)))
+				if (IsH264Keyframe(at(i + 2) & 0x1F))
+					return true;
+
+			return false;
+		}
+		if (type == 28) // FU-A
+			return size >= 2 && (at(1) & 0x80) && IsH264Keyframe(at(1) & 0x1F);
+
+		return IsH264Keyframe(type);
+	}
+
+	if (codec == "h265") {
+		if (size < 2)
+			return false;
+
+		const uint8_t type = (at(0) >> 1) & 0x3F;
+		if (type == 48) { // AP
+			for (size_t i = 2; i + 2 < size; i += 2 + ((size_t(at(i)) << 8) | at(i + 1)))
+				if (IsH265Keyframe((at(i + 2) >> 1) & 0x3F))
+					return true;
+
+			return false;
+		}
+		if (type == 49) // FU
+			return size >= 3 && (at(2) & 0x80) && IsH265Keyframe(at(2) & 0x3F);
+
+		return IsH265Keyframe(type);
+	}
+
+	if (codec == "vp8") {
+		// Start of partition 0, then the P bit of the payload header is 0 for keyframes
+		if (!(at(0) & 0x10) || (at(0) & 0x0F) != 0)
+			return false;
+
+		size_t offset = 1;
+		if (at(0) & 0x80) { // X
+			if (size < 2)
+				return false;
+
+			const uint8_t ext = at(1);
+			offset = 2;
+			if (ext & 0x80) // I, PictureID is on 7 or 15 bits
+				offset += offset < size && (at(offset) & 0x80) ? 2 : 1;
+			if (ext & 0x40) // L
+				++offset;
+			if (ext & 0x30) // T or K
+				++offset;
+		}
+		return offset < size && !(at(offset) & 0x01);
+	}
+
+	if (codec == "vp9")
+		return (at(0) & 0x08) && !(at(0) & 0x40); // B set and P unset
+
+	if (codec == "av1")
+		return !(at(0) & 0x80) && (at(0) & 0x08); // Z unset and N set
+
+	return false;
+}
+
+// Returns true if the compound RTCP packet contains a PLI or a FIR
+bool HasKeyframeRequest(const message_ptr &message) {
+	size_t offset = 0;
+	while (offset + sizeof(RtcpHeader) <= message->size()) {
+		auto header = reinterpret_cast<const RtcpHeader *>(message->data() + offset);
+		// PT = 206 is a payload specific fb message, FMT = 1 means PLI and FMT = 4 means FIR
+		if (header->payloadType() == 206 &&
+		    (header->reportCount() == 1 || header->reportCount() == 4))
+			return true;
+
+		offset += header->lengthInBytes();
+	}
+	return false;
+}
+
+// Copy the packet without header extensions and with the given header fields
+binary RewritePacket(const Message &message, SSRC ssrc, uint16_t sequenceNumber,
+                     uint32_t timestamp, uint8_t payloadType) {
+	auto rtp = reinterpret_cast<const RtpHeader *>(message.data());
+	const size_t fixedSize = rtp->getSize();
+	const size_t headerSize = fixedSize + rtp->getExtensionHeaderSize();
+
+	binary result;
+	result.reserve(message.size() - headerSize + fixedSize);
+	result.insert(result.end(), message.begin(), message.begin() + fixedSize);
+	result.insert(result.end(), message.begin() + headerSize, message.end());
+
+	auto out = reinterpret_cast<RtpHeader *>(result.data());
+	out->setExtension(false);
+	out->setSsrc(ssrc);
+	out->setSeqNumber(sequenceNumber);
+	out->setTimestamp(timestamp);
+	out->setPayloadType(payloadType);
+	return result;
+}
+
+} // namespace
+
+class Router::PublisherHandler final : public MediaHandler {
+public:
+	PublisherHandler(weak_ptr<Router> router, weak_ptr<Publisher> publisher)
+	    : mRouter(std::move(router)), mPublisher(std::move(publisher)) {}
+
+	void media(const Description::Media &desc) override {
+		auto router = mRouter.lock();
+		auto pub = mPublisher.lock();
+		if (router && pub)
+			router->updatePublisher(*pub, desc);
+	}
+
+	void incoming(message_vector &messages, const message_callback &) override {
+		auto router = mRouter.lock();
+		auto pub = mPublisher.lock();
+		if (router && pub)
+			router->forward(*pub, messages);
+	}
+
+	bool requestKeyframe(const message_callback &send) override {
+		std::vector<SSRC> targets;
+		{
+			std::lock_guard lock(mMutex);
+			targets.swap(mKeyframeTargets);
+		}
+
+		if (targets.empty())
+			return MediaHandler::requestKeyframe(send);
+
+		for (SSRC ssrc : targets) {
+			auto message = make_message(RtcpPli::Size(), Message::Control);
+			auto *pli = reinterpret_cast<RtcpPli *>(message->data());
+			pli->preparePacket(ssrc);
+			send(message);
+		}
+		return true;
+	}
+
+	// Set the streams targeted by the next keyframe request
+	void setKeyframeTargets(std::vector<SSRC> targets) {
+		std::lock_guard lock(mMutex);
+		mKeyframeTargets = std::move(targets);
+	}
+
+private:
+	const weak_ptr<Router> mRouter;
+	const weak_ptr<Publisher> mPublisher;
+
+	std::mutex mMutex;
+	std::vector<SSRC> mKeyframeTargets;
+};
+
+class Router::SubscriberHandler final : public MediaHandler {
+public:
+	SubscriberHandler(weak_ptr<Router> router, weak_ptr<Subscriber> subscriber)
+	    : mRouter(std::move(router)), mSubscriber(std::move(subscriber)) {}
+
+	void media(const Description::Media &desc) override {
+		auto router = mRouter.lock();
+		auto sub = mSubscriber.lock();
+		if (router && sub)
+			router->updateSubscriber(*sub, desc);
+	}
+
+	void incoming(message_vector &messages, const message_callback &) override {
+		for (const auto &message : messages) {
+			if (message->type == Message::Control && HasKeyframeRequest(message)) {
+				auto router = mRouter.lock();
+				auto sub = mSubscriber.lock();
+				if (router && sub)
+					router->keyframeRequested(*sub);
+
+				break;
+			}
+		}
+	}
+
+private:
+	const weak_ptr<Router> mRouter;
+	const weak_ptr<Subscriber> mSubscriber;
+};
+
+Router::Router(std::chrono::milliseconds keyframeRequestInterval)
+    : mKeyframeRequestInterval(keyframeRequestInterval) {
+	PLOG_VERBOSE << "Creating Router";
+}
+
+Router::~Router() { PLOG_VERBOSE << "Destroying Router"; }
+
+void Router::addPublisher(shared_ptr<rtc::Track> track) {
+	if (!track)
+		throw std::invalid_argument("Publisher track is null");
+
+	auto pub = std::make_shared<Publisher>();
+	pub->track = track;
+	pub->handler = std::make_shared<PublisherHandler>(weak_from_this(), pub);
+	{
+		std::lock_guard lock(mMutex);
+		if (!mPublishers.emplace(track.get(), pub).second)
+			return;
+	}
+
+	PLOG_DEBUG << "Adding publisher track, mid=" << track->mid();
+	Install(track, pub->handler);
+}
+
+void Router::removePublisher(const shared_ptr<rtc::Track> &track) {
+	shared_ptr<Publisher> pub;
+	{
+		std::lock_guard lock(mMutex);
+		auto it = mPublishers.find(track.get());
+		if (it == mPublishers.end())
+			return;
+
+		pub = std::move(it->second);
+		mPublishers.erase(it);
+
+		// Subscribers keep their rewriting state so they continue seamlessly on a new publisher
+		for (auto &[_, sub] : mSubscribers) {
+			std::lock_guard subLock(sub->mutex);
+			if (sub->source == track.get()) {
+				sub->source = nullptr;
+				sub->input.reset();
+			}
+			if (sub->pending == track.get())
+				sub->pending = nullptr;
+		}
+	}
+
+	PLOG_DEBUG << "Removing publisher track, mid=" << track->mid();
+	Uninstall(track, pub->handler);
+}
+
+void Router::subscribe(shared_ptr<rtc::Track> subscriber, shared_ptr<rtc::Track> publisher,
+                       optional<SSRC> layer) {
+	if (!subscriber || !publisher)
+		throw std::invalid_argument("Track is null");
+
+	if (!MediaSsrc(subscriber->description()))
+		throw std::invalid_argument("Subscriber track has no SSRC");
+
+	shared_ptr<SubscriberHandler> handler;
+	{
+		std::lock_guard lock(mMutex);
+		auto it = mPublishers.find(publisher.get());
+		if (it == mPublishers.end())
+			throw std::invalid_argument("Track is not a publisher of the router");
+
+		auto &pub = it->second;
+		auto &sub = mSubscribers[subscriber.get()];
+		if (!sub) {
+			sub = std::make_shared<Subscriber>();
+			sub->track = subscriber;
+			sub->handler = handler = std::make_shared<SubscriberHandler>(weak_from_this(), sub);
+		}
+
+		std::lock_guard pubLock(pub->mutex);
+		std::lock_guard subLock(sub->mutex);
+		if (sub->source == publisher.get() && sub->layer == layer && !sub->pending)
+			return; // already subscribed
+
+		sub->pending = publisher.get();
+		sub->pendingLayer = layer;
+		sub->pendingSince = clock::now();
+		if (std::find(pub->pending.begin(), pub->pending.end(), sub) == pub->pending.end())
+			pub->pending.push_back(sub);
+	}
+
+	if (handler) {
+		PLOG_DEBUG << "Adding subscriber track, mid=" << subscriber->mid();
+		Install(subscriber, std::move(handler));
+	}
+
+	// The subscriber switches on the next keyframe
+	requestKeyframe(publisher.get(), layer);
+}
+
+void Router::unsubscribe(const shared_ptr<rtc::Track> &subscriber) {
+	shared_ptr<Subscriber> sub;
+	{
+		std::lock_guard lock(mMutex);
+		auto it = mSubscribers.find(subscriber.get());
+		if (it == mSubscribers.end())
+			return;
+
+		sub = std::move(it->second);
+		mSubscribers.erase(it);
+
+		{
+			std::lock_guard subLock(sub->mutex);
+			sub->source = nullptr;
+			sub->pending = nullptr;
+		}
+
+		// Remove the entries of the subscriber, including stale ones, from all publishers
+		for (auto &[_, pub] : mPublishers) {
+			std::lock_guard pubLock(pub->mutex);
+			auto &pending = pub->pending;
+			pending.erase(std::remove(pending.begin(), pending.end(), sub), pending.end());
+			for (auto &[ssrc, route] : pub->routes)
+				route.erase(std::remove(route.begin(), route.end(), sub), route.end());
+		}
+	}
+
+	PLOG_DEBUG << "Removing subscriber track, mid=" << subscriber->mid();
+	Uninstall(subscriber, sub->handler);
+}
+
+void Router::requestKeyframe(rtc::Track *publisher, optional<SSRC> ssrc) {
+	shared_ptr<Publisher> pub;
+	{
+		std::lock_guard lock(mMutex);
+		auto it = mPublishers.find(publisher);
+		if (it == mPublishers.end())
+			return;
+
+		pub = it->second;
+	}
+
+	std::vector<SSRC> targets;
+	{
+		std::lock_guard lock(pub->mutex);
+		addKeyframeTarget(*pub, ssrc);
+		if (!takeKeyframeRequest(*pub, clock::now(), targets))
+			return; // it will be sent when forwarding once the interval has elapsed
+	}
+
+	sendKeyframeRequest(pub->track, pub->handler, std::move(targets));
+}
+
+void Router::clear() {
+	decltype(mPublishers) publishers;
+	decltype(mSubscribers) subscribers;
+	{
+		std::lock_guard lock(mMutex);
+		publishers.swap(mPublishers);
+		subscribers.swap(mSubscribers);
+	}
+
+	for (auto &[_, pub] : publishers)
+		Uninstall(pub->track, pub->handler);
+
+	for (auto &[_, sub] : subscribers)
+		Uninstall(sub->track, sub->handler);
+}
+
+void Router::forward(Publisher &pub, message_vector &messages) {
+	struct Output {
+		SSRC ssrc;
+		uint16_t sequenceNumber;
+		uint32_t timestamp;
+		uint8_t payloadType;
+		std::vector<shared_ptr<rtc::Track>> tracks;
+	};
+
+	rtc::Track *const publisher = pub.track.get();
+	std::vector<std::pair<std::vector<shared_ptr<rtc::Track>>, binary>> packets;
+	bool keyframeRequest = false;
+	std::vector<SSRC> keyframeTargets;
+
+	message_vector result;
+	{
+		// Only the publisher is locked, other publishers forward concurrently
+		std::lock_guard lock(pub.mutex);
+		const auto now = clock::now();
+		for (auto &message : messages) {
+			if (message->type == Message::Control) {
+				result.push_back(std::move(message));
+				continue;
+			}
+
+			// RTP packets are consumed
+			auto rtp = reinterpret_cast<const RtpHeader *>(message->data());
+			if (message->size() < sizeof(RtpHeader) ||
+			    rtp->getSize() + (rtp->extension() ? sizeof(RtpExtensionHeader) : 0) >
+			        message->size())
+				continue;
+
+			auto pt = pub.payloads.find(rtp->payloadType());
+			if (pt == pub.payloads.end() || pt->second.rtx)
+				continue; // retransmissions are handled separately on each subscriber
+
+			const PayloadInfo &info = pt->second;
+			const SSRC ssrc = rtp->ssrc();
+			const uint16_t sequenceNumber = rtp->seqNumber();
+			const uint32_t timestamp = rtp->timestamp();
+			auto &stream = pub.streams[ssrc];
+			auto &route = pub.routes[ssrc];
+
+			// Visit the subscribers forwarding the stream, removing those which switched away
+			auto forEachRouted = [&](auto &&func) {
+				for (auto it = route.begin(); it != route.end();) {
+					auto &sub = **it;
+					std::lock_guard subLock(sub.mutex);
+					if (sub.source != publisher || sub.input != ssrc) {
+						it = route.erase(it);
+						continue;
+					}
+					++it;
+					if (int16_t(sequenceNumber - sub.switchSequenceNumber) >= 0)
+						func(sub); // not sent before the switch
+				}
+			};
+
+			// Packets without payload, like padding for probing, are not forwarded, so subscribers
+			// skip their sequence numbers to keep the output continuous
+			const size_t headerSize = rtp->getSize() + rtp->getExtensionHeaderSize();
+			const size_t paddingSize =
+			    rtp->padding() ? std::to_integer<uint8_t>(message->back()) : 0;
+			if (headerSize + paddingSize >= message->size()) {
+				if (!stream.started || int16_t(sequenceNumber - stream.lastSequenceNumber) <= 0)
+					continue;
+
+				stream.lastSequenceNumber = sequenceNumber;
+				forEachRouted([](Subscriber &sub) { --sub.sequenceNumberDelta; });
+				continue;
+			}
+
+			// A frame starts when the timestamp changes, late packets are ignored
+			bool frameStart = false;
+			if (!stream.started || int16_t(sequenceNumber - stream.lastSequenceNumber) > 0) {
+				frameStart = !stream.started || timestamp != stream.lastTimestamp;
+				stream.started = true;
+				stream.lastSequenceNumber = sequenceNumber;
+				stream.lastTimestamp = timestamp;
+			}
+
+			const bool keyframe =
+			    frameStart &&
+			    (pub.audio || IsKeyframeStart(info.codec, message->data() + headerSize,
+			                                  message->size() - headerSize - paddingSize));
+
+			// Subscribers waiting for this stream switch to it on a keyframe
+			for (auto it = pub.pending.begin(); it != pub.pending.end();) {
+				auto &sub = **it;
+				std::lock_guard subLock(sub.mutex);
+				if (sub.pending != publisher) {
+					it = pub.pending.erase(it); // switched elsewhere or unsubscribed
+					continue;
+				}
+
+				if (sub.pendingLayer && *sub.pendingLayer != ssrc) {
+					++it;
+					continue;
+				}
+
+				if (!keyframe && !(frameStart && now - sub.pendingSince >= MaxSwitchDelay)) {
+					addKeyframeTarget(pub, ssrc); // request again after the interval
+					++it;
+					continue;
+				}
+
+				switchSource(sub, ssrc, sequenceNumber, timestamp, info.clockRate, now);
+				if (std::find(route.begin(), route.end(), *it) == route.end())
+					route.push_back(*it);
+
+				it = pub.pending.erase(it);
+			}
+
+			std::vector<Output> outputs;
+			forEachRouted([&](Subscriber &sub) {
+				// Map the payload type to the first compatible one of the subscriber
+				auto jt = sub.payloadTypes.find(pt->first);
+				if (jt == sub.payloadTypes.end()) {
+					optional<uint8_t> mapped;
+					for (const auto &[subType, subInfo] : sub.payloads) {
+						if (!subInfo.rtx && IsCompatible(info, subInfo)) {
+							mapped = subType;
+							break;
+						}
+					}
+					jt = sub.payloadTypes.emplace(pt->first, mapped).first;
+				}
+				if (!jt->second)
+					return; // format not negotiated for the subscriber
+
+				const uint16_t outSequenceNumber = sequenceNumber + sub.sequenceNumberDelta;
+				const uint32_t outTimestamp = timestamp + sub.timestampDelta;
+				if (int16_t(outSequenceNumber - sub.lastSequenceNumber) > 0) {
+					sub.lastSequenceNumber = outSequenceNumber;
+					sub.lastTimestamp = outTimestamp;
+					sub.lastTime = now;
+				}
+
+				// Subscribers with the same output share the rewritten packet
+				auto kt = std::find_if(outputs.begin(), outputs.end(), [&](const Output &out) {
+					return out.ssrc == sub.ssrc && out.sequenceNumber == outSequenceNumber &&
+					       out.timestamp == outTimestamp && out.payloadType == *jt->second;
+				});
+				if (kt == outputs.end())
+					kt = outputs.insert(outputs.end(), Output{sub.ssrc, outSequenceNumber,
+					                                          outTimestamp, *jt->second, {}});
+
+				kt->tracks.push_back(sub.track);
+			});
+
+			for (auto &out : outputs)
+				packets.emplace_back(std::move(out.tracks),
+				                     RewritePacket(*message, out.ssrc, out.sequenceNumber,
+				                                   out.timestamp, out.payloadType));
+		}
+
+		keyframeRequest = takeKeyframeRequest(pub, now, keyframeTargets);
+	}
+
+	messages.swap(result);
+
+	for (auto &[tracks, data] : packets)
+		rtc::Track::Fanout(tracks, std::move(data));
+
+	if (keyframeRequest)
+		sendKeyframeRequest(pub.track, pub.handler, std::move(keyframeTargets));
+}
+
+void Router::keyframeRequested(Subscriber &sub) {
+	rtc::Track *publisher = nullptr;
+	optional<SSRC> ssrc;
+	{
+		std::lock_guard lock(sub.mutex);
+		if (sub.pending) {
+			publisher = sub.pending;
+			ssrc = sub.pendingLayer;
+		} else {
+			publisher = sub.source;
+			ssrc = sub.input;
+		}
+	}
+
+	if (publisher)
+		requestKeyframe(publisher, ssrc);
+}
+
+void Router::updatePublisher(Publisher &pub, const Description::Media &desc) {
+	std::unordered_map<uint8_t, PayloadInfo> payloads;
+	for (int pt : desc.payloadTypes()) {
+		if (auto map = desc.rtpMap(pt)) {
+			PayloadInfo info;
+			info.codec = ToLower(map->format);
+			info.clockRate = uint32_t(map->clockRate);
+			info.rtx = info.codec == "rtx";
+			info.parameters = ParseParameters(map->fmtps);
+			payloads.emplace(uint8_t(pt), std::move(info));
+		}
+	}
+
+	std::lock_guard lock(pub.mutex);
+	pub.audio = desc.type() == "audio";
+	pub.payloads = std::move(payloads);
+
+	for (auto &[_, route] : pub.routes) {
+		for (auto &sub : route) {
+			std::lock_guard subLock(sub->mutex);
+			if (sub->source == pub.track.get())
+				sub->payloadTypes.clear();
+		}
+	}
+}
+
+void Router::updateSubscriber(Subscriber &sub, const Description::Media &desc) {
+	auto ssrc = MediaSsrc(desc);
+	std::vector<std::pair<uint8_t, PayloadInfo>> payloads;
+	for (int pt : desc.payloadTypes()) {
+		if (auto map = desc.rtpMap(pt)) {
+			PayloadInfo info;
+			info.codec = ToLower(map->format);
+			info.clockRate = uint32_t(map->clockRate);
+			info.rtx = info.codec == "rtx";
+			info.parameters = ParseParameters(map->fmtps);
+			payloads.emplace_back(uint8_t(pt), std::move(info));
+		}
+	}
+
+	std::lock_guard lock(sub.mutex);
+	if (ssrc)
+		sub.ssrc = *ssrc;
+
+	sub.payloads = std::move(payloads);
+	sub.payloadTypes.clear();
+}
+
+void Router::switchSource(Subscriber &sub, SSRC input, uint16_t sequenceNumber,
+                          uint32_t timestamp, uint32_t clockRate, clock::time_point now) {
+	if (sub.started) {
+		// Continue the output sequence and advance the timestamp by the elapsed time
+		const double elapsed = std::chrono::duration<double>(now - sub.lastTime).count();
+		const auto increment = uint32_t(std::clamp(elapsed * clockRate, 1., double(1 << 30)));
+		sub.sequenceNumberDelta = uint16_t(sub.lastSequenceNumber + 1 - sequenceNumber);
+		sub.timestampDelta = sub.lastTimestamp + increment - timestamp;
+	} else {
+		sub.started = true;
+		sub.sequenceNumberDelta = 0;
+		sub.timestampDelta = 0;
+		sub.lastSequenceNumber = uint16_t(sequenceNumber - 1);
+		sub.lastTimestamp = timestamp;
+		sub.lastTime = now;
+	}
+
+	PLOG_DEBUG << "Switching subscriber to stream, ssrc=" << input;
+	if (sub.source != sub.pending)
+		sub.payloadTypes.clear();
+
+	sub.source = sub.pending;
+	sub.layer = sub.pendingLayer;
+	sub.input = input;
+	sub.switchSequenceNumber = sequenceNumber;
+	sub.pending = nullptr;
+	sub.pendingLayer.reset();
+}
+
+// Returns true if a stream with the source format can be forwarded as the target one. The
+// level may differ, but the profile and the packetization must match.
+bool Router::IsCompatible(const PayloadInfo &source, const PayloadInfo &target) {
+	if (source.codec != target.codec || source.clockRate != target.clockRate)
+		return false;
+
+	auto same = [&](const string &key, const string &defaultValue) {
+		return GetParameter(source.parameters, key, defaultValue) ==
+		       GetParameter(target.parameters, key, defaultValue);
+	};
+
+	if (source.codec == "h264") {
+		// profile-level-id is profile_idc, profile-iop and level_idc in hexadecimal
+		auto profile = [](const std::unordered_map<string, string> &parameters) {
+			return GetParameter(parameters, "profile-level-id", "42000a").substr(0, 4);
+		};
+		return same("packetization-mode", "0") &&
+		       profile(source.parameters) == profile(target.parameters);
+	}
+
+	if (source.codec == "h265")
+		return same("profile-id", "1");
+
+	if (source.codec == "vp9")
+		return same("profile-id", "0");
+
+	if (source.codec == "av1")
+		return same("profile", "0");
+
+	return true;
+}
+
+void Router::addKeyframeTarget(Publisher &pub, optional<SSRC> ssrc) {
+	pub.keyframePending = true;
+	if (ssrc) {
+		pub.keyframeTargets.insert(*ssrc);
+	} else {
+		for (const auto &[streamSsrc, _] : pub.streams)
+			pub.keyframeTargets.insert(streamSsrc);
+	}
+}
+
+bool Router::takeKeyframeRequest(Publisher &pub, clock::time_point now,
+                                 std::vector<SSRC> &targets) {
+	if (!pub.keyframePending)
+		return false;
+
+	if (pub.lastKeyframeRequest && now - *pub.lastKeyframeRequest < mKeyframeRequestInterval)
+		return false;
+
+	pub.lastKeyframeRequest = now;
+	pub.keyframePending = false;
+	targets.assign(pub.keyframeTargets.begin(), pub.keyframeTargets.end());
+	pub.keyframeTargets.clear();
+	return true;
+}
+
+void Router::sendKeyframeRequest(const shared_ptr<rtc::Track> &track,
+                                 const shared_ptr<PublisherHandler> &handler,
+                                 std::vector<SSRC> targets) {
+	// Without known streams, the request goes to the rest of the chain
+	handler->setKeyframeTargets(std::move(targets));
+	try {
+		track->requestKeyframe();
+	} catch (const std::exception &e) {
+		PLOG_WARNING << "Keyframe request failed: " << e.what();
+	}
+}
+
+void Router::Install(const shared_ptr<rtc::Track> &track, shared_ptr<MediaHandler> handler) {
+	// The handler is first in the chain so it processes incoming messages last
+	handler->setNext(track->getMediaHandler());
+	track->setMediaHandler(std::move(handler));
+}
+
+void Router::Uninstall(const shared_ptr<rtc::Track> &track,
+                       const shared_ptr<MediaHandler> &handler) {
+	if (!handler)
+		return;
+
+	auto current = track->getMediaHandler();
+	if (current == handler) {
+		track->setMediaHandler(handler->next());
+		return;
+	}
+
+	for (auto h = current; h; h = h->next()) {
+		if (h->next() == handler) {
+			h->setNext(handler->next());
+			break;
+		}
+	}
+}
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_IMPL_ROUTER_H
+#define RTC_IMPL_ROUTER_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+
+#include "rtc/mediahandler.hpp"
+#include "rtc/router.hpp"
+#include "rtc/rtp.hpp"
+#include "rtc/track.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rtc::impl {
+
+struct Router final : public std::enable_shared_from_this<Router> {
+	using clock = std::chrono::steady_clock;
+
+	Router(std::chrono::milliseconds keyframeRequestInterval);
+	~Router();
+
+	void addPublisher(shared_ptr<rtc::Track> track);
+	void removePublisher(const shared_ptr<rtc::Track> &track);
+	void subscribe(shared_ptr<rtc::Track> subscriber, shared_ptr<rtc::Track> publisher,
+	               optional<SSRC> layer);
+	void unsubscribe(const shared_ptr<rtc::Track> &subscriber);
+	void requestKeyframe(rtc::Track *publisher, optional<SSRC> ssrc);
+	void clear();
+
+private:
+	class PublisherHandler;
+	class SubscriberHandler;
+
+	struct PayloadInfo {
+		string codec; // lowercase
+		uint32_t clockRate = 0;
+		bool rtx = false;
+		std::unordered_map<string, string> parameters; // from fmtp, keys are lowercase
+	};
+
+	struct Stream {
+		uint16_t lastSequenceNumber = 0;
+		uint32_t lastTimestamp = 0;
+		bool started = false;
+	};
+
+	struct Subscriber {
+		// Set on creation
+		shared_ptr<rtc::Track> track;
+		shared_ptr<SubscriberHandler> handler;
+
+		std::mutex mutex; // guards the fields below, locked after the publisher one
+		SSRC ssrc = 0;
+		std::vector<std::pair<uint8_t, PayloadInfo>> payloads; // in order of preference
+		std::unordered_map<uint8_t, optional<uint8_t>> payloadTypes; // by source type, cached
+
+		// Currently forwarded stream
+		rtc::Track *source = nullptr;
+		optional<SSRC> layer;
+		optional<SSRC> input;
+		uint16_t switchSequenceNumber = 0;
+
+		// Stream to switch to on the next keyframe
+		rtc::Track *pending = nullptr;
+		optional<SSRC> pendingLayer;
+		clock::time_point pendingSince;
+
+		// Rewriting state, kept across switches so the output stays continuous
+		bool started = false;
+		uint16_t lastSequenceNumber = 0;
+		uint32_t lastTimestamp = 0;
+		clock::time_point lastTime;
+		uint16_t sequenceNumberDelta = 0;
+		uint32_t timestampDelta = 0;
+	};
+
+	struct Publisher {
+		// Set on creation
+		shared_ptr<rtc::Track> track;
+		shared_ptr<PublisherHandler> handler;
+
+		std::mutex mutex; // guards the fields below
+		bool audio = false;
+		std::unordered_map<uint8_t, PayloadInfo> payloads;
+		std::unordered_map<SSRC, Stream> streams;
+
+		// Subscribers forwarding each stream, by input SSRC, and subscribers waiting to switch to
+		// this publisher, so forwarding a packet only visits the subscribers of its stream.
+		// Entries of subscribers which switched away are removed lazily when forwarding.
+		std::unordered_map<SSRC, std::vector<shared_ptr<Subscriber>>> routes;
+		std::vector<shared_ptr<Subscriber>> pending;
+
+		// Keyframe request aggregation
+		optional<clock::time_point> lastKeyframeRequest;
+		bool keyframePending = false;
+		std::unordered_set<SSRC> keyframeTargets;
+	};
+
+	// Called by handlers
+	void forward(Publisher &pub, message_vector &messages);
+	void keyframeRequested(Subscriber &sub);
+	void updatePublisher(Publisher &pub, const Description::Media &desc);
+	void updateSubscriber(Subscriber &sub, const Description::Media &desc);
+
+	void switchSource(Subscriber &sub, SSRC input, uint16_t sequenceNumber, uint32_t timestamp,
+	                  uint32_t clockRate, clock::time_point now);
+	void addKeyframeTarget(Publisher &pub, optional<SSRC> ssrc);
+	bool takeKeyframeRequest(Publisher &pub, clock::time_point now,
+	                         std::vector<SSRC> &targets); // returns true if it should be sent
+	void sendKeyframeRequest(const shared_ptr<rtc::Track> &track,
+	                         const shared_ptr<PublisherHandler> &handler,
+	                         std::vector<SSRC> targets);
+
+	static bool IsCompatible(const PayloadInfo &source, const PayloadInfo &target);
+	static void Install(const shared_ptr<rtc::Track> &track, shared_ptr<MediaHandler> handler);
+	static void Uninstall(const shared_ptr<rtc::Track> &track,
+	                      const shared_ptr<MediaHandler> &handler);
+
+	const std::chrono::milliseconds mKeyframeRequestInterval;
+
+	std::mutex mMutex; // guards the maps, locked before publishers and subscribers
+	std::unordered_map<rtc::Track *, shared_ptr<Publisher>> mPublishers;
+	std::unordered_map<rtc::Track *, shared_ptr<Subscriber>> mSubscribers;
+};
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif // RTC_IMPL_ROUTER_H
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "rtpextension.hpp"
+
+#include "rtc/rtp.hpp"
+
+#include <chrono>
+
+namespace rtc::impl {
+
+optional<std::pair<size_t, size_t>> FindRtpExtension(const byte *packet, size_t size, int id) {
+	auto rtp = reinterpret_cast<const RtpHeader *>(packet);
+	if (id <= 0 || size < sizeof(RtpHeader) || !rtp->extension() ||
+	    size < rtp->getSize() + sizeof(RtpExtensionHeader))
+		return nullopt;
+
+	auto header = rtp->getExtensionHeader();
+	const size_t length = header->getSize();
+	if (size < rtp->getSize() + sizeof(RtpExtensionHeader) + length)
+		return nullopt;
+
+	const auto *body = reinterpret_cast<const uint8_t *>(header->getBody());
+	const size_t bodyOffset = rtp->getSize() + sizeof(RtpExtensionHeader);
+	const uint16_t profile = header->profileSpecificId();
+	if (profile == 0xBEDE) {
+		size_t i = 0;
+		while (i < length) {
+			if (body[i] == 0) { // padding
+				++i;
+				continue;
+			}
+			const int elementId = body[i] >> 4;
+			const size_t elementLength = (body[i] & 0x0F) + 1;
+			if (elementId == 15 || i + 1 + elementLength > length)
+				break; // reserved ID stops parsing
+
+			if (elementId == id)
+				return std::make_pair(bodyOffset + i + 1, elementLength);
+
+			i += 1 + elementLength;
+		}
+	} else if ((profile & 0xFFF0) == 0x1000) {
+		size_t i = 0;
+		while (i < length) {
+			if (body[i] == 0) { // padding
+				++i;
+				continue;
+			}
+			if (i + 2 > length)
+				break;
+
+			const int elementId = body[i];
+			const size_t elementLength = body[i + 1];
+			if (i + 2 + elementLength > length)
+				break;
+
+			if (elementId == id)
+				return std::make_pair(bodyOffset + i + 2, elementLength);
+
+			i += 2 + elementLength;
+		}
+	}
+
+	return nullopt;
+}
+
+int FindExtMapId(const Description::Media &media, const string &uri) {
+	for (int id : media.extIds())
+		if (media.extMap(id)->uri == uri)
+			return id;
+
+	return 0;
+}
+
+uint32_t AbsSendTime() {
+	using namespace std::chrono;
+	const uint64_t us = uint64_t(
+	    duration_cast<microseconds>(system_clock::now().time_since_epoch()).count());
+	return uint32_t((((us % 64000000) << 18) / 1000000) & 0xFFFFFF);
+}
+
+} // namespace rtc::impl
@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_IMPL_RTP_EXTENSION_H
+#define RTC_IMPL_RTP_EXTENSION_H
+
+#include "common.hpp"
+#include "description.hpp"
+
+#include <utility>
+
+namespace rtc::impl {
+
+const string TransportWideCcExtUri =
+    "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01";
+const string AbsSendTimeExtUri = "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time";
+
+// Find the value of a one-byte or two-byte header extension element (RFC 8285) in an RTP packet,
+// returns its offset in the packet and its length
+optional<std::pair<size_t, size_t>> FindRtpExtension(const byte *packet, size_t size, int id);
+
+// Return the ID of the header extension with the given URI, 0 if it is not negotiated
+int FindExtMapId(const Description::Media &media, const string &uri);
+
+// Return the current time as an abs-send-time value, 6.18 fixed point seconds wrapping around
+// every 64 seconds
+uint32_t AbsSendTime();
+
+} // namespace rtc::impl
+
+#endif
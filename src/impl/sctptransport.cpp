@@ -98,7 +98,8 @@ void SctpTransport::Init() {
 
 void SctpTransport::SetSettings(const SctpSettings &s) {
 	// The send and receive window size of usrsctp is 256KiB, which is too small for realistic RTTs,
-	// therefore we increase it to 1MiB by default for better performance.
+	// therefore we increase it to 1MiB by default for better performance. Associations start with
+	// smaller buffers and grow them on demand up to this size.
 	// See https://bugzilla.mozilla.org/show_bug.cgi?id=1051685
 	usrsctp_sysctl_set_sctp_recvspace(to_uint32(s.recvBufferSize.value_or(1024 * 1024)));
 	usrsctp_sysctl_set_sctp_sendspace(to_uint32(s.sendBufferSize.value_or(1024 * 1024)));
@@ -280,6 +281,8 @@ SctpTransport::SctpTransport(shared_ptr<Transport> lower, const Configuration &c
 		                         std::to_string(errno));
 #endif
 
+	// The buffer sizes set globally are only upper bounds: buffers start smaller so idle or slow
+	// associations don't hold large windows, and they grow on demand up to the limits.
 	int rcvBuf = 0;
 	socklen_t rcvBufLen = sizeof(rcvBuf);
 	if (usrsctp_getsockopt(mSock, SOL_SOCKET, SO_RCVBUF, &rcvBuf, &rcvBufLen))
@@ -293,8 +296,12 @@ SctpTransport::SctpTransport(shared_ptr<Transport> lower, const Configuration &c
 
 	// Ensure the buffer is also large enough to accomodate the largest messages
 	const int minBuf = int(std::min(mMaxMessageSize, size_t(std::numeric_limits<int>::max())));
-	rcvBuf = std::max(rcvBuf, minBuf);
-	sndBuf = std::max(sndBuf, minBuf);
+	mMaxRecvBufferSize = std::max(rcvBuf, minBuf);
+	mMaxSendBufferSize = std::max(sndBuf, minBuf);
+
+	const int initialBuf = std::max(int(INITIAL_SCTP_BUFFER_SIZE), minBuf);
+	rcvBuf = std::min(initialBuf, mMaxRecvBufferSize);
+	sndBuf = std::min(initialBuf, mMaxSendBufferSize);
 
 	if (usrsctp_setsockopt(mSock, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf)))
 		throw std::runtime_error("Could not set SCTP recv buffer size, errno=" +
@@ -304,6 +311,9 @@ SctpTransport::SctpTransport(shared_ptr<Transport> lower, const Configuration &c
 		throw std::runtime_error("Could not set SCTP send buffer size, errno=" +
 		                         std::to_string(errno));
 
+	mRecvBufferSize = rcvBuf;
+	mSendBufferSize = sndBuf;
+
 	usrsctp_register_address(this);
 	Instances->insert(this);
 }
@@ -433,6 +443,8 @@ void SctpTransport::close() {
 	}
 }
 
+void SctpTransport::inject(message_ptr message) { incoming(std::move(message)); }
+
 unsigned int SctpTransport::maxStream() const {
 	unsigned int streamsCount = mNegotiatedStreamsCount.value_or(MAX_SCTP_STREAMS_COUNT);
 	return streamsCount > 0 ? streamsCount - 1 : 0;
@@ -473,6 +485,7 @@ void SctpTransport::doRecv() {
 	std::lock_guard lock(mRecvMutex);
 	--mPendingRecvCount;
 	try {
+		size_t received = 0;
 		while (state() != State::Disconnected && state() != State::Failed) {
 			const size_t bufferSize = 65536;
 			byte buffer[bufferSize];
@@ -510,6 +523,7 @@ void SctpTransport::doRecv() {
 
 			} else {
 				// SCTP message
+				received += size_t(len);
 				mPartialMessage.insert(mPartialMessage.end(), buffer, buffer + len);
 				if (mPartialMessage.size() > mMaxMessageSize) {
 					PLOG_WARNING << "SCTP message is too large, truncating it";
@@ -527,6 +541,12 @@ void SctpTransport::doRecv() {
 				}
 			}
 		}
+
+		// If a single pass drained more than half of the window, the receive buffer is likely to
+		// limit the throughput
+		if (received > size_t(mRecvBufferSize) / 2)
+			growRecvBuffer();
+
 	} catch (const std::exception &e) {
 		PLOG_WARNING << e.what();
 	}
@@ -675,6 +695,9 @@ bool SctpTransport::trySendMessage(message_ptr message) {
 
 	if (ret < 0) {
 		if (errno == EWOULDBLOCK || errno == EAGAIN) {
+			if (growSendBuffer())
+				return trySendMessage(message);
+
 			PLOG_VERBOSE << "SCTP sending not possible";
 			return false;
 		}
@@ -689,6 +712,43 @@ bool SctpTransport::trySendMessage(message_ptr message) {
 	return true;
 }
 
+bool SctpTransport::growSendBuffer() {
+	// Requires mSendMutex to be locked
+	int size = mSendBufferSize;
+	if (size >= mMaxSendBufferSize)
+		return false;
+
+	size = int(std::min(int64_t(size) * 2, int64_t(mMaxSendBufferSize)));
+	if (usrsctp_setsockopt(mSock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size))) {
+		PLOG_WARNING << "Could not grow SCTP send buffer, errno=" << errno;
+		mMaxSendBufferSize = mSendBufferSize; // don't try again
+		return false;
+	}
+
+	PLOG_DEBUG << "SCTP send buffer size grown to " << size;
+	mSendBufferSize = size;
+	return true;
+}
+
+bool SctpTransport::growRecvBuffer() {
+	// Requires mRecvMutex to be locked
+	int size = mRecvBufferSize;
+	if (size >= mMaxRecvBufferSize)
+		return false;
+
+	// The advertised receiver window is recomputed from the buffer size on the next SACK
+	size = int(std::min(int64_t(size) * 2, int64_t(mMaxRecvBufferSize)));
+	if (usrsctp_setsockopt(mSock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size))) {
+		PLOG_WARNING << "Could not grow SCTP recv buffer, errno=" << errno;
+		mMaxRecvBufferSize = mRecvBufferSize; // don't try again
+		return false;
+	}
+
+	PLOG_DEBUG << "SCTP recv buffer size grown to " << size;
+	mRecvBufferSize = size;
+	return true;
+}
+
 void SctpTransport::updateBufferedAmount(uint16_t streamId, ptrdiff_t delta) {
 	// Requires mSendMutex to be locked
 
@@ -947,6 +1007,19 @@ size_t SctpTransport::bytesSent() { return mBytesSent; }
 
 size_t SctpTransport::bytesReceived() { return mBytesReceived; }
 
+size_t SctpTransport::sendBufferSize() const { return size_t(mSendBufferSize); }
+
+size_t SctpTransport::recvBufferSize() const { return size_t(mRecvBufferSize); }
+
+size_t SctpTransport::bufferedAmount() {
+	std::lock_guard lock(mSendMutex);
+	size_t total = 0;
+	for (const auto &[stream, amount] : mBufferedAmount)
+		total += amount;
+
+	return total;
+}
+
 optional<milliseconds> SctpTransport::rtt() {
 	if (state() != State::Connected)
 		return nullopt;
@@ -48,6 +48,7 @@ public:
 	void start() override;
 	void stop() override;
 	bool send(message_ptr message) override; // false if buffered
+	void inject(message_ptr message);        // message received before the transport started
 	bool flush();
 	void closeStream(unsigned int stream);
 	void close();
@@ -60,6 +61,11 @@ public:
 	size_t bytesReceived();
 	optional<std::chrono::milliseconds> rtt();
 
+	// Footprint
+	size_t sendBufferSize() const;
+	size_t recvBufferSize() const;
+	size_t bufferedAmount();
+
 private:
 	// Order seems wrong but these are the actual values
 	// See https://datatracker.ietf.org/doc/html/draft-ietf-rtcweb-data-channel-13#section-8
@@ -86,6 +92,8 @@ private:
 	void enqueueFlush();
 	bool trySendQueue();
 	bool trySendMessage(message_ptr message);
+	bool growSendBuffer();
+	bool growRecvBuffer();
 	void updateBufferedAmount(uint16_t streamId, ptrdiff_t delta);
 	void triggerBufferedAmount(uint16_t streamId, size_t amount);
 	void sendReset(uint16_t streamId);
@@ -111,6 +119,11 @@ private:
 	std::map<uint16_t, size_t> mBufferedAmount;
 	amount_callback mBufferedAmountCallback;
 
+	// Buffers start small and grow on demand
+	std::atomic<int> mSendBufferSize = 0, mRecvBufferSize = 0;
+	int mMaxSendBufferSize = 0; // protected by mSendMutex
+	int mMaxRecvBufferSize = 0; // protected by mRecvMutex
+
 	std::mutex mWriteMutex;
 	std::condition_variable mWrittenCondition;
 	std::atomic<bool> mWritten = false;     // written outside lock
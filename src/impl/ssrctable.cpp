@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "ssrctable.hpp"
+#include "rtpextension.hpp"
+#include "track.hpp"
+
+#include "rtc/rtp.hpp"
+
+namespace rtc::impl {
+
+namespace {
+
+const string MidExtUri = "urn:ietf:params:rtp-hdrext:sdes:mid";
+const string RidExtUri = "urn:ietf:params:rtp-hdrext:sdes:rtp-stream-id";
+const string RepairedRidExtUri = "urn:ietf:params:rtp-hdrext:sdes:repaired-rtp-stream-id";
+
+} // namespace
+
+SsrcTable::SsrcTable(const std::unordered_map<uint32_t, weak_ptr<Track>> &tracksBySsrc,
+                     const std::vector<weak_ptr<Track>> &trackLines) {
+	// Keep the load factor under 1/2 so probe sequences stay short
+	unsigned int bits = 3;
+	while ((size_t(1) << bits) < tracksBySsrc.size() * 2 && bits < 31)
+		++bits;
+
+	mShift = 32 - bits;
+	mSlots.resize(size_t(1) << bits);
+
+	const size_t mask = mSlots.size() - 1;
+	for (const auto &[ssrc, weakTrack] : tracksBySsrc) {
+		auto track = weakTrack.lock();
+		if (!track || track->isClosed())
+			continue;
+
+		size_t i = index(ssrc);
+		while (mSlots[i].track)
+			i = (i + 1) & mask;
+
+		mSlots[i].ssrc = ssrc;
+		mSlots[i].track = std::move(track);
+		++mSize;
+	}
+
+	for (const auto &weakTrack : trackLines) {
+		auto track = weakTrack.lock();
+		if (!track || track->isClosed())
+			continue;
+
+		if (trackLines.size() == 1) {
+			mSingle = track;
+			break;
+		}
+
+		// With BUNDLE, extension IDs are identical across media sections (RFC 8843)
+		auto media = track->description();
+		if (!mMidExtId)
+			mMidExtId = FindExtMapId(media, MidExtUri);
+		if (!mRidExtId)
+			mRidExtId = FindExtMapId(media, RidExtUri);
+		if (!mRepairedRidExtId)
+			mRepairedRidExtId = FindExtMapId(media, RepairedRidExtUri);
+
+		mMids.emplace_back(track->mid(), track);
+
+		// Remote RIDs are kept as "rid:<id> <direction> ..." attributes
+		for (const auto &attr : media.attributes()) {
+			if (attr.compare(0, 4, "rid:") != 0)
+				continue;
+
+			string rid = attr.substr(4, attr.find(' ') - 4);
+			if (!rid.empty())
+				mRids.emplace_back(std::move(rid), track);
+		}
+	}
+}
+
+Track *SsrcTable::find(uint32_t ssrc) const {
+	const size_t mask = mSlots.size() - 1;
+	size_t i = index(ssrc);
+	while (mSlots[i].track) {
+		if (mSlots[i].ssrc == ssrc)
+			return mSlots[i].track.get();
+
+		i = (i + 1) & mask;
+	}
+	return nullptr;
+}
+
+shared_ptr<Track> SsrcTable::route(const message_ptr &message) const {
+	if (message->type != Message::Binary || message->size() < sizeof(RtpHeader))
+		return nullptr;
+
+	auto extension = [&message](int id) -> optional<string_view> {
+		auto found = FindRtpExtension(message->data(), message->size(), id);
+		if (!found)
+			return nullopt;
+
+		return string_view(reinterpret_cast<const char *>(message->data() + found->first),
+		                   found->second);
+	};
+
+	if (auto mid = extension(mMidExtId))
+		if (auto track = Lookup(mMids, *mid))
+			return track;
+
+	if (auto rid = extension(mRidExtId))
+		if (auto track = Lookup(mRids, *rid))
+			return track;
+
+	if (auto rid = extension(mRepairedRidExtId))
+		if (auto track = Lookup(mRids, *rid))
+			return track;
+
+	return nullptr;
+}
+
+shared_ptr<Track> SsrcTable::Lookup(const std::vector<std::pair<string, shared_ptr<Track>>> &routes,
+                                    string_view id) {
+	for (const auto &[key, track] : routes)
+		if (key == id)
+			return track;
+
+	return nullptr;
+}
+
+} // namespace rtc::impl
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_IMPL_SSRC_TABLE_H
+#define RTC_IMPL_SSRC_TABLE_H
+
+#include "common.hpp"
+#include "message.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace rtc::impl {
+
+class Track;
+
+// Immutable open-addressing table mapping SSRCs to tracks. It holds strong references so lookups
+// don't need to lock weak pointers. A new table is built and published on renegotiation, and
+// readers keep the table they loaded alive while they use it.
+class SsrcTable final {
+public:
+	SsrcTable(const std::unordered_map<uint32_t, weak_ptr<Track>> &tracksBySsrc,
+	          const std::vector<weak_ptr<Track>> &trackLines);
+
+	Track *find(uint32_t ssrc) const;
+	Track *single() const { return mSingle.get(); } // the only track if there is exactly one
+	size_t size() const { return mSize; }
+
+	// Find the track of an RTP packet with an unsignaled SSRC from its MID or RID header
+	// extension (RFC 8843 and RFC 8852), null if it can't be routed
+	shared_ptr<Track> route(const message_ptr &message) const;
+
+private:
+	struct Slot {
+		uint32_t ssrc = 0;
+		shared_ptr<Track> track; // null if the slot is empty
+	};
+
+	size_t index(uint32_t ssrc) const { return size_t((ssrc * 0x9E3779B1u) >> mShift); }
+	static shared_ptr<Track> Lookup(const std::vector<std::pair<string, shared_ptr<Track>>> &routes,
+	                                string_view id);
+
+	std::vector<Slot> mSlots;
+	unsigned int mShift;
+	size_t mSize = 0;
+	shared_ptr<Track> mSingle;
+
+	// Negotiated header extension IDs, 0 if absent
+	int mMidExtId = 0;
+	int mRidExtId = 0;
+	int mRepairedRidExtId = 0;
+	std::vector<std::pair<string, shared_ptr<Track>>> mMids;
+	std::vector<std::pair<string, shared_ptr<Track>>> mRids;
+};
+
+} // namespace rtc::impl
+
+#endif
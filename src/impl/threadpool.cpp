@@ -9,14 +9,21 @@
 #include "threadpool.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+
 namespace rtc::impl {
 
 ThreadPool &ThreadPool::Instance() {
-	static ThreadPool *instance = new ThreadPool;
+	static ThreadPool *instance = new ThreadPool("RTC worker");
+	return *instance;
+}
+
+ThreadPool &ThreadPool::CryptoInstance() {
+	static ThreadPool *instance = new ThreadPool("RTC crypto");
 	return *instance;
 }
 
-ThreadPool::ThreadPool() {}
+ThreadPool::ThreadPool(string name) : mName(std::move(name)) {}
 
 ThreadPool::~ThreadPool() {}
 
@@ -54,8 +61,15 @@ void ThreadPool::clear() {
 		mTasks.pop();
 }
 
+ThreadPool::Stats ThreadPool::stats() const {
+	std::unique_lock lock(mMutex);
+	Stats result = mStats;
+	result.pending = mTasks.size();
+	return result;
+}
+
 void ThreadPool::run() {
-	utils::this_thread::set_name("RTC worker");
+	utils::this_thread::set_name(mName);
 	++mBusyWorkers;
 	scope_guard guard([&]() { --mBusyWorkers; });
 	while (runOne()) {
@@ -76,7 +90,12 @@ std::function<void()> ThreadPool::dequeue() {
 		std::optional<clock::time_point> time;
 		if (!mTasks.empty()) {
 			time = mTasks.top().time;
-			if (*time <= clock::now()) {
+			if (auto now = clock::now(); *time <= now) {
+				auto wait = now - *time;
+				++mStats.executed;
+				mStats.totalWait += wait;
+				mStats.maxWait = std::max(mStats.maxWait, wait);
+
 				auto func = std::move(mTasks.top().func);
 				mTasks.pop();
 				return func;
@@ -35,6 +35,14 @@ public:
 	using clock = std::chrono::steady_clock;
 
 	static ThreadPool &Instance();
+	static ThreadPool &CryptoInstance(); // for handshakes and key generation
+
+	struct Stats {
+		size_t executed = 0; // tasks dequeued for execution
+		size_t pending = 0;  // tasks in the queue, including scheduled ones
+		clock::duration totalWait = clock::duration::zero(); // time spent late in the queue
+		clock::duration maxWait = clock::duration::zero();
+	};
 
 	ThreadPool(const ThreadPool &) = delete;
 	ThreadPool &operator=(const ThreadPool &) = delete;
@@ -47,6 +55,7 @@ public:
 	void clear();
 	void run();
 	bool runOne();
+	Stats stats() const;
 
 	template <class F, class... Args>
 	auto enqueue(F &&f, Args &&...args) noexcept -> invoke_future_t<F, Args...>;
@@ -60,11 +69,13 @@ public:
 	    -> invoke_future_t<F, Args...>;
 
 private:
-	ThreadPool();
+	ThreadPool(string name);
 	~ThreadPool();
 
 	std::function<void()> dequeue(); // returns null function if joining
 
+	const string mName;
+	Stats mStats; // protected by mMutex
 	std::vector<std::thread> mWorkers;
 	std::atomic<int> mBusyWorkers = 0;
 	std::atomic<bool> mJoining = false;
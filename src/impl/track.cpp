@@ -10,8 +10,12 @@
 #include "internals.hpp"
 #include "logcounter.hpp"
 #include "peerconnection.hpp"
+#include "processor.hpp"
 #include "rtp.hpp"
 
+#include <algorithm>
+#include <thread>
+
 namespace rtc::impl {
 
 static LogCounter COUNTER_MEDIA_BAD_DIRECTION(plog::warning,
@@ -19,8 +23,56 @@ static LogCounter COUNTER_MEDIA_BAD_DIRECTION(plog::warning,
 static LogCounter COUNTER_QUEUE_FULL(plog::warning,
                                      "Number of media packets dropped due to a full queue");
 
+namespace {
+
+// Each track is bound to a fan-out lane, a lane processes its tasks in order on the thread pool
+std::vector<Processor *> &FanoutLanes() {
+	static auto *lanes = []() {
+		auto *result = new std::vector<Processor *>;
+		unsigned int count = std::max(std::thread::hardware_concurrency(), 1u);
+		for (unsigned int i = 0; i < count; ++i)
+			result->push_back(new Processor);
+
+		return result;
+	}();
+	return *lanes;
+}
+
+std::atomic<size_t> FanoutCounter = 0;
+
+} // namespace
+
+void Track::Fanout(std::vector<shared_ptr<Track>> tracks, message_ptr message) {
+	if (!message)
+		return;
+
+	auto &lanes = FanoutLanes();
+	std::vector<std::vector<shared_ptr<Track>>> batches(lanes.size());
+	for (auto &track : tracks)
+		if (track && !track->isClosed())
+			batches[track->mFanoutIndex % lanes.size()].push_back(std::move(track));
+
+	// The message is shared read-only between lanes, each track sends its own copy as handlers
+	// and transports might modify it
+	shared_ptr<const Message> source = std::move(message);
+	for (size_t i = 0; i < lanes.size(); ++i) {
+		if (batches[i].empty())
+			continue;
+
+		lanes[i]->enqueue([source, batch = std::move(batches[i])]() {
+			for (const auto &track : batch) {
+				try {
+					track->outgoing(std::make_shared<Message>(*source));
+				} catch (const std::exception &e) {
+					PLOG_WARNING << "Fan-out send failed: " << e.what();
+				}
+			}
+		});
+	}
+}
+
 Track::Track(weak_ptr<PeerConnection> pc, Description::Media desc)
-    : mPeerConnection(pc), mMediaDescription(std::move(desc)),
+    : mPeerConnection(pc), mFanoutIndex(FanoutCounter++), mMediaDescription(std::move(desc)),
       mRecvQueue(RECV_QUEUE_LIMIT, [](const message_ptr &m) { return m->size(); }) {
 
 	// Discard messages by default if track is send only
@@ -37,6 +89,22 @@ Track::~Track() {
 	}
 }
 
+void Track::addHandle() { ++mHandles; }
+
+void Track::releaseHandle() {
+	if (--mHandles == 0)
+		release();
+}
+
+void Track::release() {
+	// The peer connection keeps strong references for demultiplexing, so close the track as if it
+	// was destroyed and have the references dropped.
+	close();
+
+	if (auto pc = mPeerConnection.lock())
+		pc->releaseTracks();
+}
+
 string Track::mid() const {
 	std::shared_lock lock(mMutex);
 	return mMediaDescription.mid();
@@ -62,7 +130,7 @@ void Track::setDescription(Description::Media desc) {
 	}
 
 	if (auto handler = getMediaHandler())
-		handler->media(description());
+		handler->mediaChain(description());
 }
 
 void Track::close() {
@@ -73,6 +141,7 @@ void Track::close() {
 
 	setMediaHandler(nullptr);
 	resetCallbacks();
+	targetBitrateCallback = nullptr;
 }
 
 message_variant Track::trackMessageToVariant(message_ptr message) {
@@ -141,13 +210,20 @@ void Track::incoming(message_ptr message) {
 	}
 
 	message_vector messages{std::move(message)};
-	if (auto handler = getMediaHandler())
+	if (auto handler = getMediaHandler()) {
 		handler->incomingChain(messages, [this, weak_this = weak_from_this()](message_ptr m) {
 			if (auto locked = weak_this.lock()) {
 				transportSend(m);
 			}
 		});
 
+		// Estimations are usually updated by incoming feedback
+		if (targetBitrateCallback)
+			if (auto bitrate = handler->targetBitrate();
+			    bitrate && mTargetBitrate.exchange(*bitrate) != *bitrate)
+				targetBitrateCallback(*bitrate);
+	}
+
 	for (auto &m : messages) {
 		// Tail drop if queue is full
 		if (mRecvQueue.full()) {
@@ -184,11 +260,8 @@ bool Track::outgoing(message_ptr message) {
 				transportSend(m);
 			}
 		});
-		bool ret = false;
-		for (auto &m : messages)
-			ret = transportSend(std::move(m));
 
-		return ret;
+		return transportSend(std::move(messages));
 
 	} else {
 		return transportSend(std::move(message));
@@ -218,6 +291,31 @@ bool Track::transportSend([[maybe_unused]] message_ptr message) {
 #endif
 }
 
+bool Track::transportSend([[maybe_unused]] message_vector messages) {
+#if RTC_ENABLE_MEDIA
+	if (messages.empty())
+		return false;
+
+	shared_ptr<DtlsSrtpTransport> transport;
+	{
+		std::shared_lock lock(mMutex);
+		transport = mDtlsSrtpTransport.lock();
+		if (!transport)
+			throw std::runtime_error("Track is closed");
+
+		// Set recommended medium-priority DSCP value
+		// See https://www.rfc-editor.org/rfc/rfc8837.html#section-5
+		unsigned int dscp = mMediaDescription.type() == "audio" ? 46 : 36; // EF or AF42
+		for (auto &message : messages)
+			message->dscp = dscp;
+	}
+
+	return transport->sendMedia(std::move(messages));
+#else
+	throw std::runtime_error("Track is disabled (not compiled with media support)");
+#endif
+}
+
 void Track::setMediaHandler(shared_ptr<MediaHandler> handler) {
 	{
 		std::unique_lock lock(mMutex);
@@ -225,7 +323,7 @@ void Track::setMediaHandler(shared_ptr<MediaHandler> handler) {
 	}
 
 	if (handler)
-		handler->media(description());
+		handler->mediaChain(description());
 }
 
 shared_ptr<MediaHandler> Track::getMediaHandler() {
@@ -238,6 +336,11 @@ void Track::onFrame(std::function<void(binary data, FrameInfo frame)> callback)
 	flushPendingMessages();
 }
 
+void Track::onTargetBitrate(std::function<void(unsigned int bitrate)> callback) {
+	targetBitrateCallback = callback;
+	mTargetBitrate = 0; // notify the current estimation
+}
+
 void Track::flushPendingMessages() {
 	if (!mOpenTriggered)
 		return;
@@ -28,10 +28,18 @@ struct PeerConnection;
 
 class Track final : public std::enable_shared_from_this<Track>, public Channel {
 public:
+	static void Fanout(std::vector<shared_ptr<Track>> tracks, message_ptr message);
+
 	Track(weak_ptr<PeerConnection> pc, Description::Media desc);
 	~Track();
 
 	void close();
+
+	// Several user-facing handles may share the track, for instance from addTrack() and onTrack().
+	// The track is released when the last one is destroyed.
+	void addHandle();
+	void releaseHandle();
+
 	void incoming(message_ptr message);
 	bool outgoing(message_ptr message);
 
@@ -42,6 +50,7 @@ public:
 	message_variant trackMessageToVariant(message_ptr message);
 
 	void onFrame(std::function<void(binary data, FrameInfo frame)> callback);
+	void onTargetBitrate(std::function<void(unsigned int bitrate)> callback);
 
 	bool isOpen() const;
 	bool isClosed() const;
@@ -60,9 +69,13 @@ public:
 #endif
 
 	bool transportSend(message_ptr message);
+	bool transportSend(message_vector messages);
 
 private:
+	void release();
+
 	const weak_ptr<PeerConnection> mPeerConnection;
+	const size_t mFanoutIndex; // selects the fan-out lane
 #if RTC_ENABLE_MEDIA
 	weak_ptr<DtlsSrtpTransport> mDtlsSrtpTransport;
 #endif
@@ -73,10 +86,13 @@ private:
 	mutable std::shared_mutex mMutex;
 
 	std::atomic<bool> mIsClosed = false;
+	std::atomic<unsigned int> mHandles = 0;
 
 	Queue<message_ptr> mRecvQueue;
 
 	synchronized_callback<binary, FrameInfo> frameCallback;
+	synchronized_callback<unsigned int> targetBitrateCallback;
+	std::atomic<unsigned int> mTargetBitrate = 0; // last notified
 };
 
 } // namespace rtc::impl
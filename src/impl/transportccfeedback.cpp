@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "transportccfeedback.hpp"
+#include "internals.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace rtc::impl {
+
+namespace {
+
+// Packet status symbols
+const uint8_t NotReceived = 0;
+const uint8_t SmallDelta = 1;
+const uint8_t LargeDelta = 2;
+
+// Encode symbols in run-length chunks where possible, otherwise in status vector chunks
+std::vector<uint16_t> EncodeChunks(const std::vector<uint8_t> &symbols) {
+	std::vector<uint16_t> chunks;
+	size_t i = 0;
+	while (i < symbols.size()) {
+		size_t run = 1;
+		while (i + run < symbols.size() && symbols[i + run] == symbols[i] && run < 0x1FFF)
+			++run;
+
+		if (run >= 7) {
+			chunks.push_back(uint16_t((symbols[i] << 13) | run));
+			i += run;
+			continue;
+		}
+
+		const size_t count = std::min(symbols.size() - i, size_t(14));
+		bool small = true;
+		for (size_t k = 0; k < count; ++k)
+			if (symbols[i + k] == LargeDelta)
+				small = false;
+
+		uint16_t chunk;
+		if (small) {
+			chunk = 0x8000; // 14 one-bit symbols
+			for (size_t k = 0; k < 14; ++k)
+				if (k < count)
+					chunk |= uint16_t(symbols[i + k] << (13 - k));
+
+			i += count;
+		} else {
+			chunk = 0xC000; // 7 two-bit symbols
+			for (size_t k = 0; k < 7 && i + k < symbols.size(); ++k)
+				chunk |= uint16_t(symbols[i + k] << (2 * (6 - k)));
+
+			i += std::min(symbols.size() - i, size_t(7));
+		}
+		chunks.push_back(chunk);
+	}
+	return chunks;
+}
+
+} // namespace
+
+message_ptr MakeTransportCcFeedback(SSRC ssrc, const TransportCcFeedback &feedback) {
+	std::vector<uint8_t> symbols;
+	symbols.reserve(feedback.arrivals.size());
+	binary deltas;
+	int64_t previous = feedback.referenceTime * 64000;
+	for (const auto &arrival : feedback.arrivals) {
+		if (!arrival) {
+			symbols.push_back(NotReceived);
+			continue;
+		}
+
+		const int64_t delta = (arrival->count() - previous) / 250;
+		if (delta * 250 != arrival->count() - previous || delta < -0x8000 || delta > 0x7FFF)
+			throw std::invalid_argument("Invalid transport-wide feedback arrival time");
+
+		if (delta >= 0 && delta <= 0xFF) {
+			symbols.push_back(SmallDelta);
+			deltas.push_back(byte(delta));
+		} else {
+			symbols.push_back(LargeDelta);
+			deltas.push_back(byte((delta >> 8) & 0xFF));
+			deltas.push_back(byte(delta & 0xFF));
+		}
+		previous = arrival->count();
+	}
+
+	const auto chunks = EncodeChunks(symbols);
+	const size_t size = sizeof(RtcpFbHeader) + 8 + chunks.size() * 2 + deltas.size();
+	const size_t padding = (4 - size % 4) % 4;
+
+	auto message = make_message(size + padding, Message::Control);
+	auto fb = reinterpret_cast<RtcpFbHeader *>(message->data());
+	fb->header.prepareHeader(205, 15, uint16_t((size + padding) / 4 - 1));
+	fb->setPacketSenderSSRC(ssrc);
+	fb->setMediaSourceSSRC(ssrc);
+
+	auto p = reinterpret_cast<uint8_t *>(message->data()) + sizeof(RtcpFbHeader);
+	const uint16_t base = feedback.baseSequenceNumber;
+	const uint16_t count = uint16_t(symbols.size());
+	const int64_t reference = feedback.referenceTime;
+	*p++ = uint8_t(base >> 8);
+	*p++ = uint8_t(base & 0xFF);
+	*p++ = uint8_t(count >> 8);
+	*p++ = uint8_t(count & 0xFF);
+	*p++ = uint8_t((reference >> 16) & 0xFF);
+	*p++ = uint8_t((reference >> 8) & 0xFF);
+	*p++ = uint8_t(reference & 0xFF);
+	*p++ = feedback.feedbackCount;
+	for (uint16_t chunk : chunks) {
+		*p++ = uint8_t(chunk >> 8);
+		*p++ = uint8_t(chunk & 0xFF);
+	}
+	std::memcpy(p, deltas.data(), deltas.size());
+
+	if (padding > 0) {
+		// Set the padding bit, the last byte is the padding count
+		message->at(0) |= byte(0x20);
+		message->back() = byte(padding);
+	}
+
+	return message;
+}
+
+optional<TransportCcFeedback> ParseTransportCcFeedback(const byte *data, size_t size) {
+	// Base sequence number, packet status count, reference time, and feedback packet count
+	const size_t headerSize = sizeof(RtcpFbHeader) + 8;
+	if (size < headerSize)
+		return nullopt;
+
+	const uint8_t *p = reinterpret_cast<const uint8_t *>(data) + sizeof(RtcpFbHeader);
+	const uint8_t *end = reinterpret_cast<const uint8_t *>(data) + size;
+	if (reinterpret_cast<const RtcpHeader *>(data)->padding())
+		end -= std::min(size_t(end[-1]), size - headerSize);
+
+	TransportCcFeedback feedback;
+	feedback.baseSequenceNumber = uint16_t((p[0] << 8) | p[1]);
+	const uint16_t count = uint16_t((p[2] << 8) | p[3]);
+	feedback.referenceTime = (p[4] << 16) | (p[5] << 8) | p[6];
+	if (feedback.referenceTime & 0x800000)
+		feedback.referenceTime -= 0x1000000; // signed 24 bits
+
+	feedback.feedbackCount = p[7];
+	p += 8;
+
+	// Packet chunks are run-length chunks or status vector chunks with 1-bit or 2-bit symbols
+	std::vector<uint8_t> symbols;
+	symbols.reserve(count);
+	while (symbols.size() < count) {
+		if (end - p < 2)
+			return nullopt;
+
+		const uint16_t chunk = uint16_t((p[0] << 8) | p[1]);
+		p += 2;
+		if (!(chunk & 0x8000)) {
+			const uint8_t symbol = (chunk >> 13) & 0x03;
+			const size_t run = std::min(size_t(chunk & 0x1FFF), count - symbols.size());
+			symbols.insert(symbols.end(), run, symbol);
+		} else if (!(chunk & 0x4000)) {
+			for (int i = 13; i >= 0 && symbols.size() < count; --i)
+				symbols.push_back((chunk >> i) & 0x01);
+		} else {
+			for (int i = 6; i >= 0 && symbols.size() < count; --i)
+				symbols.push_back((chunk >> (2 * i)) & 0x03);
+		}
+	}
+
+	// Receive deltas are in multiples of 250us, from the reference time in multiples of 64ms
+	feedback.arrivals.reserve(count);
+	auto arrival = std::chrono::microseconds(feedback.referenceTime * 64000);
+	for (uint8_t symbol : symbols) {
+		switch (symbol) {
+		case NotReceived:
+			feedback.arrivals.push_back(nullopt);
+			continue;
+		case SmallDelta:
+			if (end - p < 1)
+				return nullopt;
+
+			arrival += std::chrono::microseconds(int64_t(p[0]) * 250);
+			p += 1;
+			break;
+		case LargeDelta:
+			if (end - p < 2)
+				return nullopt;
+
+			arrival += std::chrono::microseconds(int64_t(int16_t((p[0] << 8) | p[1])) * 250);
+			p += 2;
+			break;
+		default:
+			PLOG_VERBOSE << "Invalid transport-wide feedback symbol";
+			return nullopt;
+		}
+		feedback.arrivals.push_back(arrival);
+	}
+
+	return feedback;
+}
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_IMPL_TRANSPORT_CC_FEEDBACK_H
+#define RTC_IMPL_TRANSPORT_CC_FEEDBACK_H
+
+#if RTC_ENABLE_MEDIA
+
+#include "common.hpp"
+#include "message.hpp"
+#include "rtp.hpp"
+
+#include <chrono>
+#include <vector>
+
+namespace rtc::impl {
+
+// Transport-wide feedback (draft-holmer-rmcat-transport-wide-cc-extensions-01)
+struct TransportCcFeedback {
+	uint16_t baseSequenceNumber = 0;
+	int64_t referenceTime = 0; // in multiples of 64ms, sent on 24 bits and parsed as signed
+	uint8_t feedbackCount = 0;
+
+	// Arrival time in the receiver clock of each packet from the base one, if it was received.
+	// Receive deltas are in multiples of 250us from the reference time, then from the previous
+	// arrival, on a signed 16-bit range.
+	std::vector<optional<std::chrono::microseconds>> arrivals;
+};
+
+// Throws if an arrival time can't be represented with a receive delta
+message_ptr MakeTransportCcFeedback(SSRC ssrc, const TransportCcFeedback &feedback);
+
+// Returns nullopt if the RTCP packet is invalid or truncated
+optional<TransportCcFeedback> ParseTransportCcFeedback(const byte *data, size_t size);
+
+} // namespace rtc::impl
+
+#endif // RTC_ENABLE_MEDIA
+
+#endif
@@ -11,6 +11,8 @@
 
 #include "common.hpp"
 
+#include <algorithm>
+#include <array>
 #include <climits>
 #include <limits>
 #include <map>
@@ -77,6 +79,37 @@ template <typename T> uint32_t to_uint32(T i) {
 		throw std::invalid_argument("Integer out of range");
 }
 
+// Set with inline storage for up to N elements, it only allocates beyond that. Lookups are
+// linear, so it is meant for a handful of elements.
+template <typename T, size_t N = 8> class small_set {
+public:
+	bool insert(const T &value) {
+		if (std::find(begin(), end(), value) != end())
+			return false;
+
+		if (mSize < N) {
+			mInline[mSize] = value;
+		} else {
+			if (mSize == N)
+				mOverflow.assign(mInline.begin(), mInline.end());
+
+			mOverflow.push_back(value);
+		}
+		++mSize;
+		return true;
+	}
+
+	const T *begin() const { return mSize <= N ? mInline.data() : mOverflow.data(); }
+	const T *end() const { return begin() + mSize; }
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+
+private:
+	std::array<T, N> mInline{};
+	std::vector<T> mOverflow;
+	size_t mSize = 0;
+};
+
 namespace this_thread {
 
 void set_name(const string &name);
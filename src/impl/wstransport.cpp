@@ -244,6 +244,10 @@ bool WsTransport::sendHttpError(int code) {
 // +---------------------------------------------------------------+
 
 size_t WsTransport::parseFrame(byte *buffer, size_t size, Frame &frame) {
+	return ParseFrame(buffer, size, frame, mMaxMessageSize);
+}
+
+size_t WsTransport::ParseFrame(byte *buffer, size_t size, Frame &frame, size_t maxMessageSize) {
 	const byte *end = buffer + size;
 	if (end - buffer < 2)
 		return 0;
@@ -278,7 +282,7 @@ size_t WsTransport::parseFrame(byte *buffer, size_t size, Frame &frame) {
 	}
 
 	const size_t maxControlFrameLength = 125;
-	const size_t maxFrameLength = std::max(maxControlFrameLength, mMaxMessageSize);
+	const size_t maxFrameLength = std::max(maxControlFrameLength, maxMessageSize);
 	if (size_t(end - cur) < std::min(frame.length, maxFrameLength))
 		return 0;
 
@@ -375,6 +379,10 @@ bool WsTransport::sendFrame(const Frame &frame) {
 	PLOG_DEBUG << "WebSocket sending frame: opcode=" << int(frame.opcode)
 	           << ", length=" << frame.length;
 
+	return outgoing(BuildFrame(frame));
+}
+
+message_ptr WsTransport::BuildFrame(const Frame &frame) {
 	byte buffer[14];
 	byte *cur = buffer;
 
@@ -409,7 +417,7 @@ bool WsTransport::sendFrame(const Frame &frame) {
 	std::copy(frame.payload, frame.payload + frame.length,
 	          message->begin() + length); // payload
 
-	return outgoing(std::move(message));
+	return message;
 }
 
 void WsTransport::addOutstandingPing() {
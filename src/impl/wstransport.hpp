@@ -42,7 +42,6 @@ public:
 
 	bool isClient() const { return mIsClient; }
 
-private:
 	enum Opcode : uint8_t {
 		CONTINUATION = 0,
 		TEXT_FRAME = 1,
@@ -60,6 +59,12 @@ private:
 		bool mask = true;
 	};
 
+	// Stateless frame codec, payload is unmasked in place when parsing and masked in place when
+	// building
+	static size_t ParseFrame(byte *buffer, size_t size, Frame &frame, size_t maxMessageSize);
+	static message_ptr BuildFrame(const Frame &frame);
+
+private:
 	bool sendHttpRequest();
 	bool sendHttpError(int code);
 	bool sendHttpResponse();
@@ -0,0 +1,265 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "jitterbufferhandler.hpp"
+
+#include "impl/internals.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace rtc {
+
+JitterBufferHandler::JitterBufferHandler(std::chrono::milliseconds maxDelay, size_t windowSize)
+    : mMaxDelay(maxDelay), mWindowSize(std::clamp(windowSize, size_t(17), size_t(32768))),
+      mRoundTripTime(DEFAULT_RTT) {}
+
+void JitterBufferHandler::setRoundTripTime(std::chrono::milliseconds rtt) {
+	std::lock_guard lock(mMutex);
+	mRoundTripTime = rtt;
+}
+
+void JitterBufferHandler::media(const Description::Media &desc) {
+	std::unordered_map<uint8_t, uint8_t> payloadTypes;
+	for (int pt : desc.payloadTypes()) {
+		auto map = desc.rtpMap(pt);
+		if (!map || (map->format != "rtx" && map->format != "RTX"))
+			continue;
+
+		for (const auto &fmtp : map->fmtps) {
+			if (fmtp.compare(0, 4, "apt=") != 0)
+				continue;
+
+			try {
+				payloadTypes.emplace(uint8_t(pt), uint8_t(std::stoi(fmtp.substr(4))));
+			} catch (...) {
+				PLOG_WARNING << "Invalid RTX fmtp: " << fmtp;
+			}
+		}
+	}
+
+	// a=ssrc-group:FID <media SSRC> <RTX SSRC>
+	std::unordered_map<SSRC, SSRC> rtxSsrcs;
+	for (const auto &attr : desc.attributes()) {
+		if (attr.compare(0, 15, "ssrc-group:FID ") != 0)
+			continue;
+
+		std::istringstream ss(attr.substr(15));
+		SSRC ssrc = 0, rtxSsrc = 0;
+		if (ss >> ssrc >> rtxSsrc)
+			rtxSsrcs.emplace(rtxSsrc, ssrc);
+	}
+
+	std::lock_guard lock(mMutex);
+	mRtxPayloadTypes = std::move(payloadTypes);
+	mRtxSsrcs = std::move(rtxSsrcs);
+}
+
+void JitterBufferHandler::incoming(message_vector &messages, const message_callback &send) {
+	const auto now = clock::now();
+	message_vector result;
+	message_vector nacks;
+	{
+		std::lock_guard lock(mMutex);
+		for (auto &message : messages) {
+			if (message->type == Message::Control || message->size() < sizeof(RtpHeader)) {
+				result.push_back(std::move(message));
+				continue;
+			}
+
+			if (!unwrapRtx(message))
+				continue;
+
+			auto rtp = reinterpret_cast<const RtpHeader *>(message->data());
+			auto &stream = mStreams[rtp->ssrc()];
+			push(stream, std::move(message), now, result);
+		}
+
+		for (auto &[ssrc, stream] : mStreams) {
+			release(stream, now, result);
+			if (auto nack = makeNack(ssrc, stream, now))
+				nacks.push_back(std::move(nack));
+		}
+	}
+
+	messages.swap(result);
+
+	for (auto &nack : nacks)
+		send(std::move(nack));
+}
+
+bool JitterBufferHandler::unwrapRtx(message_ptr &message) {
+	auto rtp = reinterpret_cast<RtpHeader *>(message->data());
+	auto it = mRtxPayloadTypes.find(rtp->payloadType());
+	if (it == mRtxPayloadTypes.end())
+		return true;
+
+	// Find the original stream, assume it is the only one if it was not signaled
+	SSRC ssrc;
+	if (auto jt = mRtxSsrcs.find(rtp->ssrc()); jt != mRtxSsrcs.end())
+		ssrc = jt->second;
+	else if (mStreams.size() == 1)
+		ssrc = mStreams.begin()->first;
+	else
+		return false;
+
+	const size_t headerSize = rtp->getSize() + rtp->getExtensionHeaderSize();
+	if (message->size() < headerSize + sizeof(uint16_t))
+		return false;
+
+	// RTX payload is the original sequence number followed by the original payload
+	auto rtx = reinterpret_cast<RtpRtx *>(rtp);
+	rtp->setSeqNumber(rtx->getOriginalSeqNo());
+	rtp->setSsrc(ssrc);
+	rtp->setPayloadType(it->second);
+	std::memmove(message->data() + headerSize, message->data() + headerSize + sizeof(uint16_t),
+	             message->size() - headerSize - sizeof(uint16_t));
+	message->resize(message->size() - sizeof(uint16_t));
+	return true;
+}
+
+void JitterBufferHandler::push(Stream &stream, message_ptr message, clock::time_point now,
+                               message_vector &out) {
+	auto rtp = reinterpret_cast<const RtpHeader *>(message->data());
+	const uint16_t sequenceNumber = rtp->seqNumber();
+
+	if (!stream.started) {
+		stream.slots.resize(mWindowSize);
+		stream.started = true;
+		reset(stream, sequenceNumber, out);
+	}
+
+	if (int16_t(sequenceNumber - stream.next) < 0) {
+		// A packet from far behind or a run of late packets means the sequence restarted
+		if (uint16_t(stream.next - sequenceNumber) <= mWindowSize &&
+		    ++stream.late < MaxLatePackets) {
+			PLOG_VERBOSE << "Dropping late RTP packet, seq=" << sequenceNumber;
+			return;
+		}
+
+		PLOG_DEBUG << "RTP sequence number jumped backwards, resynchronizing, seq="
+		           << sequenceNumber;
+		reset(stream, sequenceNumber, out);
+
+	} else if (uint16_t(sequenceNumber - stream.next) >= mWindowSize) {
+		// Packets would fall out of the window, release them all and start over
+		PLOG_DEBUG << "RTP sequence number jumped forward, resynchronizing, seq="
+		           << sequenceNumber;
+		reset(stream, sequenceNumber, out);
+	}
+
+	stream.late = 0;
+
+	auto &s = slot(stream, sequenceNumber);
+	if (s.message && s.sequenceNumber == sequenceNumber)
+		return; // duplicate
+
+	s = Slot{};
+	s.message = std::move(message);
+	s.sequenceNumber = sequenceNumber;
+	s.time = now;
+
+	if (int16_t(sequenceNumber - stream.highest) > 0) {
+		for (uint16_t seq = uint16_t(stream.highest + 1); seq != sequenceNumber; ++seq) {
+			auto &gap = slot(stream, seq);
+			gap = Slot{};
+			gap.sequenceNumber = seq;
+			gap.missing = true;
+			gap.time = now;
+		}
+		stream.highest = sequenceNumber;
+	}
+}
+
+void JitterBufferHandler::reset(Stream &stream, uint16_t sequenceNumber, message_vector &out) {
+	// Held packets are released in order, missing ones are given up
+	for (uint16_t seq = stream.next; seq != uint16_t(stream.highest + 1); ++seq) {
+		auto &s = slot(stream, seq);
+		if (s.message && s.sequenceNumber == seq)
+			out.push_back(std::move(s.message));
+	}
+
+	std::fill(stream.slots.begin(), stream.slots.end(), Slot{});
+	stream.next = sequenceNumber;
+	stream.highest = uint16_t(sequenceNumber - 1);
+	stream.late = 0;
+}
+
+void JitterBufferHandler::release(Stream &stream, clock::time_point now, message_vector &out) {
+	if (!stream.started)
+		return;
+
+	while (int16_t(stream.highest - stream.next) >= 0) {
+		auto &s = slot(stream, stream.next);
+		if (s.message && s.sequenceNumber == stream.next) {
+			out.push_back(std::move(s.message));
+		} else if (s.missing && s.sequenceNumber == stream.next && now - s.time < mMaxDelay) {
+			break; // wait for the missing packet
+		} else {
+			PLOG_VERBOSE << "RTP packet lost, seq=" << stream.next;
+		}
+
+		s = Slot{};
+		++stream.next;
+	}
+}
+
+message_ptr JitterBufferHandler::makeNack(SSRC ssrc, Stream &stream, clock::time_point now) {
+	if (!stream.started)
+		return nullptr;
+
+	std::vector<uint16_t> missing;
+	for (uint16_t seq = stream.next; seq != uint16_t(stream.highest + 1); ++seq) {
+		auto &s = slot(stream, seq);
+		if (!s.missing || s.sequenceNumber != seq || s.retries >= MaxNackRetries)
+			continue;
+
+		// Retry once per round-trip time, and don't ask if the answer would come too late
+		if (s.retries > 0 && now - s.nacked < mRoundTripTime)
+			continue;
+
+		if (now + mRoundTripTime - s.time >= mMaxDelay)
+			continue;
+
+		s.nacked = now;
+		++s.retries;
+		missing.push_back(seq);
+	}
+
+	if (missing.empty())
+		return nullptr;
+
+	// Each FCI covers a packet ID and the 16 following ones in its bitmask
+	std::vector<RtcpNackPart> parts;
+	for (uint16_t seq : missing) {
+		if (!parts.empty() && uint16_t(seq - parts.back().pid()) <= 16) {
+			auto &part = parts.back();
+			part.setBlp(uint16_t(part.blp() | (1u << (uint16_t(seq - part.pid()) - 1))));
+		} else {
+			RtcpNackPart part;
+			part.setPid(seq);
+			part.setBlp(0);
+			parts.push_back(part);
+		}
+	}
+
+	auto message = make_message(RtcpNack::Size(unsigned(parts.size())), Message::Control);
+	auto nack = reinterpret_cast<RtcpNack *>(message->data());
+	nack->preparePacket(ssrc, unsigned(parts.size()));
+	std::copy(parts.begin(), parts.end(), nack->parts);
+
+	PLOG_VERBOSE << "Sending NACK for " << missing.size() << " packets, SSRC=" << ssrc;
+	return message;
+}
+
+} // namespace rtc
+
+#endif /* RTC_ENABLE_MEDIA */
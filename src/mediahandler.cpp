@@ -16,7 +16,17 @@ MediaHandler::MediaHandler() {}
 
 MediaHandler::~MediaHandler() {}
 
-void MediaHandler::addToChain(shared_ptr<MediaHandler> handler) { last()->setNext(handler); }
+void MediaHandler::addToChain(shared_ptr<MediaHandler> handler) {
+	// A handler shared by several chains may already be linked, through another shared handler
+	// added before it, so adding it again would link it to itself
+	auto current = shared_from_this();
+	while (current != handler) {
+		if (auto next = current->next())
+			current = std::move(next);
+		else
+			return current->setNext(std::move(handler));
+	}
+}
 
 void MediaHandler::setNext(shared_ptr<MediaHandler> handler) {
 	return std::atomic_store(&mNext, handler);
@@ -56,6 +66,14 @@ bool MediaHandler::requestBitrate(unsigned int bitrate, const message_callback &
 		return false;
 }
 
+optional<unsigned int> MediaHandler::targetBitrate() const {
+	// Default implementation is to call next handler
+	if (auto handler = next())
+		return handler->targetBitrate();
+	else
+		return nullopt;
+}
+
 void MediaHandler::mediaChain(const Description::Media &desc) {
 	media(desc);
 
@@ -13,9 +13,158 @@
 #include "impl/internals.hpp"
 
 #include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define RTC_NAL_SCAN_X86 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RTC_NAL_SCAN_NEON 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
 
 namespace rtc {
 
+namespace {
+
+#ifdef RTC_NAL_SCAN_X86
+inline int CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return int(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Return a pointer to the first 0x00 0x00 0x01 sequence in [begin, end), or end if there is none
+const byte *FindStartSequence(const byte *begin, const byte *end) {
+	auto p = reinterpret_cast<const uint8_t *>(begin);
+	auto last = reinterpret_cast<const uint8_t *>(end);
+
+	// Compare 3 shifted loads at once, a match has zero, zero, and one in the same lane
+#if defined(RTC_NAL_SCAN_X86) && defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi8(1);
+	while (last - p >= 32 + 2) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2));
+		__m256i m = _mm256_and_si256(
+		    _mm256_and_si256(_mm256_cmpeq_epi8(a, zero), _mm256_cmpeq_epi8(b, zero)),
+		    _mm256_cmpeq_epi8(c, one));
+		if (uint32_t mask = uint32_t(_mm256_movemask_epi8(m)))
+			return reinterpret_cast<const byte *>(p + CountTrailingZeros(mask));
+
+		p += 32;
+	}
+#elif defined(RTC_NAL_SCAN_X86)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	while (last - p >= 16 + 2) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2));
+		__m128i m = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)),
+		                          _mm_cmpeq_epi8(c, one));
+		if (uint32_t mask = uint32_t(_mm_movemask_epi8(m)))
+			return reinterpret_cast<const byte *>(p + CountTrailingZeros(mask));
+
+		p += 16;
+	}
+#elif defined(RTC_NAL_SCAN_NEON)
+	const uint8x16_t zero = vdupq_n_u8(0);
+	const uint8x16_t one = vdupq_n_u8(1);
+	while (last - p >= 16 + 2) {
+		uint8x16_t a = vld1q_u8(p);
+		uint8x16_t b = vld1q_u8(p + 1);
+		uint8x16_t c = vld1q_u8(p + 2);
+		uint8x16_t m =
+		    vandq_u8(vandq_u8(vceqq_u8(a, zero), vceqq_u8(b, zero)), vceqq_u8(c, one));
+		uint64x2_t m64 = vreinterpretq_u64_u8(m);
+		if (vgetq_lane_u64(m64, 0) | vgetq_lane_u64(m64, 1))
+			break; // the match is in this block, the scalar search below finds it
+
+		p += 16;
+	}
+#endif
+
+	// memchr is vectorized by the C library, look for 0x01 and check the preceding bytes
+	while (last - p >= 3) {
+		auto q = static_cast<const uint8_t *>(std::memchr(p + 2, 1, size_t(last - p - 2)));
+		if (!q)
+			break;
+
+		if (q[-1] == 0 && q[-2] == 0)
+			return reinterpret_cast<const byte *>(q - 2);
+
+		p = q - 1;
+	}
+	return end;
+}
+
+} // namespace
+
+std::vector<NalUnitView> NalUnit::Split(const binary &data, Separator separator) {
+	std::vector<NalUnitView> result;
+	if (separator == Separator::Length) {
+		size_t index = 0;
+		while (index < data.size()) {
+			if (index + 4 >= data.size()) {
+				PLOG_WARNING << "Invalid NAL Unit data (incomplete length), ignoring!";
+				break;
+			}
+			uint32_t length;
+			std::memcpy(&length, data.data() + index, sizeof(uint32_t));
+			length = ntohl(length);
+			index += 4;
+
+			if (length > data.size() - index) {
+				PLOG_WARNING << "Invalid NAL Unit data (incomplete unit), ignoring!";
+				break;
+			}
+			if (length > 0)
+				result.push_back(NalUnitView{index, length});
+
+			index += length;
+		}
+		return result;
+	}
+
+	const byte *begin = data.data();
+	const byte *end = begin + data.size();
+	const byte *start = FindStartSequence(begin, end);
+	while (start != end) {
+		start += 3;
+		const byte *next = FindStartSequence(start, end);
+
+		// Zero bytes before a start sequence belong to it (long start sequence or trailing zeros)
+		const byte *stop = next;
+		if (next != end)
+			while (stop > start && stop[-1] == byte(0))
+				--stop;
+
+		if (stop > start)
+			result.push_back(NalUnitView{size_t(start - begin), size_t(stop - start)});
+
+		start = next;
+	}
+	return result;
+}
+
 NalUnitFragmentA::NalUnitFragmentA(FragmentType type, bool forbiddenBit, uint8_t nri,
                                    uint8_t unitType, binary data)
     : NalUnit(data.size() + 2) {
@@ -13,58 +13,322 @@
 #include "pacinghandler.hpp"
 
 #include "impl/internals.hpp"
+#include "impl/probepacket.hpp"
 #include "impl/threadpool.hpp"
 
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
 namespace rtc {
 
-PacingHandler::PacingHandler(double bitsPerSecond, std::chrono::milliseconds sendInterval)
-    : mBytesPerSecond(bitsPerSecond / 8), mBudget(0.), mSendInterval(sendInterval){};
+namespace {
 
-void PacingHandler::schedule(const message_callback &send) {
-	if (!mHaveScheduled.exchange(true)) {
-		return;
+const auto DefaultMaxQueueDelay = std::chrono::milliseconds(0); // no limit
+
+} // namespace
+
+PacingHandler::PacingHandler(double bitsPerSecond, std::chrono::microseconds sendInterval)
+    : mBytesPerSecond(bitsPerSecond / 8), mSendInterval(sendInterval),
+      mMaxQueueDelay(DefaultMaxQueueDelay), mLastRun(clock::now()) {
+	if (bitsPerSecond <= 0)
+		throw std::invalid_argument("Pacing bitrate must be positive");
+}
+
+void PacingHandler::setBitrate(double bitsPerSecond) {
+	if (bitsPerSecond <= 0)
+		throw std::invalid_argument("Pacing bitrate must be positive");
+
+	{
+		std::lock_guard lock(mMutex);
+		const auto now = clock::now();
+		process(now); // account for the elapsed time at the previous rate
+		mBytesPerSecond = bitsPerSecond / 8;
+		if (!std::all_of(mQueues.begin(), mQueues.end(), [](const auto &q) { return q.empty(); })) {
+			// The pending wakeup was computed for the previous rate
+			mScheduled.reset();
+			process(now);
+		}
 	}
 
-	impl::ThreadPool::Instance().schedule(mSendInterval, [this, weak_this = weak_from_this(),
-	                                                      send]() {
-		if (auto locked = weak_this.lock()) {
-			const std::lock_guard<std::mutex> lock(mMutex);
-			mHaveScheduled.store(false);
-
-			// Update the budget and cap it
-			auto newBudget =
-			    std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - mLastRun)
-			        .count() *
-			    mBytesPerSecond;
-			auto maxBudget = std::chrono::duration<double>(mSendInterval).count() * mBytesPerSecond;
-			mBudget = std::min(mBudget + newBudget, maxBudget);
-			mLastRun = std::chrono::high_resolution_clock::now();
-
-			// Send packets while there is budget, allow a single partial packet over budget
-			while (!mRtpBuffer.empty() && mBudget > 0) {
-				auto size = int(mRtpBuffer.front()->size());
-				send(std::move(mRtpBuffer.front()));
-				mRtpBuffer.pop();
-				mBudget -= size;
+	flush();
+}
+
+double PacingHandler::bitrate() const {
+	std::lock_guard lock(mMutex);
+	return mBytesPerSecond * 8;
+}
+
+void PacingHandler::setMaxQueueDelay(std::chrono::milliseconds delay) {
+	std::lock_guard lock(mMutex);
+	mMaxQueueDelay = delay;
+}
+
+size_t PacingHandler::queuedBytes() const {
+	std::lock_guard lock(mMutex);
+	return mQueuedBytes;
+}
+
+void PacingHandler::media(const Description::Media &desc) {
+	std::unordered_set<uint8_t> rtxPayloadTypes;
+	for (int pt : desc.payloadTypes())
+		if (auto map = desc.rtpMap(pt); map && (map->format == "rtx" || map->format == "RTX"))
+			rtxPayloadTypes.insert(uint8_t(pt));
+
+	// a=ssrc-group:FID <media SSRC> <RTX SSRC>
+	std::unordered_set<SSRC> rtxSsrcs;
+	for (const auto &attr : desc.attributes()) {
+		if (attr.compare(0, 15, "ssrc-group:FID ") != 0)
+			continue;
+
+		std::istringstream ss(attr.substr(15));
+		SSRC ssrc = 0, rtxSsrc = 0;
+		if (ss >> ssrc >> rtxSsrc)
+			rtxSsrcs.insert(rtxSsrc);
+	}
+
+	const Priority priority = desc.type() == "audio" ? Priority::Audio : Priority::Video;
+
+	// Streams of all media are accumulated as the handler may be shared between tracks
+	std::lock_guard lock(mMutex);
+	mRtxPayloadTypes.insert(rtxPayloadTypes.begin(), rtxPayloadTypes.end());
+	for (SSRC ssrc : desc.getSSRCs())
+		mStreamPriorities.insert_or_assign(
+		    ssrc, rtxSsrcs.find(ssrc) != rtxSsrcs.end() ? Priority::Retransmission : priority);
+}
+
+void PacingHandler::outgoing(message_vector &messages, const message_callback &send) {
+	auto sharedSend = std::make_shared<message_callback>(send);
+
+	{
+		std::lock_guard lock(mMutex);
+		const auto now = clock::now();
+
+		// Control messages and anything which is not RTP go through immediately
+		message_vector result;
+		for (auto &message : messages) {
+			if (message->type == Message::Control || message->size() < sizeof(RtpHeader)) {
+				result.push_back(std::move(message));
+				continue;
 			}
 
-			if (!mRtpBuffer.empty()) {
-				schedule(send);
+			mQueuedBytes += message->size();
+			const Priority priority = classify(message);
+			Entry entry{std::move(message), sharedSend, now};
+			if (auto info = impl::ReadProbeInfo(entry.message->data(), entry.message->size())) {
+				entry.probeCluster = info->cluster;
+				entry.probeBitrate = info->bitrate;
 			}
+			mQueues[size_t(priority)].push_back(std::move(entry));
 		}
-	});
+		messages.swap(result);
+
+		process(now);
+	}
+
+	flush();
 }
 
-void PacingHandler::outgoing(message_vector &messages, const message_callback &send) {
+PacingHandler::Priority PacingHandler::classify(const message_ptr &message) const {
+	auto rtp = reinterpret_cast<const RtpHeader *>(message->data());
+	const size_t headerSize = rtp->getSize() + rtp->getExtensionHeaderSize();
+	if (headerSize >= message->size())
+		return Priority::Video;
+
+	// A padding-only packet carries no payload before the padding
+	const size_t paddingSize = std::to_integer<uint8_t>(message->back());
+	if (rtp->padding() && headerSize + paddingSize == message->size())
+		return Priority::Padding;
 
-	std::lock_guard<std::mutex> lock(mMutex);
+	if (auto it = mStreamPriorities.find(rtp->ssrc()); it != mStreamPriorities.end())
+		return it->second;
 
-	for (auto &m : messages) {
-		mRtpBuffer.push(std::move(m));
+	if (mRtxPayloadTypes.find(rtp->payloadType()) != mRtxPayloadTypes.end())
+		return Priority::Retransmission;
+
+	return Priority::Video;
+}
+
+void PacingHandler::process(clock::time_point now) {
+	// Update the budget and cap it to a burst of sendInterval
+	const double elapsed = std::chrono::duration<double>(now - mLastRun).count();
+	const double maxBudget = std::chrono::duration<double>(mSendInterval).count() * mBytesPerSecond;
+	mBudget = std::min(mBudget + std::max(elapsed, 0.) * mBytesPerSecond, maxBudget);
+	mLastRun = std::max(mLastRun, now);
+
+	dropStale(now);
+
+	// Media is sent by priority while there is budget, allowing a single packet over budget.
+	// Padding is sent only when media queues are empty, except probes which have their own budget.
+	auto &padding = mQueues[size_t(Priority::Padding)];
+	bool hasMedia = false;
+	while (true) {
+		auto it = std::find_if(mQueues.begin(), std::prev(mQueues.end()),
+		                       [](const auto &queue) { return !queue.empty(); });
+		hasMedia = it != std::prev(mQueues.end());
+		if (hasMedia && mBudget >= 0) {
+			mBudget -= double(sendFront(Priority(it - mQueues.begin())));
+			continue;
+		}
+
+		if (padding.empty())
+			break;
+
+		if (padding.front().probeBitrate > 0) {
+			if (sendProbe(now))
+				continue;
+
+		} else if (!hasMedia && mBudget >= 0) {
+			mBudget -= double(sendFront(Priority::Padding));
+			continue;
+		}
+
+		break;
+	}
+
+	// Wake up exactly when the budget becomes positive again
+	optional<clock::duration> delay;
+	if (hasMedia || (!padding.empty() && padding.front().probeBitrate == 0))
+		delay = std::chrono::ceil<std::chrono::microseconds>(
+		    std::chrono::duration<double>(-mBudget / mBytesPerSecond));
+
+	if (!padding.empty() && padding.front().probeBitrate > 0) {
+		const double probeBytesPerSecond = padding.front().probeBitrate / 8.;
+		auto probeDelay = std::chrono::ceil<std::chrono::microseconds>(
+		    std::chrono::duration<double>(-mProbeBudget / probeBytesPerSecond));
+		delay = delay ? std::min(*delay, clock::duration(probeDelay)) : probeDelay;
 	}
-	messages.clear();
 
-	schedule(send);
+	if (delay)
+		schedule(now + *delay);
+}
+
+bool PacingHandler::sendProbe(clock::time_point now) {
+	const auto &entry = mQueues[size_t(Priority::Padding)].front();
+	const double probeBytesPerSecond = entry.probeBitrate / 8.;
+	if (mProbeCluster != entry.probeCluster) {
+		// A new cluster starts immediately
+		mProbeCluster = entry.probeCluster;
+		mProbeBudget = 0;
+	} else {
+		const double elapsed = std::chrono::duration<double>(now - mProbeLastRun).count();
+		const double maxBudget =
+		    std::chrono::duration<double>(mSendInterval).count() * probeBytesPerSecond;
+		mProbeBudget = std::min(mProbeBudget + std::max(elapsed, 0.) * probeBytesPerSecond,
+		                        maxBudget);
+	}
+	mProbeLastRun = std::max(mProbeLastRun, now);
+
+	if (mProbeBudget < 0)
+		return false;
+
+	mProbeBudget -= double(sendFront(Priority::Padding));
+	return true;
+}
+
+size_t PacingHandler::sendFront(Priority priority) {
+	auto &queue = mQueues[size_t(priority)];
+	Entry entry = std::move(queue.front());
+	queue.pop_front();
+
+	const size_t size = entry.message->size();
+	mQueuedBytes -= size;
+	mReleased.push_back(std::move(entry));
+	return size;
+}
+
+void PacingHandler::dropStale(clock::time_point now) {
+	if (mMaxQueueDelay.count() == 0)
+		return;
+
+	// Dropped packets are emptied, so a preceding RtcpNackResponder won't retransmit them
+	const auto limit = now - mMaxQueueDelay;
+	size_t dropped = 0;
+	for (auto priority : {Priority::Retransmission, Priority::Padding}) {
+		auto &queue = mQueues[size_t(priority)];
+		while (!queue.empty() && queue.front().time < limit) {
+			mQueuedBytes -= queue.front().message->size();
+			queue.front().message->clear();
+			queue.pop_front();
+			++dropped;
+		}
+	}
+
+	// For video, drop the remaining packets of frames so the receiver gets whole frames only
+	auto &video = mQueues[size_t(Priority::Video)];
+	if (!video.empty() && video.front().time < limit) {
+		std::unordered_map<SSRC, uint32_t> droppedFrames; // last dropped timestamp by SSRC
+		auto it = std::remove_if(video.begin(), video.end(), [&](const Entry &entry) {
+			auto rtp = reinterpret_cast<const RtpHeader *>(entry.message->data());
+			auto jt = droppedFrames.find(rtp->ssrc());
+			bool inDroppedFrame = jt != droppedFrames.end() && jt->second == rtp->timestamp();
+			if (entry.time >= limit && !inDroppedFrame)
+				return false;
+
+			droppedFrames[rtp->ssrc()] = rtp->timestamp();
+			mQueuedBytes -= entry.message->size();
+			entry.message->clear();
+			++dropped;
+			return true;
+		});
+		video.erase(it, video.end());
+	}
+
+	if (dropped > 0) {
+		PLOG_DEBUG << "Pacing queue delay exceeded, dropped " << dropped << " packets";
+	}
+}
+
+void PacingHandler::flush() {
+	std::unique_lock lock(mMutex);
+	if (mFlushing)
+		return; // the flushing thread will send them, in order
+
+	mFlushing = true;
+	while (!mReleased.empty()) {
+		std::vector<Entry> released;
+		released.swap(mReleased);
+		lock.unlock();
+		for (auto &entry : released)
+			release(std::move(entry));
+
+		lock.lock();
+	}
+	mFlushing = false;
+}
+
+void PacingHandler::release(Entry entry) {
+	try {
+		// Following handlers only see packets when they are actually sent
+		message_vector messages{std::move(entry.message)};
+		if (auto handler = next())
+			handler->outgoingChain(messages, *entry.send);
+
+		for (auto &message : messages)
+			(*entry.send)(std::move(message));
+
+	} catch (const std::exception &e) {
+		PLOG_DEBUG << "Failed to send paced packet: " << e.what();
+	}
+}
+
+void PacingHandler::schedule(clock::time_point time) {
+	if (mScheduled && *mScheduled <= time)
+		return;
+
+	mScheduled = time;
+	impl::ThreadPool::Instance().schedule(time, [weak_this = weak_from_this(), time]() {
+		if (auto locked = std::static_pointer_cast<PacingHandler>(weak_this.lock())) {
+			{
+				std::lock_guard lock(locked->mMutex);
+				if (locked->mScheduled == time)
+					locked->mScheduled.reset();
+
+				locked->process(clock::now());
+			}
+			locked->flush();
+		}
+	});
 }
 
 } // namespace rtc
@@ -372,6 +372,27 @@ optional<std::chrono::milliseconds> PeerConnection::rtt() {
 	return sctpTransport ? sctpTransport->rtt() : nullopt;
 }
 
+PeerConnection::Footprint PeerConnection::footprint() {
+	Footprint result;
+	impl()->iterateDataChannels([&](shared_ptr<impl::DataChannel> channel) {
+		++result.dataChannels;
+		result.availableAmount += channel->availableAmount();
+	});
+	impl()->iterateTracks([&](shared_ptr<impl::Track> track) {
+		++result.tracks;
+		result.availableAmount += track->availableAmount();
+	});
+
+	if (auto sctpTransport = impl()->getSctpTransport()) {
+		result.sctpTransport = true;
+		result.sctpSendBufferSize = sctpTransport->sendBufferSize();
+		result.sctpRecvBufferSize = sctpTransport->recvBufferSize();
+		result.bufferedAmount = sctpTransport->bufferedAmount();
+	}
+
+	return result;
+}
+
 CertificateFingerprint PeerConnection::remoteFingerprint() {
 	return impl()->remoteFingerprint();
 }
@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "router.hpp"
+
+#include "impl/internals.hpp"
+#include "impl/router.hpp"
+
+namespace rtc {
+
+Router::Router(std::chrono::milliseconds keyframeRequestInterval)
+    : CheshireCat<impl::Router>(keyframeRequestInterval) {}
+
+Router::~Router() {
+	try {
+		impl()->clear();
+	} catch (const std::exception &e) {
+		PLOG_ERROR << e.what();
+	}
+}
+
+void Router::addPublisher(shared_ptr<Track> track) { impl()->addPublisher(std::move(track)); }
+
+void Router::removePublisher(shared_ptr<Track> track) { impl()->removePublisher(track); }
+
+void Router::subscribe(shared_ptr<Track> subscriber, shared_ptr<Track> publisher,
+                       optional<SSRC> layer) {
+	impl()->subscribe(std::move(subscriber), std::move(publisher), layer);
+}
+
+void Router::unsubscribe(shared_ptr<Track> subscriber) { impl()->unsubscribe(subscriber); }
+
+void Router::requestKeyframe(shared_ptr<Track> publisher) {
+	impl()->requestKeyframe(publisher.get(), nullopt);
+}
+
+} // namespace rtc
+
+#endif /* RTC_ENABLE_MEDIA */
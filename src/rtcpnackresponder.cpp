@@ -12,13 +12,92 @@
 #include "rtp.hpp"
 
 #include "impl/internals.hpp"
+#include "impl/utils.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
 
 namespace rtc {
 
-RtcpNackResponder::RtcpNackResponder(size_t maxSize)
-    : mStorage(std::make_shared<Storage>(maxSize)) {}
+namespace {
+
+// Middle 32 bits of the current NTP timestamp, as found in report blocks
+uint32_t CompactNtpTime() {
+	using namespace std::chrono;
+	const auto now = duration_cast<microseconds>(system_clock::now().time_since_epoch());
+	// Add the number of seconds between 1900 and 1970
+	const uint64_t secs = uint64_t(now.count() / 1000000) + 2208988800ull;
+	const uint64_t frac = (uint64_t(now.count() % 1000000) << 16) / 1000000;
+	return uint32_t((secs << 16) | frac);
+}
+
+} // namespace
+
+RtcpNackResponder::RtcpNackResponder(size_t maxSize, size_t maxBytes)
+    : mStorage(std::make_shared<Storage>(maxSize, maxBytes)) {}
+
+void RtcpNackResponder::setMaxRetransmissionBitrate(unsigned int bitrate) {
+	std::lock_guard lock(mMutex);
+	mMaxBitrate = bitrate;
+	mBudget = bitrate / 8. * 0.1;
+	mBudgetTime = clock::now();
+}
+
+void RtcpNackResponder::media(const Description::Media &desc) {
+	std::unordered_map<uint8_t, uint8_t> payloadTypes;
+	for (int pt : desc.payloadTypes()) {
+		auto map = desc.rtpMap(pt);
+		if (!map || (map->format != "rtx" && map->format != "RTX"))
+			continue;
+
+		for (const auto &fmtp : map->fmtps) {
+			if (fmtp.compare(0, 4, "apt=") != 0)
+				continue;
+
+			try {
+				payloadTypes.emplace(uint8_t(std::stoi(fmtp.substr(4))), uint8_t(pt));
+			} catch (...) {
+				PLOG_WARNING << "Invalid RTX fmtp: " << fmtp;
+			}
+		}
+	}
+
+	// a=ssrc-group:FID <media SSRC> <RTX SSRC>
+	std::unordered_map<SSRC, SSRC> rtxSsrcs;
+	for (const auto &attr : desc.attributes()) {
+		if (attr.compare(0, 15, "ssrc-group:FID ") != 0)
+			continue;
+
+		std::istringstream ss(attr.substr(15));
+		SSRC ssrc = 0, rtxSsrc = 0;
+		if (ss >> ssrc >> rtxSsrc)
+			rtxSsrcs.emplace(ssrc, rtxSsrc);
+	}
+
+	std::lock_guard lock(mMutex);
+	mRtxPayloadTypes = std::move(payloadTypes);
+	for (auto [ssrc, rtxSsrc] : rtxSsrcs) {
+		if (auto it = mRtxStreams.find(ssrc); it != mRtxStreams.end() && it->second.ssrc == rtxSsrc)
+			continue; // keep the sequence number running
+
+		uint16_t sequenceNumber = 0;
+		std::generate_n(reinterpret_cast<uint8_t *>(&sequenceNumber), sizeof(sequenceNumber),
+		                impl::utils::random_bytes_engine());
+		mRtxStreams.insert_or_assign(ssrc, RtxStream{rtxSsrc, sequenceNumber});
+	}
+
+	if (!mRtxStreams.empty() && !mRtxPayloadTypes.empty()) {
+		PLOG_DEBUG << "RTX enabled for NACK responses";
+	}
+}
 
 void RtcpNackResponder::incoming(message_vector &messages, const message_callback &send) {
 	for (const auto &message : messages) {
@@ -26,32 +105,144 @@ void RtcpNackResponder::incoming(message_vector &messages, const message_callbac
 			continue;
 
 		size_t p = 0;
-		while (p + sizeof(RtcpNack) <= message->size()) {
-			auto nack = reinterpret_cast<RtcpNack *>(message->data() + p);
-			p += nack->header.header.lengthInBytes();
-			if (p > message->size())
+		while (p + sizeof(RtcpHeader) <= message->size()) {
+			auto header = reinterpret_cast<RtcpHeader *>(message->data() + p);
+			size_t length = header->lengthInBytes();
+			if (p + length > message->size())
 				break;
 
-			// check if RTCP is NACK
-			if (nack->header.header.payloadType() != 205 || nack->header.header.reportCount() != 1)
-				continue;
-
-			unsigned int fieldsCount = nack->getSeqNoCount();
-			std::vector<uint16_t> missingSequenceNumbers;
-			for (unsigned int i = 0; i < fieldsCount; i++) {
-				auto field = nack->parts[i];
-				auto newMissingSeqenceNumbers = field.getSequenceNumbers();
-				missingSequenceNumbers.insert(missingSequenceNumbers.end(),
-				                              newMissingSeqenceNumbers.begin(),
-				                              newMissingSeqenceNumbers.end());
+			auto payloadType = header->payloadType();
+			if (payloadType == 200 || payloadType == 201) {
+				// Sender or receiver report, use report blocks to measure the round-trip time
+				bool isSr = payloadType == 200;
+				size_t blocksOffset = isSr ? sizeof(RtcpSr) - sizeof(RtcpReportBlock)
+				                           : sizeof(RtcpRr) - sizeof(RtcpReportBlock);
+				int count = header->reportCount();
+				if (blocksOffset + count * sizeof(RtcpReportBlock) <= length) {
+					for (int i = 0; i < count; ++i) {
+						auto block = isSr ? reinterpret_cast<RtcpSr *>(header)->getReportBlock(i)
+						                  : reinterpret_cast<RtcpRr *>(header)->getReportBlock(i);
+						updateRoundTripTime(block);
+					}
+				}
+			} else if (payloadType == 205 && header->reportCount() == 1 &&
+			           length >= sizeof(RtcpNack)) {
+				auto nack = reinterpret_cast<RtcpNack *>(header);
+				handleNack(nack, length, send);
 			}
 
-			for (auto sequenceNumber : missingSequenceNumbers) {
-				if (auto optPacket = mStorage->get(sequenceNumber))
-					send(make_message(*optPacket.value()));
+			p += length;
+		}
+	}
+}
+
+void RtcpNackResponder::handleNack(RtcpNack *nack, size_t length, const message_callback &send) {
+	const SSRC mediaSsrc = nack->header.mediaSourceSSRC();
+	const unsigned int fieldsCount =
+	    std::min(nack->getSeqNoCount(),
+	             unsigned((length - sizeof(RtcpFbHeader)) / sizeof(RtcpNackPart)));
+
+	const auto now = clock::now();
+	message_vector resent;
+	{
+		std::lock_guard lock(mMutex);
+		// Skip packets which were already resent within one round-trip time
+		const auto rtt = mRoundTripTime.count() > 0
+		                     ? std::chrono::duration_cast<clock::duration>(mRoundTripTime)
+		                     : std::chrono::duration_cast<clock::duration>(DEFAULT_RTT);
+
+		bool exhausted = false;
+		for (unsigned int i = 0; i < fieldsCount && !exhausted; i++) {
+			for (auto sequenceNumber : nack->parts[i].getSequenceNumbers()) {
+				auto optPacket = mStorage->get(sequenceNumber, now - rtt);
+				if (!optPacket)
+					continue;
+
+				const auto &packet = *optPacket;
+				auto rtp = reinterpret_cast<const RtpHeader *>(packet->data());
+				if (mediaSsrc != 0 && rtp->ssrc() != mediaSsrc)
+					continue;
+
+				if (!consumeBudget(packet->size(), now)) {
+					PLOG_VERBOSE << "Retransmission budget exhausted, skipping NACKed packets";
+					exhausted = true;
+					break;
+				}
+
+				mStorage->setResent(sequenceNumber, now);
+				resent.push_back(makeRtxPacket(packet));
 			}
 		}
 	}
+
+	// Retransmissions go through the following outgoing handlers, like pacing and transport-wide
+	// congestion control, as if they were sent by the track
+	if (auto handler = next())
+		handler->outgoingChain(resent, send);
+
+	for (auto &message : resent)
+		send(std::move(message));
+}
+
+void RtcpNackResponder::updateRoundTripTime(const RtcpReportBlock *block) {
+	// RTT = now - LSR - DLSR, in units of 1/65536 seconds (RFC 3550)
+	const uint32_t lastReport = ntohl(block->_lastReport);
+	if (lastReport == 0)
+		return;
+
+	const uint32_t ntp = CompactNtpTime() - lastReport - block->delaySinceSR();
+	if (ntp >= 0x80000000u) // negative
+		return;
+
+	const auto rtt = std::chrono::microseconds((uint64_t(ntp) * 1000000) >> 16);
+
+	std::lock_guard lock(mMutex);
+	if (mRoundTripTime.count() == 0)
+		mRoundTripTime = rtt;
+	else
+		mRoundTripTime = (mRoundTripTime * 7 + rtt) / 8;
+}
+
+bool RtcpNackResponder::consumeBudget(size_t size, clock::time_point now) {
+	if (mMaxBitrate == 0)
+		return true;
+
+	// Token bucket allowing bursts of up to 100ms worth of retransmissions
+	const double rate = mMaxBitrate / 8.;
+	const double capacity = std::max(rate * 0.1, double(DEFAULT_MTU));
+	const double elapsed = std::chrono::duration<double>(now - mBudgetTime).count();
+	mBudget = std::min(mBudget + rate * elapsed, capacity);
+	mBudgetTime = now;
+
+	if (mBudget < double(size))
+		return false;
+
+	mBudget -= double(size);
+	return true;
+}
+
+message_ptr RtcpNackResponder::makeRtxPacket(const binary_ptr &packet) {
+	auto rtp = reinterpret_cast<const RtpHeader *>(packet->data());
+	auto it = mRtxStreams.find(rtp->ssrc());
+	auto jt = mRtxPayloadTypes.find(rtp->payloadType());
+	const size_t headerSize = rtp->getSize() + rtp->getExtensionHeaderSize();
+	if (it == mRtxStreams.end() || jt == mRtxPayloadTypes.end() || headerSize > packet->size())
+		return make_message(*packet); // resend as is on the original stream
+
+	// RTX payload is the original sequence number followed by the original payload (RFC 4588)
+	auto &stream = it->second;
+	auto message = make_message(packet->size() + sizeof(uint16_t));
+	std::memcpy(message->data(), packet->data(), headerSize);
+	uint16_t originalSeqNo = htons(rtp->seqNumber());
+	std::memcpy(message->data() + headerSize, &originalSeqNo, sizeof(uint16_t));
+	std::memcpy(message->data() + headerSize + sizeof(uint16_t), packet->data() + headerSize,
+	            packet->size() - headerSize);
+
+	auto rtx = reinterpret_cast<RtpHeader *>(message->data());
+	rtx->setSsrc(stream.ssrc);
+	rtx->setPayloadType(jt->second);
+	rtx->setSeqNumber(stream.sequenceNumber++);
+	return message;
 }
 
 void RtcpNackResponder::outgoing(message_vector &messages,
@@ -61,22 +252,28 @@ void RtcpNackResponder::outgoing(message_vector &messages,
 			mStorage->store(message);
 }
 
-RtcpNackResponder::Storage::Element::Element(binary_ptr packet, uint16_t sequenceNumber,
-                                             shared_ptr<Element> next)
-    : packet(packet), sequenceNumber(sequenceNumber), next(next) {}
+RtcpNackResponder::Storage::Storage(size_t maxSize, size_t maxBytes)
+    : mSlots(std::clamp(maxSize, size_t(1), size_t(65536))), mMaxBytes(maxBytes) {
+	assert(maxSize > 0);
+}
 
-size_t RtcpNackResponder::Storage::size() { return storage.size(); }
+optional<binary_ptr> RtcpNackResponder::Storage::get(uint16_t sequenceNumber,
+                                                      clock::time_point notBefore) {
+	std::lock_guard lock(mMutex);
+	const auto &slot = mSlots[sequenceNumber % mSlots.size()];
+	// An empty packet was dropped by a following PacingHandler, so it was never sent
+	if (slot.packet && slot.sequenceNumber == sequenceNumber && slot.resent <= notBefore &&
+	    !slot.packet->empty())
+		return slot.packet;
 
-RtcpNackResponder::Storage::Storage(size_t _maxSize) : maxSize(_maxSize) {
-	assert(maxSize > 0);
-	storage.reserve(maxSize);
+	return nullopt;
 }
 
-optional<binary_ptr> RtcpNackResponder::Storage::get(uint16_t sequenceNumber) {
-	std::lock_guard lock(mutex);
-	auto position = storage.find(sequenceNumber);
-	return position != storage.end() ? std::make_optional(storage.at(sequenceNumber)->packet)
-	                                 : nullopt;
+void RtcpNackResponder::Storage::setResent(uint16_t sequenceNumber, clock::time_point time) {
+	std::lock_guard lock(mMutex);
+	auto &slot = mSlots[sequenceNumber % mSlots.size()];
+	if (slot.packet && slot.sequenceNumber == sequenceNumber)
+		slot.resent = time;
 }
 
 void RtcpNackResponder::Storage::store(binary_ptr packet) {
@@ -86,29 +283,48 @@ void RtcpNackResponder::Storage::store(binary_ptr packet) {
 	auto rtp = reinterpret_cast<RtpHeader *>(packet->data());
 	auto sequenceNumber = rtp->seqNumber();
 
-	std::lock_guard lock(mutex);
-	assert((storage.empty() && !oldest && !newest) || (!storage.empty() && oldest && newest));
+	std::lock_guard lock(mMutex);
+
+	// The slot for the sequence number holds at most the packet from one capacity ago
+	auto &slot = mSlots[sequenceNumber % mSlots.size()];
+	evict(slot);
 
-	if (size() == 0) {
-		newest = std::make_shared<Element>(packet, sequenceNumber);
-		oldest = newest;
-	} else {
-		auto current = std::make_shared<Element>(packet, sequenceNumber);
-		newest->next = current;
-		newest = current;
+	mBytes += packet->size();
+	slot.size = packet->size();
+	slot.packet = std::move(packet);
+	slot.sequenceNumber = sequenceNumber;
+	slot.resent = clock::time_point();
+
+	if (mCount++ == 0) {
+		mOldest = mNewest = sequenceNumber;
+	} else if (int16_t(sequenceNumber - mNewest) > 0) {
+		mNewest = sequenceNumber;
+		// Sequence numbers further than the capacity have necessarily been overwritten
+		if (uint16_t(mNewest - mOldest) >= mSlots.size())
+			mOldest = uint16_t(mNewest - mSlots.size() + 1);
+	} else if (int16_t(sequenceNumber - mOldest) < 0) {
+		mOldest = sequenceNumber;
 	}
 
-	storage.emplace(sequenceNumber, newest);
+	// Drop the oldest packets to enforce the byte limit, keeping at least the newest one
+	while (mMaxBytes > 0 && mBytes > mMaxBytes && mOldest != mNewest) {
+		auto &oldest = mSlots[mOldest % mSlots.size()];
+		if (oldest.sequenceNumber == mOldest)
+			evict(oldest);
 
-	if (size() > maxSize) {
-		assert(oldest);
-		if (oldest) {
-			storage.erase(oldest->sequenceNumber);
-			oldest = oldest->next;
-		}
+		++mOldest;
 	}
 }
 
+void RtcpNackResponder::Storage::evict(Slot &slot) {
+	if (!slot.packet)
+		return;
+
+	mBytes -= slot.size;
+	--mCount;
+	slot.packet.reset();
+}
+
 } // namespace rtc
 
 #endif /* RTC_ENABLE_MEDIA */
@@ -10,7 +10,7 @@
 
 #include "rtcpsrreporter.hpp"
 
-#include <cassert>
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 
@@ -45,8 +45,14 @@ void RtcpSrReporter::outgoing(message_vector &messages, const message_callback &
 		if (message->size() < sizeof(RtpHeader))
 			continue;
 
+		// The octet count excludes padding (RFC 3550), which is sent with bandwidth probes
 		auto rtp = reinterpret_cast<RtpHeader *>(message->data());
-		addToReport(rtp, uint32_t(message->size()));
+		size_t size = message->size();
+		if (rtp->padding())
+			size -= std::min(size_t(std::to_integer<uint8_t>(message->back())),
+			                 size - std::min(size, rtp->getSize()));
+
+		addToReport(rtp, uint32_t(size));
 	}
 
 	if (std::exchange(mNeedsToReport, false)) {
@@ -58,8 +64,7 @@ void RtcpSrReporter::outgoing(message_vector &messages, const message_callback &
 
 void RtcpSrReporter::addToReport(RtpHeader *rtp, uint32_t rtpSize) {
 	mPacketCount += 1;
-	assert(!rtp->padding());
-	mPayloadOctets += rtpSize - uint32_t(rtp->getSize());
+	mPayloadOctets += rtpSize - std::min(rtpSize, uint32_t(rtp->getSize()));
 }
 
 message_ptr RtcpSrReporter::getSenderReport(uint32_t timestamp) {
@@ -10,107 +10,194 @@
 
 #include "rtppacketizer.hpp"
 
+#include "impl/internals.hpp"
+#include "impl/rtpextension.hpp"
+
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
 namespace rtc {
 
-RtpPacketizer::RtpPacketizer(shared_ptr<RtpPacketizationConfig> rtpConfig) : rtpConfig(rtpConfig) {}
+// Header built once from the configuration, packets only patch sequence number, timestamp,
+// marker, and per-packet extension values
+struct RtpPacketizer::HeaderTemplate {
+	// Configuration values the template depends on
+	struct Params {
+		SSRC ssrc;
+		uint8_t payloadType;
+		uint8_t videoOrientationId;
+		uint8_t videoOrientation;
+		uint8_t midId;
+		optional<string> mid;
+		uint8_t ridId;
+		optional<string> rid;
+		uint8_t playoutDelayId;
+		uint16_t playoutDelayMin;
+		uint16_t playoutDelayMax;
+		uint8_t absSendTimeId;
+		uint8_t transportCcId;
+
+		Params(const RtpPacketizationConfig &config)
+		    : ssrc(config.ssrc), payloadType(config.payloadType),
+		      videoOrientationId(config.videoOrientationId),
+		      videoOrientation(config.videoOrientation), midId(config.midId), mid(config.mid),
+		      ridId(config.ridId), rid(config.rid), playoutDelayId(config.playoutDelayId),
+		      playoutDelayMin(config.playoutDelayMin), playoutDelayMax(config.playoutDelayMax),
+		      absSendTimeId(config.absSendTimeId), transportCcId(config.transportCcId) {}
+
+		bool matches(const RtpPacketizationConfig &config) const {
+			return ssrc == config.ssrc && payloadType == config.payloadType &&
+			       videoOrientationId == config.videoOrientationId &&
+			       videoOrientation == config.videoOrientation && midId == config.midId &&
+			       mid == config.mid && ridId == config.ridId && rid == config.rid &&
+			       playoutDelayId == config.playoutDelayId &&
+			       playoutDelayMin == config.playoutDelayMin &&
+			       playoutDelayMax == config.playoutDelayMax &&
+			       absSendTimeId == config.absSendTimeId && transportCcId == config.transportCcId;
+		}
+	};
 
-RtpPacketizer::~RtpPacketizer() {}
+	struct Header {
+		binary data;
+		size_t absSendTimeOffset = 0; // 0 if absent
+	};
 
-message_ptr RtpPacketizer::packetize(shared_ptr<binary> payload, bool mark) {
-	size_t rtpExtHeaderSize = 0;
+	HeaderTemplate(const RtpPacketizationConfig &config);
+
+	Params params;
+	Header headers[2]; // without and with marker, only the latter has the video orientation
+};
+
+RtpPacketizer::HeaderTemplate::HeaderTemplate(const RtpPacketizationConfig &config)
+    : params(config) {
+	for (int mark = 0; mark < 2; ++mark) {
+		auto &header = headers[mark];
 
-	const bool setVideoRotation = (rtpConfig->videoOrientationId != 0) &&
-	                              (rtpConfig->videoOrientationId <
-	                               15) && // needs fixing if longer extension headers are supported
-	                              mark &&
-	                              (rtpConfig->videoOrientation != 0);
+		struct Element {
+			uint8_t id;
+			binary value;
+			size_t *offset = nullptr; // set to the value offset in the header
+		};
+		std::vector<Element> elements;
 
-	if (setVideoRotation)
-		rtpExtHeaderSize += 2;
+		auto fromString = [](const string &str) {
+			auto begin = reinterpret_cast<const byte *>(str.data());
+			return binary(begin, begin + str.size());
+		};
 
-	const bool setPlayoutDelay = (rtpConfig->playoutDelayId > 0 && rtpConfig->playoutDelayId < 15);
+		if (params.videoOrientationId != 0 && mark && params.videoOrientation != 0)
+			elements.push_back({params.videoOrientationId, {byte(params.videoOrientation)}});
 
-	if (setPlayoutDelay)
-		rtpExtHeaderSize += 4;
+		if (params.midId != 0 && params.mid)
+			elements.push_back({params.midId, fromString(*params.mid)});
 
-	if (rtpConfig->mid.has_value())
-		rtpExtHeaderSize += (1 + rtpConfig->mid->length());
+		if (params.ridId != 0 && params.rid)
+			elements.push_back({params.ridId, fromString(*params.rid)});
 
-	if (rtpConfig->rid.has_value())
-		rtpExtHeaderSize += (1 + rtpConfig->rid->length());
+		if (params.playoutDelayId != 0) {
+			// 12 bits for min + 12 bits for max
+			uint16_t min = params.playoutDelayMin & 0xFFF;
+			uint16_t max = params.playoutDelayMax & 0xFFF;
+			elements.push_back({params.playoutDelayId,
+			                    {byte((min >> 4) & 0xFF), byte(((min & 0xF) << 4) | (max >> 8)),
+			                     byte(max & 0xFF)}});
+		}
 
-	if (rtpExtHeaderSize != 0)
-		rtpExtHeaderSize += 4;
+		if (params.absSendTimeId != 0)
+			elements.push_back({params.absSendTimeId, binary(3), &header.absSendTimeOffset});
 
-	rtpExtHeaderSize = (rtpExtHeaderSize + 3) & ~3;
+		// The transport-wide sequence number is only reserved, TransportCcSender writes it
+		if (params.transportCcId != 0)
+			elements.push_back({params.transportCcId, binary(2)});
 
-	auto message = make_message(RtpHeaderSize + rtpExtHeaderSize + payload->size());
-	auto *rtp = (RtpHeader *)message->data();
-	rtp->setPayloadType(rtpConfig->payloadType);
-	rtp->setSeqNumber(rtpConfig->sequenceNumber++); // increase sequence number
-	rtp->setTimestamp(rtpConfig->timestamp);
-	rtp->setSsrc(rtpConfig->ssrc);
+		for (auto it = elements.begin(); it != elements.end();) {
+			if (it->value.size() > 255) {
+				PLOG_WARNING << "RTP header extension value too long, id=" << int(it->id);
+				it = elements.erase(it);
+			} else {
+				++it;
+			}
+		}
 
-	if (mark) {
-		rtp->setMarker(true);
-	}
+		// IDs above 14 and empty or long values require two-byte headers (RFC 8285)
+		const bool twoByte =
+		    std::any_of(elements.begin(), elements.end(), [](const Element &element) {
+			    return element.id > 14 || element.value.empty() || element.value.size() > 16;
+		    });
+
+		auto &data = header.data;
+		data.resize(RtpHeaderSize);
+		if (!elements.empty()) {
+			const size_t extStart = data.size();
+			data.resize(extStart + sizeof(RtpExtensionHeader));
+			for (auto &element : elements) {
+				if (twoByte) {
+					data.push_back(byte(element.id));
+					data.push_back(byte(element.value.size()));
+				} else {
+					data.push_back(byte((element.id << 4) | (element.value.size() - 1)));
+				}
+				if (element.offset)
+					*element.offset = data.size();
+
+				data.insert(data.end(), element.value.begin(), element.value.end());
+			}
+			data.resize((data.size() + 3) & ~size_t(3)); // padding
+
+			auto extHeader = reinterpret_cast<RtpExtensionHeader *>(data.data() + extStart);
+			extHeader->setProfileSpecificId(twoByte ? 0x1000 : 0xBEDE);
+			extHeader->setHeaderLength(
+			    uint16_t((data.size() - extStart - sizeof(RtpExtensionHeader)) / 4));
+		}
 
-	if (rtpExtHeaderSize) {
-		rtp->setExtension(true);
+		auto rtp = reinterpret_cast<RtpHeader *>(data.data());
+		rtp->preparePacket();
+		rtp->setExtension(!elements.empty());
+		rtp->setPayloadType(params.payloadType);
+		rtp->setSsrc(params.ssrc);
+		rtp->setMarker(mark);
+	}
+}
 
-		auto extHeader = rtp->getExtensionHeader();
-		extHeader->setProfileSpecificId(0xbede);
+RtpPacketizer::RtpPacketizer(shared_ptr<RtpPacketizationConfig> rtpConfig) : rtpConfig(rtpConfig) {}
 
-		auto headerLength = static_cast<uint16_t>(rtpExtHeaderSize / 4) - 1;
+RtpPacketizer::~RtpPacketizer() {}
 
-		extHeader->setHeaderLength(headerLength);
-		extHeader->clearBody();
+message_ptr RtpPacketizer::packetize(shared_ptr<binary> payload, bool mark) {
+	return packetize(nullptr, 0, payload->data(), payload->size(), mark);
+}
 
-		size_t offset = 0;
-		if (setVideoRotation) {
-			extHeader->writeCurrentVideoOrientation(offset, rtpConfig->videoOrientationId,
-			                                        rtpConfig->videoOrientation);
-			offset += 2;
-		}
+message_ptr RtpPacketizer::packetize(const byte *prefix, size_t prefixSize, const byte *data,
+                                     size_t size, bool mark) {
+	// The configuration is public, so check it did not change since the template was built
+	if (!mHeaderTemplate || !mHeaderTemplate->params.matches(*rtpConfig))
+		mHeaderTemplate = std::make_unique<HeaderTemplate>(*rtpConfig);
 
-		if (rtpConfig->mid.has_value()) {
-			extHeader->writeOneByteHeader(
-			    offset, rtpConfig->midId,
-			    reinterpret_cast<const std::byte *>(rtpConfig->mid->c_str()),
-			    rtpConfig->mid->length());
-			offset += (1 + rtpConfig->mid->length());
-		}
+	const auto &header = mHeaderTemplate->headers[mark ? 1 : 0];
+	const size_t headerSize = header.data.size();
 
-		if (rtpConfig->rid.has_value()) {
-			extHeader->writeOneByteHeader(
-			    offset, rtpConfig->ridId,
-			    reinterpret_cast<const std::byte *>(rtpConfig->rid->c_str()),
-			    rtpConfig->rid->length());
-		}
+	auto message = make_message(headerSize + prefixSize + size);
+	std::memcpy(message->data(), header.data.data(), headerSize);
 
-		if (setPlayoutDelay) {
-			uint16_t min = rtpConfig->playoutDelayMin & 0xFFF;
-			uint16_t max = rtpConfig->playoutDelayMax & 0xFFF;
+	auto *rtp = reinterpret_cast<RtpHeader *>(message->data());
+	rtp->setSeqNumber(rtpConfig->sequenceNumber++); // increase sequence number
+	rtp->setTimestamp(rtpConfig->timestamp);
 
-			// 12 bits for min + 12 bits for max
-			byte data[] = {
-				byte((min >> 4) & 0xFF), 
-				byte(((min & 0xF) << 4) | ((max >> 8) & 0xF)),
-				byte(max & 0xFF)
-			};
-
-			extHeader->writeOneByteHeader(offset, rtpConfig->playoutDelayId, data, 3);
-			offset += 4;
-		}
+	// The send time is updated by TransportCcSender, if any, when the packet is actually sent
+	if (header.absSendTimeOffset) {
+		uint32_t absSendTime = impl::AbsSendTime();
+		byte *value = message->data() + header.absSendTimeOffset;
+		value[0] = byte((absSendTime >> 16) & 0xFF);
+		value[1] = byte((absSendTime >> 8) & 0xFF);
+		value[2] = byte(absSendTime & 0xFF);
 	}
 
-	rtp->preparePacket();
-
-	std::memcpy(message->data() + RtpHeaderSize + rtpExtHeaderSize, payload->data(),
-	            payload->size());
+	byte *payload = message->data() + headerSize;
+	if (prefixSize > 0)
+		std::memcpy(payload, prefix, prefixSize);
+	if (size > 0 && data)
+		std::memcpy(payload + prefixSize, data, size);
 
 	return message;
 }
@@ -121,7 +208,7 @@ void RtpPacketizer::outgoing([[maybe_unused]] message_vector &messages,
                              [[maybe_unused]] const message_callback &send) {
 	// Default implementation
 	for (auto &message : messages)
-		message = packetize(message, false);
+		message = packetize(nullptr, 0, message->data(), message->size(), false);
 }
 
 } // namespace rtc
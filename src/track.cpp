@@ -13,10 +13,28 @@
 
 namespace rtc {
 
+void Track::Fanout(const std::vector<shared_ptr<Track>> &tracks, message_variant data) {
+	std::vector<impl_ptr<impl::Track>> impls;
+	impls.reserve(tracks.size());
+	for (const auto &track : tracks)
+		if (track)
+			impls.push_back(track->impl());
+
+	impl::Track::Fanout(std::move(impls), make_message(std::move(data)));
+}
+
 Track::Track(impl_ptr<impl::Track> impl)
-    : CheshireCat<impl::Track>(impl), Channel(std::dynamic_pointer_cast<impl::Channel>(impl)) {}
+    : CheshireCat<impl::Track>(impl), Channel(std::dynamic_pointer_cast<impl::Channel>(impl)) {
+	impl->addHandle();
+}
 
-Track::~Track() {}
+Track::~Track() {
+	try {
+		impl()->releaseHandle();
+	} catch (const std::exception &e) {
+		PLOG_ERROR << e.what();
+	}
+}
 
 string Track::mid() const { return impl()->mid(); }
 
@@ -68,6 +86,10 @@ bool Track::requestBitrate(unsigned int bitrate) {
 	return false;
 }
 
+void Track::onTargetBitrate(std::function<void(unsigned int bitrate)> callback) {
+	impl()->onTargetBitrate(callback);
+}
+
 shared_ptr<MediaHandler> Track::getMediaHandler() { return impl()->getMediaHandler(); }
 
 void Track::onFrame(std::function<void(binary data, FrameInfo frame)> callback) {
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "transportccreceiver.hpp"
+
+#include "impl/internals.hpp"
+#include "impl/rtpextension.hpp"
+#include "impl/transportccfeedback.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace rtc {
+
+namespace {
+
+// Sequence numbers further than this after the last reported one restart the reporting
+const int64_t MaxGap = 8192;
+
+} // namespace
+
+TransportCcReceiver::TransportCcReceiver(std::chrono::milliseconds feedbackInterval)
+    : mFeedbackInterval(feedbackInterval), mStartTime(clock::now()) {}
+
+void TransportCcReceiver::media(const Description::Media &desc) {
+	std::lock_guard lock(mMutex);
+	mExtId = impl::FindExtMapId(desc, impl::TransportWideCcExtUri);
+}
+
+void TransportCcReceiver::incoming(message_vector &messages, const message_callback &send) {
+	const auto now = clock::now();
+	message_vector feedbacks;
+	{
+		std::lock_guard lock(mMutex);
+		if (mExtId == 0)
+			return;
+
+		for (const auto &message : messages) {
+			if (message->type == Message::Control || message->size() < sizeof(RtpHeader))
+				continue;
+
+			auto found = impl::FindRtpExtension(message->data(), message->size(), mExtId);
+			if (!found || found->second != 2)
+				continue;
+
+			auto value = reinterpret_cast<const uint8_t *>(message->data() + found->first);
+			const uint16_t sequenceNumber = uint16_t((value[0] << 8) | value[1]);
+
+			int64_t unwrapped = sequenceNumber;
+			if (mLastSequenceNumber) {
+				unwrapped = *mLastSequenceNumber +
+				            int16_t(sequenceNumber - uint16_t(*mLastSequenceNumber & 0xFFFF));
+				mLastSequenceNumber = std::max(*mLastSequenceNumber, unwrapped);
+			} else {
+				mLastSequenceNumber = unwrapped;
+			}
+
+			if (mNextSequenceNumber && unwrapped < *mNextSequenceNumber)
+				continue; // already reported
+
+			using std::chrono::duration_cast;
+			using std::chrono::microseconds;
+			mArrivals.emplace(unwrapped, duration_cast<microseconds>(now - mStartTime));
+			mMediaSsrc = reinterpret_cast<const RtpHeader *>(message->data())->ssrc();
+		}
+
+		if (!mArrivals.empty() && now - mLastFeedback >= mFeedbackInterval) {
+			mLastFeedback = now;
+			while (!mArrivals.empty())
+				feedbacks.push_back(makeFeedback());
+		}
+	}
+
+	for (auto &feedback : feedbacks)
+		send(std::move(feedback));
+}
+
+message_ptr TransportCcReceiver::makeFeedback() {
+	const int64_t first = mArrivals.begin()->first;
+	if (!mNextSequenceNumber || first - *mNextSequenceNumber > MaxGap)
+		mNextSequenceNumber = first;
+
+	const int64_t base = *mNextSequenceNumber;
+	const int64_t last = mArrivals.rbegin()->first;
+
+	// The reference time is in multiples of 64ms, receive deltas in multiples of 250us
+	const int64_t reference = mArrivals.begin()->second.count() / 64000;
+	int64_t previous = reference * 64000;
+
+	impl::TransportCcFeedback feedback;
+	feedback.baseSequenceNumber = uint16_t(base & 0xFFFF);
+	feedback.referenceTime = reference;
+	feedback.feedbackCount = mFeedbackCount++;
+
+	int64_t sequenceNumber = base;
+	auto it = mArrivals.begin();
+	while (sequenceNumber <= last && feedback.arrivals.size() < MaxPacketsPerFeedback) {
+		if (it == mArrivals.end() || it->first != sequenceNumber) {
+			feedback.arrivals.push_back(nullopt);
+			++sequenceNumber;
+			continue;
+		}
+
+		const int64_t delta = (it->second.count() - previous) / 250;
+		if (delta < -0x8000 || delta > 0x7FFF)
+			break; // the next feedback will have a new reference time
+
+		previous += delta * 250;
+		feedback.arrivals.push_back(std::chrono::microseconds(previous));
+		++sequenceNumber;
+		++it;
+	}
+
+	mArrivals.erase(mArrivals.begin(), it);
+	mNextSequenceNumber = sequenceNumber;
+
+	return impl::MakeTransportCcFeedback(mMediaSsrc, feedback);
+}
+
+} // namespace rtc
+
+#endif /* RTC_ENABLE_MEDIA */
@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "transportccsender.hpp"
+
+#include "impl/bandwidthestimator.hpp"
+#include "impl/internals.hpp"
+#include "impl/probepacket.hpp"
+#include "impl/rtpextension.hpp"
+#include "impl/transportccfeedback.hpp"
+
+namespace rtc {
+
+TransportCcSender::TransportCcSender(unsigned int initialBitrate, unsigned int minBitrate,
+                                     unsigned int maxBitrate)
+    : mHistory(HistorySize), mEstimator(std::make_unique<impl::BandwidthEstimator>(
+                                 initialBitrate, minBitrate, maxBitrate)) {
+	mLastTargetBitrate = mEstimator->targetBitrate();
+}
+
+TransportCcSender::~TransportCcSender() {}
+
+void TransportCcSender::onTargetBitrate(std::function<void(unsigned int bitrate)> callback) {
+	mTargetBitrateCallback = callback;
+}
+
+void TransportCcSender::onProbeResult(std::function<void(unsigned int bitrate)> callback) {
+	mProbeResultCallback = callback;
+}
+
+optional<unsigned int> TransportCcSender::targetBitrate() const {
+	std::lock_guard lock(mMutex);
+	return mEstimator->targetBitrate();
+}
+
+void TransportCcSender::media(const Description::Media &desc) {
+	std::lock_guard lock(mMutex);
+	mExtId = impl::FindExtMapId(desc, impl::TransportWideCcExtUri);
+	mAbsSendTimeExtId = impl::FindExtMapId(desc, impl::AbsSendTimeExtUri);
+}
+
+void TransportCcSender::outgoing(message_vector &messages, const message_callback &) {
+	std::lock_guard lock(mMutex);
+	if (mExtId == 0 && mAbsSendTimeExtId == 0)
+		return;
+
+	const auto now = clock::now();
+	for (auto &message : messages) {
+		if (message->type == Message::Control || message->size() < sizeof(RtpHeader))
+			continue;
+
+		// The packetizer reserves abs-send-time, it is set here as packets are actually sent
+		if (mAbsSendTimeExtId != 0)
+			stampAbsSendTime(message);
+
+		if (mExtId == 0)
+			continue;
+
+		const uint16_t sequenceNumber = mSequenceNumber;
+		if (!stamp(message, sequenceNumber))
+			continue;
+
+		++mSequenceNumber;
+		auto &sent = mHistory[sequenceNumber % mHistory.size()];
+		sent.time = now;
+		sent.size = message->size();
+		sent.sequenceNumber = sequenceNumber;
+		sent.valid = true;
+		if (auto info = impl::ReadProbeInfo(message->data(), message->size()))
+			sent.probeCluster = info->cluster;
+		else
+			sent.probeCluster.reset();
+	}
+}
+
+void TransportCcSender::stampAbsSendTime(message_ptr &message) {
+	auto found = impl::FindRtpExtension(message->data(), message->size(), mAbsSendTimeExtId);
+	if (!found || found->second != 3)
+		return;
+
+	const uint32_t absSendTime = impl::AbsSendTime();
+	byte *value = message->data() + found->first;
+	value[0] = byte((absSendTime >> 16) & 0xFF);
+	value[1] = byte((absSendTime >> 8) & 0xFF);
+	value[2] = byte(absSendTime & 0xFF);
+}
+
+bool TransportCcSender::stamp(message_ptr &message, uint16_t sequenceNumber) {
+	const byte value[2] = {byte(sequenceNumber >> 8), byte(sequenceNumber & 0xFF)};
+	if (auto found = impl::FindRtpExtension(message->data(), message->size(), mExtId)) {
+		if (found->second != sizeof(value))
+			return false;
+
+		std::memcpy(message->data() + found->first, value, sizeof(value));
+		return true;
+	}
+
+	// There is no room for an element in an existing extension block, so only packets without
+	// extensions get one
+	auto rtp = reinterpret_cast<RtpHeader *>(message->data());
+	if (rtp->extension() || message->size() < rtp->getSize()) {
+		PLOG_VERBOSE << "Unable to add transport-wide sequence number, seq=" << rtp->seqNumber();
+		return false;
+	}
+
+	const bool twoByte = mExtId > 14;
+	const size_t offset = rtp->getSize();
+	binary extension(sizeof(RtpExtensionHeader) + 4, byte(0));
+	size_t i = sizeof(RtpExtensionHeader);
+	if (twoByte) {
+		extension[i++] = byte(mExtId);
+		extension[i++] = byte(sizeof(value));
+	} else {
+		extension[i++] = byte((mExtId << 4) | (sizeof(value) - 1));
+	}
+	std::memcpy(extension.data() + i, value, sizeof(value));
+
+	auto header = reinterpret_cast<RtpExtensionHeader *>(extension.data());
+	header->setProfileSpecificId(twoByte ? 0x1000 : 0xBEDE);
+	header->setHeaderLength(1);
+
+	// Other handlers, like RtcpNackResponder, may hold the message for retransmission, so it must
+	// not be grown in place: the stored packet would change under them
+	auto stamped = make_message(message->size() + extension.size(), message);
+	std::copy(extension.begin(), extension.end(), stamped->begin() + offset);
+	std::copy(message->begin() + offset, message->end(),
+	          stamped->begin() + offset + extension.size());
+	reinterpret_cast<RtpHeader *>(stamped->data())->setExtension(true);
+	message = std::move(stamped);
+	return true;
+}
+
+void TransportCcSender::incoming(message_vector &messages, const message_callback &) {
+	const auto now = clock::now();
+	optional<unsigned int> changed, probeResult;
+	{
+		std::lock_guard lock(mMutex);
+		for (const auto &message : messages) {
+			if (message->type != Message::Control)
+				continue;
+
+			size_t offset = 0;
+			while (offset + sizeof(RtcpHeader) <= message->size()) {
+				auto header = reinterpret_cast<const RtcpHeader *>(message->data() + offset);
+				const size_t length = header->lengthInBytes();
+				if (length > message->size() - offset)
+					break;
+
+				if (header->payloadType() == 205 && header->reportCount() == 15)
+					processFeedback(reinterpret_cast<const uint8_t *>(header), length, now);
+
+				offset += length;
+			}
+		}
+
+		probeResult = mEstimator->fetchProbeResult();
+
+		const unsigned int bitrate = mEstimator->targetBitrate();
+		if (bitrate != mLastTargetBitrate) {
+			mLastTargetBitrate = bitrate;
+			changed = bitrate;
+		}
+	}
+
+	if (probeResult)
+		mProbeResultCallback(*probeResult);
+
+	if (changed)
+		mTargetBitrateCallback(*changed);
+}
+
+void TransportCcSender::processFeedback(const uint8_t *data, size_t size, clock::time_point now) {
+	auto feedback = impl::ParseTransportCcFeedback(reinterpret_cast<const byte *>(data), size);
+	if (!feedback)
+		return;
+
+	// Ignore duplicated or reordered feedback
+	if (mLastFeedbackCount && int8_t(feedback->feedbackCount - *mLastFeedbackCount) <= 0)
+		return;
+
+	mLastFeedbackCount = feedback->feedbackCount;
+
+	std::vector<impl::BandwidthEstimator::PacketResult> results;
+	results.reserve(feedback->arrivals.size());
+	optional<clock::time_point> lastReceivedSendTime;
+	for (size_t i = 0; i < feedback->arrivals.size(); ++i) {
+		const uint16_t sequenceNumber = uint16_t(feedback->baseSequenceNumber + i);
+		const auto &sent = mHistory[sequenceNumber % mHistory.size()];
+		if (!sent.valid || sent.sequenceNumber != sequenceNumber)
+			continue;
+
+		const auto &arrival = feedback->arrivals[i];
+		results.push_back({sent.time, sent.size, arrival.has_value(),
+		                   arrival.value_or(std::chrono::microseconds::zero()), sent.probeCluster});
+		if (arrival)
+			lastReceivedSendTime = sent.time;
+	}
+
+	if (results.empty())
+		return;
+
+	// The feedback delay is included, which is fine as the estimator needs the response time
+	if (lastReceivedSendTime)
+		mEstimator->setRoundTripTime(
+		    std::chrono::duration_cast<std::chrono::milliseconds>(now - *lastReceivedSendTime));
+
+	mEstimator->onFeedback(results, now);
+}
+
+} // namespace rtc
+
+#endif /* RTC_ENABLE_MEDIA */
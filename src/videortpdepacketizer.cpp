@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if RTC_ENABLE_MEDIA
+
+#include "videortpdepacketizer.hpp"
+
+#include "impl/frameassembler.hpp"
+#include "impl/internals.hpp"
+
+#include <algorithm>
+
+namespace rtc {
+
+namespace {
+
+// Pending frames are flushed beyond this count even if they are incomplete
+const size_t maxPendingFrames = 8;
+
+// Late packets beyond this count in a row, or a larger backward timestamp jump, are assumed to
+// come from a restarted stream, for instance on sender restart or source switch
+const size_t maxLatePackets = 16;
+const uint32_t maxTimestampJump = 90000 * 10; // 10s at 90kHz
+
+} // namespace
+
+VideoRtpDepacketizer::VideoRtpDepacketizer(Output output) : mOutput(output) {}
+
+std::pair<size_t, size_t> VideoRtpDepacketizer::GetPayload(const message_ptr &packet) {
+	auto rtp = reinterpret_cast<const RtpHeader *>(packet->data());
+	size_t begin = rtp->getSize() + rtp->getExtensionHeaderSize();
+	size_t end = packet->size();
+	if (rtp->padding() && end > begin)
+		end -= std::min(size_t(std::to_integer<uint8_t>(packet->at(end - 1))), end - begin);
+
+	return {std::min(begin, end), end};
+}
+
+void VideoRtpDepacketizer::incoming(message_vector &messages, const message_callback &) {
+	message_vector result;
+	for (auto &message : messages) {
+		if (message->type == Message::Control) {
+			result.push_back(std::move(message));
+			continue;
+		}
+
+		if (message->size() < sizeof(RtpHeader) ||
+		    message->size() < reinterpret_cast<const RtpHeader *>(message->data())->getSize()) {
+			PLOG_VERBOSE << "RTP packet is too small, size=" << message->size();
+			continue;
+		}
+
+		auto rtp = reinterpret_cast<const RtpHeader *>(message->data());
+		if (rtp->marker())
+			mMarkerSeen = true;
+
+		push(std::move(message));
+	}
+
+	// Frames are delivered in order. An incomplete frame is held until it completes, or until a
+	// newer frame is complete. If the sender does not set the marker bit, a frame is considered
+	// complete as soon as a newer one starts.
+	while (!mFrames.empty()) {
+		const auto &frame = mFrames.front();
+		if (!isComplete(frame) && mFrames.size() <= maxPendingFrames) {
+			bool newerComplete = mFrames.size() > 1 && (!mMarkerSeen || mFrames[1].marker);
+			if (!newerComplete)
+				break;
+		}
+
+		auto rtp = reinterpret_cast<const RtpHeader *>(frame.packets.back()->data());
+		mLastTimestamp = frame.timestamp;
+		mLastSequenceNumber = rtp->seqNumber();
+
+		// Pop first so a malformed frame can't block the ones after it
+		Frame current = std::move(mFrames.front());
+		mFrames.pop_front();
+
+		try {
+			if (auto accessUnit = buildFrame(current))
+				result.push_back(std::move(accessUnit));
+		} catch (const std::exception &e) {
+			PLOG_WARNING << "Dropping malformed frame, timestamp=" << current.timestamp << ": "
+			             << e.what();
+		}
+	}
+
+	messages.swap(result);
+}
+
+void VideoRtpDepacketizer::push(message_ptr packet) {
+	auto rtp = reinterpret_cast<const RtpHeader *>(packet->data());
+	const uint32_t timestamp = rtp->timestamp();
+	const uint16_t sequenceNumber = rtp->seqNumber();
+
+	if (mLastTimestamp && int32_t(timestamp - *mLastTimestamp) <= 0) {
+		// Padding following a delivered frame, like bandwidth probes, keeps the sequence contiguous
+		if (timestamp == *mLastTimestamp && mLastSequenceNumber &&
+		    sequenceNumber == uint16_t(*mLastSequenceNumber + 1)) {
+			mLastSequenceNumber = sequenceNumber;
+			return;
+		}
+
+		if (++mLatePackets < maxLatePackets && *mLastTimestamp - timestamp <= maxTimestampJump) {
+			PLOG_VERBOSE << "Dropping late RTP packet, seq=" << sequenceNumber;
+			return;
+		}
+
+		PLOG_DEBUG << "RTP timestamp jumped backward, resynchronizing";
+		mFrames.clear();
+		mLastTimestamp.reset();
+		mLastSequenceNumber.reset();
+	}
+	mLatePackets = 0;
+
+	// Find the frame, searching from the newest as packets are mostly in order
+	auto it = mFrames.end();
+	while (it != mFrames.begin() && int32_t(timestamp - std::prev(it)->timestamp) < 0)
+		--it;
+
+	if (it == mFrames.begin() || std::prev(it)->timestamp != timestamp)
+		it = std::next(mFrames.insert(it, Frame{timestamp, rtp->payloadType(), false, {}}));
+
+	auto &frame = *std::prev(it);
+	if (rtp->marker())
+		frame.marker = true;
+
+	auto &packets = frame.packets;
+	auto jt = packets.end();
+	while (jt != packets.begin()) {
+		auto prev = reinterpret_cast<const RtpHeader *>(std::prev(jt)->get()->data());
+		int16_t diff = int16_t(sequenceNumber - prev->seqNumber());
+		if (diff == 0)
+			return; // duplicate
+		if (diff > 0)
+			break;
+
+		--jt;
+	}
+	packets.insert(jt, std::move(packet));
+}
+
+bool VideoRtpDepacketizer::isComplete(const Frame &frame) const {
+	if (!frame.marker || frame.packets.empty())
+		return false;
+
+	uint16_t expected =
+	    reinterpret_cast<const RtpHeader *>(frame.packets.front()->data())->seqNumber();
+
+	// Without a previous frame, check the first packet does not continue a fragmented unit
+	if (mLastSequenceNumber ? expected != uint16_t(*mLastSequenceNumber + 1)
+	                        : !isFrameStart(frame.packets.front()))
+		return false;
+
+	for (const auto &packet : frame.packets)
+		if (reinterpret_cast<const RtpHeader *>(packet->data())->seqNumber() != expected++)
+			return false;
+
+	return true;
+}
+
+message_ptr VideoRtpDepacketizer::buildFrame(const Frame &frame) const {
+	impl::FrameAssembler assembler;
+	depacketize(frame.packets, assembler);
+	if (assembler.empty())
+		return nullptr;
+
+	auto frameInfo = std::make_shared<FrameInfo>(frame.payloadType, frame.timestamp);
+	return assembler.finish(std::move(frameInfo), mOutput == Output::Slices);
+}
+
+} // namespace rtc
+
+#endif // RTC_ENABLE_MEDIA
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "rtc/rtc.hpp"
+
+#include "netem.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace rtc;
+using namespace std;
+using namespace chrono_literals;
+
+void test_emulated_network() {
+	InitLogger(LogLevel::Warning);
+
+	// Lossy 10 Mbit/s path with 20ms one-way delay, jitter and reordering
+	test::LinkConfiguration link;
+	link.bandwidth = 10000000;
+	link.delay = 20ms;
+	link.jitter = 5ms;
+	link.loss = 0.02;
+	link.reordering = 0.01;
+	link.queueLimit = 256 * 1024;
+	test::NetworkEmulator emulator(link);
+
+	PeerConnection pc1;
+	PeerConnection pc2;
+	emulator.connect(pc1, pc2);
+
+	const size_t messageSize = 1024;
+	const size_t messageCount = 1000;
+
+	atomic<size_t> received = 0;
+	atomic<bool> outOfOrder = false;
+	pc2.onDataChannel([&](shared_ptr<DataChannel> dc) {
+		dc->onMessage([&](variant<binary, string> message) {
+			if (!holds_alternative<binary>(message))
+				return;
+
+			const auto &data = get<binary>(message);
+			if (data.size() != messageSize || data[0] != byte(received % 256))
+				outOfOrder = true;
+
+			++received;
+		});
+		dc->onClosed([]() { cout << "DataChannel 2: Closed" << endl; });
+	});
+
+	auto dc1 = pc1.createDataChannel("emulated");
+	dc1->onOpen([]() { cout << "DataChannel 1: Open" << endl; });
+
+	int attempts = 10;
+	while (!dc1->isOpen() && attempts--)
+		this_thread::sleep_for(1s);
+
+	if (!dc1->isOpen())
+		throw runtime_error("DataChannel is not open through the emulated network");
+
+	auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < messageCount; ++i) {
+		binary data(messageSize, byte(i % 256));
+		dc1->send(std::move(data));
+	}
+
+	attempts = 30;
+	while (received < messageCount && attempts--)
+		this_thread::sleep_for(1s);
+
+	auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+	auto forward = emulator.stats(test::NetworkEmulator::Direction::Forward);
+	cout << "Received " << received << " messages in " << elapsed.count() << "ms, forward path: "
+	     << forward.packets << " packets, " << forward.lost << " lost, " << forward.reordered
+	     << " reordered, " << forward.overflowed << " overflowed" << endl;
+
+	if (received < messageCount)
+		throw runtime_error("Not all messages were received through the emulated network");
+
+	if (outOfOrder)
+		throw runtime_error("Messages were corrupted or received out of order");
+
+	if (forward.lost == 0)
+		throw runtime_error("Emulated network did not drop any packet");
+
+	pc1.close();
+	pc2.close();
+	this_thread::sleep_for(1s);
+}
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "rtc/rtc.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace rtc;
+using namespace std;
+using namespace chrono_literals;
+
+namespace {
+
+const SSRC TestSsrc = 42;
+
+message_ptr make_rtp(uint16_t seq) {
+	auto message = make_message(sizeof(RtpHeader) + 4);
+	auto rtp = reinterpret_cast<RtpHeader *>(message->data());
+	rtp->preparePacket();
+	rtp->setPayloadType(96);
+	rtp->setSsrc(TestSsrc);
+	rtp->setSeqNumber(seq);
+	rtp->setTimestamp(seq * 3000u);
+	return message;
+}
+
+struct Result {
+	vector<uint16_t> released;
+	vector<uint16_t> nacked;
+};
+
+Result process(JitterBufferHandler &handler, message_vector messages) {
+	Result result;
+	handler.incoming(messages, [&result](message_ptr message) {
+		auto nack = reinterpret_cast<RtcpNack *>(message->data());
+		for (unsigned int i = 0; i < nack->getSeqNoCount(); ++i)
+			for (uint16_t seq : nack->parts[i].getSequenceNumbers())
+				result.nacked.push_back(seq);
+	});
+
+	for (const auto &message : messages) {
+		if (message->type == Message::Control)
+			continue;
+
+		auto rtp = reinterpret_cast<const RtpHeader *>(message->data());
+		result.released.push_back(rtp->seqNumber());
+	}
+	return result;
+}
+
+Result push(JitterBufferHandler &handler, vector<uint16_t> seqs) {
+	message_vector messages;
+	for (uint16_t seq : seqs)
+		messages.push_back(make_rtp(seq));
+
+	return process(handler, std::move(messages));
+}
+
+void check(const vector<uint16_t> &actual, const vector<uint16_t> &expected, const char *what) {
+	if (actual != expected)
+		throw runtime_error(string("Unexpected ") + what);
+}
+
+} // namespace
+
+void test_jitterbuffer() {
+	InitLogger(LogLevel::Debug);
+
+	// Reordered packets are released in order
+	{
+		JitterBufferHandler handler(200ms);
+		check(push(handler, {65534}).released, {65534}, "release of the first packet");
+		check(push(handler, {0, 1}).released, {}, "release before the gap is filled");
+		check(push(handler, {65535}).released, {65535, 0, 1}, "release after reordering");
+		check(push(handler, {1}).released, {}, "release of a duplicate");
+	}
+
+	// A gap triggers a NACK, then the packets after it are released on the deadline
+	{
+		JitterBufferHandler handler(50ms);
+		handler.setRoundTripTime(10ms);
+		push(handler, {100});
+		auto result = push(handler, {102, 103, 105});
+		check(result.released, {}, "release with missing packets");
+		check(result.nacked, {101, 104}, "NACKed sequence numbers");
+
+		this_thread::sleep_for(100ms);
+
+		// Any incoming message lets held packets go once the deadline has passed
+		auto released = process(handler, {make_message(0, Message::Control)}).released;
+		check(released, {102, 103, 105}, "release after the deadline");
+	}
+
+	// Large jumps, for instance on sender restart, resynchronize the stream
+	{
+		JitterBufferHandler handler(200ms);
+		push(handler, {30000, 30001});
+		check(push(handler, {1000, 1001}).released, {1000, 1001}, "release after a backward jump");
+		check(push(handler, {40000}).released, {40000}, "release after a forward jump");
+
+		// A run of late packets eventually resynchronizes too
+		vector<uint16_t> seqs;
+		for (uint16_t seq = 39900; seq < 39900 + JitterBufferHandler::MaxLatePackets; ++seq)
+			seqs.push_back(seq);
+
+		auto result = push(handler, seqs);
+		if (result.released.empty() || result.released.front() != 39915)
+			throw runtime_error("Unexpected release after a run of late packets");
+	}
+
+	cout << "Jitter buffer test successful" << endl;
+}
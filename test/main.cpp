@@ -19,8 +19,13 @@ void test_connectivity(bool signal_wrong_fingerprint);
 void test_pem();
 void test_negotiated();
 void test_reliability();
+void test_emulated_network();
 void test_turn_connectivity();
 void test_track();
+void test_jitterbuffer();
+void test_transportcc();
+void test_router();
+void test_packetization();
 void test_capi_connectivity();
 void test_capi_track();
 void test_websocket();
@@ -92,6 +97,14 @@ int main(int argc, char **argv) {
 		cerr << "WebRTC reliability test failed: " << e.what() << endl;
 		return -1;
 	}
+	try {
+		cout << endl << "*** Running WebRTC emulated network test..." << endl;
+		test_emulated_network();
+		cout << "*** Finished WebRTC emulated network test" << endl;
+	} catch (const exception &e) {
+		cerr << "WebRTC emulated network test failed: " << e.what() << endl;
+		return -1;
+	}
 #if RTC_ENABLE_MEDIA
 	try {
 		cout << endl << "*** Running WebRTC Track test..." << endl;
@@ -101,6 +114,38 @@ int main(int argc, char **argv) {
 		cerr << "WebRTC Track test failed: " << e.what() << endl;
 		return -1;
 	}
+	try {
+		cout << endl << "*** Running jitter buffer test..." << endl;
+		test_jitterbuffer();
+		cout << "*** Finished jitter buffer test" << endl;
+	} catch (const exception &e) {
+		cerr << "Jitter buffer test failed: " << e.what() << endl;
+		return -1;
+	}
+	try {
+		cout << endl << "*** Running transport-wide congestion control test..." << endl;
+		test_transportcc();
+		cout << "*** Finished transport-wide congestion control test" << endl;
+	} catch (const exception &e) {
+		cerr << "Transport-wide congestion control test failed: " << e.what() << endl;
+		return -1;
+	}
+	try {
+		cout << endl << "*** Running router test..." << endl;
+		test_router();
+		cout << "*** Finished router test" << endl;
+	} catch (const exception &e) {
+		cerr << "Router test failed: " << e.what() << endl;
+		return -1;
+	}
+	try {
+		cout << endl << "*** Running packetization test..." << endl;
+		test_packetization();
+		cout << "*** Finished packetization test" << endl;
+	} catch (const exception &e) {
+		cerr << "Packetization test failed: " << e.what() << endl;
+		return -1;
+	}
 #endif
 #if RTC_ENABLE_WEBSOCKET
 // TODO: Temporarily disabled as the echo service is unreliable
@@ -0,0 +1,647 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// CPU-only microbenchmarks with JSON output, intended for regression tracking.
+// Usage: microbenchmark [--filter <substring>] [--min-time <ms>] [--output <file.json>]
+
+#include "rtc/rtc.hpp"
+
+#include "impl/queue.hpp"
+#include "impl/threadpool.hpp"
+
+#if RTC_ENABLE_WEBSOCKET
+#include "impl/wstransport.hpp"
+#endif
+
+#if RTC_ENABLE_MEDIA
+#if RTC_SYSTEM_SRTP
+#include <srtp2/srtp.h>
+#else
+#include "srtp.h"
+#endif
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace rtc;
+using namespace std;
+using namespace chrono_literals;
+
+using chrono::steady_clock;
+
+namespace {
+
+struct Result {
+	string name;
+	uint64_t iterations;
+	double nsPerOp;
+	double bytesPerSecond; // zero if not applicable
+};
+
+struct Options {
+	string filter;
+	chrono::milliseconds minTime = 200ms;
+	string output;
+};
+
+// Deterministic generator so that runs are comparable
+class Lcg {
+public:
+	Lcg(uint32_t seed = 0x5eed) : mState(seed) {}
+	uint32_t operator()() { return mState = mState * 1664525u + 1013904223u; }
+
+	// Never returns zero, so generated payloads can't contain start sequences
+	std::byte nonZeroByte() { return std::byte(1 + ((*this)() >> 24) % 255); }
+
+private:
+	uint32_t mState;
+};
+
+volatile size_t sink = 0; // prevents the compiler from discarding results
+
+class Runner {
+public:
+	explicit Runner(Options options) : mOptions(std::move(options)) {}
+
+	// func(n) must run n iterations, each processing bytesPerOp bytes
+	void run(const string &name, size_t bytesPerOp, const function<void(uint64_t)> &func) {
+		if (!mOptions.filter.empty() && name.find(mOptions.filter) == string::npos)
+			return;
+
+		func(1); // warm up
+
+		uint64_t n = 1;
+		while (true) {
+			auto start = steady_clock::now();
+			func(n);
+			auto elapsed = steady_clock::now() - start;
+			if (elapsed >= mOptions.minTime || n >= (uint64_t(1) << 40)) {
+				double ns = double(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+				Result result{name, n, ns / double(n),
+				              bytesPerOp > 0 ? double(bytesPerOp) * double(n) * 1e9 / ns : 0.};
+				cerr << left << setw(52) << name << right << setw(12) << n << setw(14) << fixed
+				     << setprecision(1) << result.nsPerOp << " ns/op";
+				if (bytesPerOp > 0)
+					cerr << setw(12) << setprecision(1) << result.bytesPerSecond / 1e6 << " MB/s";
+				cerr << endl;
+				mResults.push_back(std::move(result));
+				return;
+			}
+
+			// Extrapolate the iteration count needed to reach the minimum time
+			auto ns = std::max<int64_t>(
+			    chrono::duration_cast<chrono::nanoseconds>(elapsed).count(), 1);
+			auto target = chrono::duration_cast<chrono::nanoseconds>(mOptions.minTime).count();
+			uint64_t next = uint64_t(double(n) * 1.2 * double(target) / double(ns));
+			n = std::clamp(next, n + 1, n * 100);
+		}
+	}
+
+	void skip(const string &name, const string &reason) {
+		if (!mOptions.filter.empty() && name.find(mOptions.filter) == string::npos)
+			return;
+
+		cerr << left << setw(52) << name << " skipped: " << reason << endl;
+	}
+
+	string json() const {
+		std::ostringstream oss;
+		oss << "{\n";
+		oss << "  \"context\": {\"library\": \"libdatachannel\", \"version\": \"" << RTC_VERSION
+		    << "\", \"min_time_ms\": " << mOptions.minTime.count() << "},\n";
+		oss << "  \"benchmarks\": [";
+		for (size_t i = 0; i < mResults.size(); ++i) {
+			const auto &r = mResults[i];
+			oss << (i > 0 ? "," : "") << "\n    {\"name\": \"" << r.name
+			    << "\", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << fixed
+			    << setprecision(3) << r.nsPerOp;
+			if (r.bytesPerSecond > 0)
+				oss << ", \"bytes_per_second\": " << setprecision(0) << r.bytesPerSecond;
+			oss << "}";
+		}
+		oss << "\n  ]\n}\n";
+		return oss.str();
+	}
+
+private:
+	const Options mOptions;
+	vector<Result> mResults;
+};
+
+const message_callback noSend = [](message_ptr) {};
+
+#if RTC_ENABLE_MEDIA
+
+binary makeNalUnit(Lcg &rng, size_t size, std::initializer_list<uint8_t> header) {
+	binary nalu;
+	nalu.reserve(4 + size);
+	nalu.insert(nalu.end(), {std::byte(0), std::byte(0), std::byte(0), std::byte(1)});
+	for (auto b : header)
+		nalu.push_back(std::byte(b));
+	while (nalu.size() < 4 + size)
+		nalu.push_back(rng.nonZeroByte());
+	return nalu;
+}
+
+// SPS, PPS and a large IDR slice with long start sequences
+message_ptr makeH264AccessUnit(size_t frameSize) {
+	Lcg rng;
+	binary au;
+	for (const auto &nalu : {makeNalUnit(rng, 20, {0x67}), makeNalUnit(rng, 8, {0x68}),
+	                         makeNalUnit(rng, frameSize, {0x65})})
+		au.insert(au.end(), nalu.begin(), nalu.end());
+	return make_message(std::move(au));
+}
+
+// VPS, SPS, PPS and a large IDR_W_RADL slice with long start sequences
+message_ptr makeH265AccessUnit(size_t frameSize) {
+	Lcg rng;
+	binary au;
+	for (const auto &nalu :
+	     {makeNalUnit(rng, 24, {32 << 1, 0x01}), makeNalUnit(rng, 40, {33 << 1, 0x01}),
+	      makeNalUnit(rng, 8, {34 << 1, 0x01}), makeNalUnit(rng, frameSize, {19 << 1, 0x01})})
+		au.insert(au.end(), nalu.begin(), nalu.end());
+	return make_message(std::move(au));
+}
+
+void appendObu(binary &tu, Lcg &rng, uint8_t type, size_t size) {
+	tu.push_back(std::byte((type << 3) | 0x02)); // obu_has_size_field
+	size_t s = size;
+	do {
+		uint8_t b = s & 0x7F;
+		s >>= 7;
+		tu.push_back(std::byte(s ? b | 0x80 : b));
+	} while (s);
+	for (size_t i = 0; i < size; ++i)
+		tu.push_back(rng.nonZeroByte());
+}
+
+// Temporal unit delimiter, sequence header and a large frame OBU
+message_ptr makeAV1TemporalUnit(size_t frameSize) {
+	Lcg rng;
+	binary tu{std::byte(0x12), std::byte(0x00)};
+	appendObu(tu, rng, 1, 12);        // OBU_SEQUENCE_HEADER
+	appendObu(tu, rng, 6, frameSize); // OBU_FRAME
+	return make_message(std::move(tu));
+}
+
+shared_ptr<RtpPacketizationConfig> makeRtpConfig(uint8_t payloadType, uint32_t clockRate) {
+	auto rtpConfig = make_shared<RtpPacketizationConfig>(42, "microbenchmark", payloadType, clockRate);
+	rtpConfig->timestamp = rtpConfig->startTimestamp = 3000;
+	return rtpConfig;
+}
+
+void benchmarkPacketizer(Runner &runner, const string &name, shared_ptr<MediaHandler> packetizer,
+                         shared_ptr<RtpPacketizationConfig> rtpConfig, message_ptr frame) {
+	runner.run(name, frame->size(), [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			rtpConfig->timestamp += 3000;
+			message_vector messages{frame};
+			packetizer->outgoing(messages, noSend);
+			sink += messages.size();
+		}
+	});
+}
+
+void benchmarkPacketizers(Runner &runner) {
+	{
+		auto rtpConfig = makeRtpConfig(111, OpusRtpPacketizer::DefaultClockRate);
+		auto packetizer = make_shared<OpusRtpPacketizer>(rtpConfig);
+		Lcg rng;
+		binary payload(160);
+		std::generate(payload.begin(), payload.end(), [&]() { return rng.nonZeroByte(); });
+		benchmarkPacketizer(runner, "rtp_packetizer/opus_160B", packetizer, rtpConfig,
+		                    make_message(std::move(payload)));
+	}
+	{
+		auto rtpConfig = makeRtpConfig(96, H264RtpPacketizer::defaultClockRate);
+		rtpConfig->mid = "video";
+		rtpConfig->midId = 1;
+		auto packetizer = make_shared<H264RtpPacketizer>(
+		    NalUnit::Separator::LongStartSequence, rtpConfig);
+		benchmarkPacketizer(runner, "h264_packetizer/idr_50KB", packetizer, rtpConfig,
+		                    makeH264AccessUnit(50000));
+		benchmarkPacketizer(runner, "h264_packetizer/slice_1KB", packetizer, rtpConfig,
+		                    makeH264AccessUnit(1000));
+	}
+	{
+		auto rtpConfig = makeRtpConfig(97, H265RtpPacketizer::defaultClockRate);
+		auto packetizer = make_shared<H265RtpPacketizer>(
+		    NalUnit::Separator::LongStartSequence, rtpConfig);
+		benchmarkPacketizer(runner, "h265_packetizer/idr_50KB", packetizer, rtpConfig,
+		                    makeH265AccessUnit(50000));
+	}
+	{
+		auto rtpConfig = makeRtpConfig(98, AV1RtpPacketizer::defaultClockRate);
+		auto packetizer = make_shared<AV1RtpPacketizer>(
+		    AV1RtpPacketizer::Packetization::TemporalUnit, rtpConfig);
+		benchmarkPacketizer(runner, "av1_packetizer/frame_50KB", packetizer, rtpConfig,
+		                    makeAV1TemporalUnit(50000));
+	}
+}
+
+// Pre-packetize a sequence of frames, they are restamped on replay so timestamps and sequence
+// numbers keep increasing
+void benchmarkDepacketizer(Runner &runner, const string &name, RtpPacketizer &packetizer,
+                           shared_ptr<RtpPacketizationConfig> rtpConfig, message_ptr frame,
+                           VideoRtpDepacketizer &depacketizer) {
+	const size_t frameCount = 64;
+
+	vector<message_vector> frames;
+	for (size_t i = 0; i < frameCount; ++i) {
+		rtpConfig->timestamp += 3000;
+		message_vector messages{make_message(*frame)};
+		packetizer.outgoing(messages, noSend);
+		frames.push_back(std::move(messages));
+	}
+
+	uint32_t timestamp = rtpConfig->timestamp;
+	uint16_t sequenceNumber = rtpConfig->sequenceNumber;
+	size_t index = 0;
+	runner.run(name, frame->size(), [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			message_vector messages = frames[index++ % frameCount];
+			timestamp += 3000;
+			for (auto &message : messages) {
+				auto rtp = reinterpret_cast<RtpHeader *>(message->data());
+				rtp->setTimestamp(timestamp);
+				rtp->setSeqNumber(sequenceNumber++);
+			}
+			depacketizer.incoming(messages, noSend);
+			sink += messages.size();
+		}
+	});
+}
+
+void benchmarkDepacketizers(Runner &runner) {
+	const size_t frameSize = 20000;
+	{
+		auto rtpConfig = makeRtpConfig(96, H264RtpPacketizer::defaultClockRate);
+		H264RtpPacketizer packetizer(NalUnit::Separator::LongStartSequence, rtpConfig);
+		auto accessUnit = makeH264AccessUnit(frameSize);
+
+		H264RtpDepacketizer contiguous(NalUnit::Separator::LongStartSequence);
+		benchmarkDepacketizer(runner, "h264_depacketizer/frame_20KB", packetizer, rtpConfig,
+		                      accessUnit, contiguous);
+
+		H264RtpDepacketizer slices(NalUnit::Separator::LongStartSequence,
+		                           H264RtpDepacketizer::Output::Slices);
+		benchmarkDepacketizer(runner, "h264_depacketizer/frame_20KB_slices", packetizer,
+		                      rtpConfig, accessUnit, slices);
+	}
+	{
+		auto rtpConfig = makeRtpConfig(97, H265RtpPacketizer::defaultClockRate);
+		H265RtpPacketizer packetizer(NalUnit::Separator::LongStartSequence, rtpConfig);
+		H265RtpDepacketizer depacketizer(NalUnit::Separator::LongStartSequence);
+		benchmarkDepacketizer(runner, "h265_depacketizer/frame_20KB", packetizer, rtpConfig,
+		                      makeH265AccessUnit(frameSize), depacketizer);
+	}
+	{
+		auto rtpConfig = makeRtpConfig(98, AV1RtpPacketizer::defaultClockRate);
+		AV1RtpPacketizer packetizer(AV1RtpPacketizer::Packetization::TemporalUnit, rtpConfig);
+		AV1RtpDepacketizer depacketizer;
+		benchmarkDepacketizer(runner, "av1_depacketizer/frame_20KB", packetizer, rtpConfig,
+		                      makeAV1TemporalUnit(frameSize), depacketizer);
+	}
+}
+
+void benchmarkNackResponder(Runner &runner) {
+	const size_t packetCount = RtcpNackResponder::DefaultMaxSize;
+
+	auto rtpConfig = makeRtpConfig(96, 90000);
+	RtpPacketizer packetizer(rtpConfig);
+	auto payload = make_message(1200);
+	vector<message_ptr> packets;
+	for (size_t i = 0; i < packetCount; ++i) {
+		message_vector messages{payload};
+		packetizer.outgoing(messages, noSend);
+		packets.push_back(messages.front());
+	}
+
+	RtcpNackResponder responder;
+	size_t index = 0;
+	runner.run("nack_responder/store", 0, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			message_vector messages{packets[index++ % packetCount]};
+			responder.outgoing(messages, noSend);
+		}
+	});
+
+	// NACK requesting 17 packets (PID and full BLP) in the middle of the history
+	auto nackMessage = make_message(RtcpNack::Size(1), Message::Control);
+	auto nack = reinterpret_cast<RtcpNack *>(nackMessage->data());
+	nack->preparePacket(rtpConfig->ssrc, 1);
+	unsigned int fciCount = 0;
+	uint16_t fciPid = 0;
+	uint16_t first = uint16_t(rtpConfig->sequenceNumber - packetCount / 2);
+	for (uint16_t s = first; s != uint16_t(first + 17); ++s)
+		nack->addMissingPacket(&fciCount, &fciPid, s);
+
+	size_t resent = 0;
+	const message_callback countSend = [&resent](message_ptr) { ++resent; };
+	runner.run("nack_responder/get_17", 0, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			message_vector messages{nackMessage};
+			responder.incoming(messages, countSend);
+		}
+	});
+	sink += resent;
+}
+
+void benchmarkSrtp(Runner &runner, const string &name, srtp_profile_t profile) {
+	size_t keySize = srtp_profile_get_master_key_length(profile) +
+	                 srtp_profile_get_master_salt_length(profile);
+	vector<unsigned char> key(keySize);
+	Lcg rng;
+	std::generate(key.begin(), key.end(), [&]() { return uint8_t(rng() >> 24); });
+
+	srtp_policy_t inbound = {}, outbound = {};
+	if (srtp_crypto_policy_set_from_profile_for_rtp(&outbound.rtp, profile) ||
+	    srtp_crypto_policy_set_from_profile_for_rtcp(&outbound.rtcp, profile)) {
+		runner.skip(name, "profile not supported");
+		return;
+	}
+	outbound.ssrc.type = ssrc_any_outbound;
+	outbound.key = key.data();
+	outbound.window_size = 1024;
+	outbound.allow_repeat_tx = true;
+	inbound = outbound;
+	inbound.ssrc.type = ssrc_any_inbound;
+
+	srtp_t srtpOut = nullptr, srtpIn = nullptr;
+	if (srtp_create(&srtpOut, &outbound) || srtp_create(&srtpIn, &inbound)) {
+		if (srtpOut)
+			srtp_dealloc(srtpOut);
+		runner.skip(name, "srtp_create failed");
+		return;
+	}
+
+	const size_t payloadSize = 1200;
+	binary packet(sizeof(RtpHeader) + payloadSize + SRTP_MAX_TRAILER_LEN);
+	auto header = reinterpret_cast<RtpHeader *>(packet.data());
+	header->preparePacket();
+	header->setSsrc(42);
+	header->setPayloadType(96);
+	binary buffer(packet.size());
+	uint16_t seq = 0;
+
+	auto protect = [&]() {
+		header->setSeqNumber(seq++);
+		header->setTimestamp(seq * 3000);
+		std::copy(packet.begin(), packet.end(), buffer.begin());
+		int size = int(sizeof(RtpHeader) + payloadSize);
+		if (srtp_protect(srtpOut, buffer.data(), &size))
+			throw runtime_error("srtp_protect failed");
+		return size;
+	};
+
+	runner.run(name + "/protect", payloadSize, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			sink += protect();
+	});
+
+	runner.run(name + "/protect_unprotect", payloadSize, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			int size = protect();
+			if (srtp_unprotect(srtpIn, buffer.data(), &size))
+				throw runtime_error("srtp_unprotect failed");
+			sink += size;
+		}
+	});
+
+	srtp_dealloc(srtpOut);
+	srtp_dealloc(srtpIn);
+}
+
+void benchmarkSrtp(Runner &runner) {
+	srtp_init();
+	benchmarkSrtp(runner, "srtp/aes128_cm_sha1_80", srtp_profile_aes128_cm_sha1_80);
+	benchmarkSrtp(runner, "srtp/aes128_cm_sha1_32", srtp_profile_aes128_cm_sha1_32);
+	benchmarkSrtp(runner, "srtp/aead_aes_128_gcm", srtp_profile_aead_aes_128_gcm);
+	benchmarkSrtp(runner, "srtp/aead_aes_256_gcm", srtp_profile_aead_aes_256_gcm);
+}
+
+#endif // RTC_ENABLE_MEDIA
+
+#if RTC_ENABLE_WEBSOCKET
+
+void benchmarkWebSocketFrames(Runner &runner, size_t size) {
+	using impl::WsTransport;
+	const string suffix = "_" + to_string(size) + "B";
+
+	Lcg rng;
+	binary payload(size);
+	std::generate(payload.begin(), payload.end(), [&]() { return rng.nonZeroByte(); });
+
+	runner.run("ws_frame/build_masked" + suffix, size, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			WsTransport::Frame frame{WsTransport::BINARY_FRAME, payload.data(), payload.size(),
+			                         true, true};
+			sink += WsTransport::BuildFrame(frame)->size();
+		}
+	});
+
+	const auto encoded = *WsTransport::BuildFrame(
+	    {WsTransport::BINARY_FRAME, payload.data(), payload.size(), true, true});
+	binary buffer(encoded.size());
+	runner.run("ws_frame/parse_masked" + suffix, size, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			std::copy(encoded.begin(), encoded.end(), buffer.begin()); // parsing unmasks in place
+			WsTransport::Frame frame;
+			sink += WsTransport::ParseFrame(buffer.data(), buffer.size(), frame, size);
+		}
+	});
+}
+
+void benchmarkWebSocketFrames(Runner &runner) {
+	benchmarkWebSocketFrames(runner, 100);
+	benchmarkWebSocketFrames(runner, 65536);
+}
+
+#endif // RTC_ENABLE_WEBSOCKET
+
+const char *const sdpOffer =
+    "v=0\r\n"
+    "o=rtc 3767197920 0 IN IP4 127.0.0.1\r\n"
+    "s=-\r\n"
+    "t=0 0\r\n"
+    "a=group:BUNDLE 0 1 2\r\n"
+    "a=msid-semantic:WMS *\r\n"
+    "a=setup:actpass\r\n"
+    "a=ice-ufrag:Qyz7\r\n"
+    "a=ice-pwd:dhv39Vq4ByzdEtJ4T5hxHE\r\n"
+    "a=ice-options:ice2,trickle\r\n"
+    "a=fingerprint:sha-256 "
+    "6C:95:1B:45:6C:88:5D:4B:7D:8A:A2:1C:C5:31:0D:C9:2E:56:66:66:0D:54:AE:7E:59:0D:4B:65:A0:A9:"
+    "70:4D\r\n"
+    "m=audio 9 UDP/TLS/RTP/SAVPF 111\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=mid:0\r\n"
+    "a=sendrecv\r\n"
+    "a=ssrc:1001 cname:audio-stream\r\n"
+    "a=ssrc:1001 msid:stream audio\r\n"
+    "a=rtcp-mux\r\n"
+    "a=extmap:1 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+    "a=rtpmap:111 opus/48000/2\r\n"
+    "a=rtcp-fb:111 transport-cc\r\n"
+    "a=fmtp:111 minptime=10;maxaveragebitrate=96000;stereo=1;sprop-stereo=1;useinbandfec=1\r\n"
+    "m=video 9 UDP/TLS/RTP/SAVPF 96 97 98\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=mid:1\r\n"
+    "a=sendrecv\r\n"
+    "a=ssrc:2001 cname:video-stream\r\n"
+    "a=ssrc:2001 msid:stream video\r\n"
+    "a=ssrc:2002 cname:video-stream\r\n"
+    "a=ssrc-group:FID 2001 2002\r\n"
+    "a=rtcp-mux\r\n"
+    "a=extmap:1 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+    "a=extmap:3 urn:3gpp:video-orientation\r\n"
+    "a=rtpmap:96 H264/90000\r\n"
+    "a=rtcp-fb:96 nack\r\n"
+    "a=rtcp-fb:96 nack pli\r\n"
+    "a=rtcp-fb:96 goog-remb\r\n"
+    "a=fmtp:96 profile-level-id=42e01f;packetization-mode=1;level-asymmetry-allowed=1\r\n"
+    "a=rtpmap:97 rtx/90000\r\n"
+    "a=fmtp:97 apt=96\r\n"
+    "a=rtpmap:98 AV1/90000\r\n"
+    "a=rtcp-fb:98 nack\r\n"
+    "m=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=mid:2\r\n"
+    "a=sctp-port:5000\r\n"
+    "a=max-message-size:262144\r\n"
+    "a=candidate:1 1 UDP 2122317823 192.168.1.10 40000 typ host\r\n"
+    "a=candidate:2 1 UDP 1686110207 203.0.113.5 40000 typ srflx raddr 192.168.1.10 rport 40000\r\n"
+    "a=end-of-candidates\r\n";
+
+void benchmarkDescription(Runner &runner) {
+	const string sdp = sdpOffer;
+	runner.run("description/parse", sdp.size(), [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			Description description(sdp, Description::Type::Offer);
+			sink += description.mediaCount();
+		}
+	});
+
+	const Description description(sdp, Description::Type::Offer);
+	runner.run("description/generate", sdp.size(), [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			sink += description.generateSdp().size();
+	});
+}
+
+void benchmarkQueue(Runner &runner) {
+	impl::Queue<message_ptr> queue(0, message_size_func);
+	auto message = make_message(1000);
+	runner.run("queue/push_pop", 0, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			queue.push(message);
+			sink += queue.pop().has_value();
+		}
+	});
+
+	const size_t batch = 64;
+	runner.run("queue/push_pop_batch64", 0, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			for (size_t j = 0; j < batch; ++j)
+				queue.push(message);
+			while (auto element = queue.pop())
+				sink += (*element)->size();
+		}
+	});
+}
+
+void benchmarkThreadPool(Runner &runner) {
+	auto &pool = impl::ThreadPool::Instance(); // spawned by rtc::Preload()
+
+	runner.run("threadpool/enqueue_wait", 0, [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			sink += pool.enqueue([]() { return 1; }).get();
+	});
+
+	const size_t batch = 256;
+	runner.run("threadpool/enqueue_batch256", 0, [&](uint64_t n) {
+		vector<std::future<int>> futures;
+		futures.reserve(batch);
+		for (uint64_t i = 0; i < n; ++i) {
+			for (size_t j = 0; j < batch; ++j)
+				futures.push_back(pool.enqueue([]() { return 1; }));
+			for (auto &f : futures)
+				sink += f.get();
+			futures.clear();
+		}
+	});
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc) {
+			options.filter = argv[++i];
+		} else if (arg == "--min-time" && i + 1 < argc) {
+			options.minTime = chrono::milliseconds(std::stoi(argv[++i]));
+		} else if (arg == "--output" && i + 1 < argc) {
+			options.output = argv[++i];
+		} else {
+			cerr << "Usage: " << argv[0]
+			     << " [--filter <substring>] [--min-time <ms>] [--output <file.json>]" << endl;
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	try {
+		rtc::InitLogger(LogLevel::Warning);
+		rtc::Preload();
+
+		Runner runner(options);
+
+#if RTC_ENABLE_MEDIA
+		benchmarkPacketizers(runner);
+		benchmarkDepacketizers(runner);
+		benchmarkNackResponder(runner);
+		benchmarkSrtp(runner);
+#endif
+#if RTC_ENABLE_WEBSOCKET
+		benchmarkWebSocketFrames(runner);
+#endif
+		benchmarkDescription(runner);
+		benchmarkQueue(runner);
+		benchmarkThreadPool(runner);
+
+		if (options.output.empty()) {
+			cout << runner.json();
+		} else {
+			std::ofstream file(options.output);
+			if (!file)
+				throw runtime_error("Unable to open " + options.output);
+			file << runner.json();
+		}
+
+	} catch (const exception &e) {
+		cerr << "Microbenchmark failed: " << e.what() << endl;
+		rtc::Cleanup();
+		return -1;
+	}
+
+	rtc::Cleanup();
+	return 0;
+}
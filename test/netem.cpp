@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "netem.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace rtc::test {
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+namespace {
+
+const size_t MAX_DATAGRAM_SIZE = 65536;
+
+socket_t createRelaySocket(uint16_t &port) {
+	socket_t sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET)
+		throw std::runtime_error("UDP socket creation failed, errno=" + std::to_string(sockerrno));
+
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addrlen = sizeof(addr);
+	if (::bind(sock, reinterpret_cast<struct sockaddr *>(&addr), addrlen) < 0 ||
+	    ::getsockname(sock, reinterpret_cast<struct sockaddr *>(&addr), &addrlen) < 0) {
+		closesocket(sock);
+		throw std::runtime_error("UDP socket binding failed, errno=" + std::to_string(sockerrno));
+	}
+
+	ctl_t nbio = 1;
+	if (::ioctlsocket(sock, FIONBIO, &nbio) < 0) {
+		closesocket(sock);
+		throw std::runtime_error("Failed to set socket non-blocking mode");
+	}
+
+	port = ntohs(addr.sin_port);
+	return sock;
+}
+
+} // namespace
+
+NetworkEmulator::NetworkEmulator(LinkConfiguration forward, LinkConfiguration backward,
+                                 uint32_t seed)
+    : mRandom(seed) {
+	mLinks[int(Direction::Forward)].config = std::move(forward);
+	mLinks[int(Direction::Backward)].config = std::move(backward);
+
+	Preload(); // sockets require global initialization on Windows
+	try {
+		for (auto &endpoint : mEndpoints)
+			endpoint.sock = createRelaySocket(endpoint.port);
+	} catch (...) {
+		for (auto &endpoint : mEndpoints)
+			if (endpoint.sock != INVALID_SOCKET)
+				closesocket(endpoint.sock);
+		throw;
+	}
+
+	mThread = std::thread(&NetworkEmulator::run, this);
+}
+
+NetworkEmulator::NetworkEmulator(LinkConfiguration link, uint32_t seed)
+    : NetworkEmulator(link, link, seed) {}
+
+NetworkEmulator::~NetworkEmulator() {
+	mStopping = true;
+	mThread.join();
+
+	for (auto &endpoint : mEndpoints)
+		closesocket(endpoint.sock);
+}
+
+void NetworkEmulator::connect(PeerConnection &pc1, PeerConnection &pc2) {
+	PeerConnection *pcs[2] = {&pc1, &pc2};
+	for (int i = 0; i < 2; ++i) {
+		PeerConnection *remote = pcs[1 - i];
+		pcs[i]->onLocalDescription([this, i, remote](Description description) {
+			auto candidates = description.extractCandidates();
+			remote->setRemoteDescription(std::move(description));
+			for (const auto &candidate : candidates)
+				if (auto rewritten = relay(i, candidate))
+					remote->addRemoteCandidate(std::move(*rewritten));
+		});
+		pcs[i]->onLocalCandidate([this, i, remote](Candidate candidate) {
+			if (auto rewritten = relay(i, candidate))
+				remote->addRemoteCandidate(std::move(*rewritten));
+		});
+	}
+}
+
+void NetworkEmulator::setLink(Direction direction, LinkConfiguration link) {
+	std::lock_guard lock(mMutex);
+	mLinks[int(direction)].config = std::move(link);
+}
+
+LinkConfiguration NetworkEmulator::link(Direction direction) const {
+	std::lock_guard lock(mMutex);
+	return mLinks[int(direction)].config;
+}
+
+LinkStats NetworkEmulator::stats(Direction direction) const {
+	std::lock_guard lock(mMutex);
+	return mLinks[int(direction)].stats;
+}
+
+optional<Candidate> NetworkEmulator::relay(int index, Candidate candidate) {
+	// Only the first IPv4 UDP candidate of each peer is relayed, the others are dropped
+	if (candidate.transportType() != Candidate::TransportType::Udp || !candidate.resolve() ||
+	    candidate.family() != Candidate::Family::Ipv4)
+		return nullopt;
+
+	std::lock_guard lock(mMutex);
+	auto &endpoint = mEndpoints[index];
+	if (endpoint.peerAddrLen > 0)
+		return nullopt;
+
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(*candidate.port());
+	if (::inet_pton(AF_INET, candidate.address()->c_str(), &addr.sin_addr) != 1)
+		return nullopt;
+
+	std::memcpy(&endpoint.peerAddr, &addr, sizeof(addr));
+	endpoint.peerAddrLen = sizeof(addr);
+
+	// The remote peer will reach this peer through the relay socket standing for it
+	candidate.changeAddress("127.0.0.1", endpoint.port);
+	return candidate;
+}
+
+void NetworkEmulator::run() {
+	std::vector<byte> buffer(MAX_DATAGRAM_SIZE);
+	while (!mStopping) {
+		auto timeout = milliseconds(10);
+		{
+			std::lock_guard lock(mMutex);
+			if (!mPending.empty()) {
+				// Round up, a timeout truncated to 0 would spin until the deadline
+				auto left = std::chrono::ceil<milliseconds>(mPending.top().time - clock::now());
+				timeout = std::clamp(left, milliseconds(0), timeout);
+			}
+		}
+
+		struct pollfd pfd[2];
+		for (int i = 0; i < 2; ++i) {
+			pfd[i].fd = mEndpoints[i].sock;
+			pfd[i].events = POLLIN;
+			pfd[i].revents = 0;
+		}
+
+		if (::poll(pfd, 2, int(timeout.count())) < 0) {
+			if (sockerrno == SEINTR || sockerrno == SEAGAIN)
+				continue;
+
+			std::cerr << "Network emulator: poll failed, errno=" << sockerrno << std::endl;
+			break;
+		}
+
+		for (int i = 0; i < 2; ++i) {
+			if (!(pfd[i].revents & POLLIN))
+				continue;
+
+			// A datagram received on the socket standing for a peer is destined to that peer
+			while (true) {
+				int len = ::recv(pfd[i].fd, reinterpret_cast<char *>(buffer.data()),
+				                 int(buffer.size()), 0);
+				if (len < 0)
+					break; // SEAGAIN or error
+
+				schedule(i, binary(buffer.begin(), buffer.begin() + len));
+			}
+		}
+
+		flush(clock::now());
+	}
+}
+
+void NetworkEmulator::schedule(int to, binary data) {
+	std::lock_guard lock(mMutex);
+	auto &link = mLinks[to == 1 ? int(Direction::Forward) : int(Direction::Backward)];
+	const auto &config = link.config;
+	auto now = clock::now();
+
+	++link.stats.packets;
+	link.stats.bytes += data.size();
+
+	std::uniform_real_distribution<double> uniform(0., 1.);
+	if (config.loss > 0. && uniform(mRandom) < config.loss) {
+		++link.stats.lost;
+		return;
+	}
+
+	// Bottleneck queue and serialization
+	auto time = now;
+	if (config.bandwidth > 0) {
+		auto start = std::max(now, link.busyUntil);
+		if (config.queueLimit > 0) {
+			auto backlog = duration_cast<microseconds>(start - now).count() *
+			               int64_t(config.bandwidth) / 8 / 1000000;
+			if (size_t(backlog) + data.size() > config.queueLimit) {
+				++link.stats.overflowed;
+				return;
+			}
+		}
+
+		auto serialization = microseconds(int64_t(data.size()) * 8 * 1000000 /
+		                                  int64_t(config.bandwidth));
+		link.busyUntil = start + serialization;
+		time = link.busyUntil;
+	}
+
+	// Propagation delay and jitter
+	time += config.delay;
+	if (config.jitter.count() > 0) {
+		std::uniform_int_distribution<int64_t> jitter(0, config.jitter.count());
+		time += microseconds(jitter(mRandom));
+	}
+
+	// Packets are delivered in order unless explicitly reordered
+	if (config.reordering > 0. && uniform(mRandom) < config.reordering) {
+		time += config.reorderingDelay;
+		++link.stats.reordered;
+	} else {
+		time = std::max(time, link.lastDelivery);
+		link.lastDelivery = time;
+	}
+
+	mPending.push(Datagram{time, mOrder++, to, std::move(data)});
+}
+
+void NetworkEmulator::flush(clock::time_point now) {
+	std::lock_guard lock(mMutex);
+	while (!mPending.empty() && mPending.top().time <= now) {
+		const auto &datagram = mPending.top();
+		const auto &endpoint = mEndpoints[datagram.to];
+		if (endpoint.peerAddrLen > 0) {
+			// Send from the socket standing for the other peer
+			::sendto(mEndpoints[1 - datagram.to].sock,
+			         reinterpret_cast<const char *>(datagram.data.data()),
+			         int(datagram.data.size()), 0,
+			         reinterpret_cast<const struct sockaddr *>(&endpoint.peerAddr),
+			         endpoint.peerAddrLen);
+		}
+		mPending.pop();
+	}
+}
+
+} // namespace rtc::test
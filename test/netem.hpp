@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef RTC_TEST_NETEM_H
+#define RTC_TEST_NETEM_H
+
+#include "rtc/rtc.hpp"
+
+#include "impl/socket.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace rtc::test {
+
+// Characteristics of one direction of an emulated path
+struct LinkConfiguration {
+	size_t bandwidth = 0; // in bits per second, 0 means unlimited
+	std::chrono::microseconds delay{0};
+	std::chrono::microseconds jitter{0}; // uniformly distributed in [0, jitter]
+	double loss = 0.;                     // drop probability in [0, 1]
+	double reordering = 0.;               // probability to be held back by reorderingDelay
+	std::chrono::microseconds reorderingDelay{std::chrono::milliseconds(10)};
+	size_t queueLimit = 0; // in bytes, packets overflowing the bottleneck queue are dropped
+};
+
+struct LinkStats {
+	size_t packets = 0;
+	size_t bytes = 0;
+	size_t lost = 0;
+	size_t overflowed = 0;
+	size_t reordered = 0;
+};
+
+// In-process network emulator linking two PeerConnections through a simulated path.
+// It acts as a UDP relay on the loopback interface under the ICE transports: local candidates
+// are rewritten to point to the relay, which shapes, delays, drops, and reorders datagrams before
+// forwarding them. Random decisions are seeded, so runs are repeatable.
+class NetworkEmulator final {
+public:
+	enum class Direction { Forward, Backward }; // Forward is from the first to the second peer
+
+	NetworkEmulator(LinkConfiguration forward, LinkConfiguration backward, uint32_t seed = 1);
+	NetworkEmulator(LinkConfiguration link = {}, uint32_t seed = 1);
+	~NetworkEmulator();
+
+	NetworkEmulator(const NetworkEmulator &) = delete;
+	NetworkEmulator &operator=(const NetworkEmulator &) = delete;
+
+	// Exchange descriptions and candidates between the peers through the emulated path. This
+	// replaces their local description and local candidate callbacks.
+	void connect(PeerConnection &pc1, PeerConnection &pc2);
+
+	void setLink(Direction direction, LinkConfiguration link);
+	LinkConfiguration link(Direction direction) const;
+	LinkStats stats(Direction direction) const;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Endpoint {
+		socket_t sock = INVALID_SOCKET;      // relay socket standing for the peer
+		uint16_t port = 0;                   // local port of the relay socket
+		struct sockaddr_storage peerAddr {}; // actual address of the peer
+		socklen_t peerAddrLen = 0;
+	};
+
+	struct Link {
+		LinkConfiguration config;
+		LinkStats stats;
+		clock::time_point busyUntil; // bottleneck serialization
+		clock::time_point lastDelivery;
+	};
+
+	struct Datagram {
+		clock::time_point time;
+		uint64_t order;
+		int to; // index of the destination endpoint
+		binary data;
+		bool operator>(const Datagram &other) const {
+			return time > other.time || (time == other.time && order > other.order);
+		}
+	};
+
+	void run();
+	void schedule(int to, binary data);
+	void flush(clock::time_point now);
+	optional<Candidate> relay(int index, Candidate candidate);
+
+	Endpoint mEndpoints[2];
+	Link mLinks[2]; // indexed by Direction
+	std::priority_queue<Datagram, std::vector<Datagram>, std::greater<Datagram>> mPending;
+	std::mt19937 mRandom;
+	uint64_t mOrder = 0;
+
+	std::atomic<bool> mStopping = false;
+	mutable std::mutex mMutex;
+	std::thread mThread;
+};
+
+} // namespace rtc::test
+
+#endif
@@ -0,0 +1,348 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "rtc/rtc.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace rtc;
+using namespace std;
+
+namespace {
+
+const uint16_t MaxFragmentSize = 1200;
+const uint32_t FrameDuration = 3000; // 30 fps at 90kHz
+
+// Payload bytes are never zero so they can't emulate a start sequence
+void append(binary &frame, std::initializer_list<uint8_t> header, size_t size, int seed) {
+	for (uint8_t b : header)
+		frame.push_back(byte(b));
+
+	for (size_t i = header.size(); i < size; ++i)
+		frame.push_back(byte((seed * 7 + i) % 251 + 1));
+}
+
+void append_nal_unit(binary &frame, std::initializer_list<uint8_t> header, size_t size,
+                     int seed) {
+	const byte startSequence[] = {byte(0), byte(0), byte(0), byte(1)};
+	frame.insert(frame.end(), startSequence, startSequence + 4);
+	append(frame, header, size, seed);
+}
+
+// Parameter sets then an IDR slice for the first frame, then SEI units and a non-IDR slice
+binary make_h264_frame(int index) {
+	binary frame;
+	if (index == 0) {
+		append_nal_unit(frame, {0x67}, 12, index);
+		append_nal_unit(frame, {0x68}, 6, index);
+		append_nal_unit(frame, {0x65}, 3000, index);
+	} else {
+		append_nal_unit(frame, {0x06}, 20, index);
+		append_nal_unit(frame, {0x06}, 30, index);
+		append_nal_unit(frame, {0x41}, 2500 + 100 * index, index);
+	}
+	return frame;
+}
+
+binary make_h265_frame(int index) {
+	binary frame;
+	if (index == 0) {
+		append_nal_unit(frame, {0x40, 0x01}, 20, index);
+		append_nal_unit(frame, {0x42, 0x01}, 40, index);
+		append_nal_unit(frame, {0x44, 0x01}, 8, index);
+		append_nal_unit(frame, {0x26, 0x01}, 3000, index);
+	} else {
+		append_nal_unit(frame, {0x4E, 0x01}, 20, index);
+		append_nal_unit(frame, {0x02, 0x01}, 2500 + 100 * index, index);
+	}
+	return frame;
+}
+
+// Temporal unit with a sequence header for the first frame, then a frame OBU, all with sizes
+binary make_av1_frame(int index) {
+	binary frame = {byte(0x12), byte(0x00)};
+	if (index == 0)
+		append(frame, {0x0A, 0x0B}, 13, index);
+
+	const size_t size = 2500 + 100 * index;
+	append(frame, {0x32, uint8_t(0x80 | (size & 0x7F)), uint8_t(size >> 7)}, size + 3, index);
+	return frame;
+}
+
+// Custom packetizer counting the packets created through the in-place overload
+class CountingPacketizer final : public RtpPacketizer {
+public:
+	using RtpPacketizer::RtpPacketizer;
+
+	size_t count = 0;
+
+protected:
+	using RtpPacketizer::packetize;
+
+	message_ptr packetize(const byte *prefix, size_t prefixSize, const byte *data, size_t size,
+	                      bool mark) override {
+		++count;
+		return RtpPacketizer::packetize(prefix, prefixSize, data, size, mark);
+	}
+};
+
+const RtpHeader *header(const message_ptr &packet) {
+	return reinterpret_cast<const RtpHeader *>(packet->data());
+}
+
+uint8_t payload_byte(const message_ptr &packet, size_t index) {
+	return std::to_integer<uint8_t>(packet->at(header(packet)->getSize() + index));
+}
+
+struct Codec {
+	string name;
+	function<shared_ptr<RtpPacketizer>(shared_ptr<RtpPacketizationConfig>)> packetizer;
+	function<shared_ptr<VideoRtpDepacketizer>()> depacketizer;
+	function<binary(int)> frame;
+};
+
+using Packets = vector<message_ptr>;
+
+// Packetize frames, returning packets for each frame
+vector<Packets> packetize(const Codec &codec, int count, uint32_t timestamp) {
+	auto rtpConfig = make_shared<RtpPacketizationConfig>(42, "cname", 96, 90000);
+	auto packetizer = codec.packetizer(rtpConfig);
+	vector<Packets> frames;
+	for (int i = 0; i < count; ++i) {
+		rtpConfig->timestamp = timestamp + i * FrameDuration;
+		auto frame = codec.frame(i);
+		message_vector messages{make_message(frame.begin(), frame.end())};
+		packetizer->outgoing(messages, [](message_ptr) {});
+		if (messages.size() < 3)
+			throw runtime_error(codec.name + " frame was not fragmented");
+
+		frames.push_back(std::move(messages));
+	}
+	return frames;
+}
+
+// Depacketize packets one by one, returning frames by timestamp
+map<uint32_t, binary> depacketize(VideoRtpDepacketizer &depacketizer, const Packets &packets) {
+	map<uint32_t, binary> frames;
+	optional<uint32_t> last;
+	for (const auto &packet : packets) {
+		message_vector messages{make_message(packet->begin(), packet->end())};
+		depacketizer.incoming(messages, [](message_ptr) {});
+		for (const auto &message : messages) {
+			if (!message->frameInfo)
+				throw runtime_error("Depacketized frame has no frame info");
+
+			const uint32_t timestamp = message->frameInfo->timestamp;
+			if (last && int32_t(timestamp - *last) <= 0)
+				throw runtime_error("Depacketized frames are not in order");
+
+			last = timestamp;
+			frames.emplace(timestamp, binary(message->begin(), message->end()));
+		}
+	}
+	return frames;
+}
+
+void check_frames(const Codec &codec, const map<uint32_t, binary> &frames, int count,
+                  uint32_t timestamp, optional<int> lost = nullopt) {
+	for (int i = 0; i < count; ++i) {
+		if (lost && i == *lost)
+			continue;
+
+		auto it = frames.find(timestamp + i * FrameDuration);
+		if (it == frames.end())
+			throw runtime_error(codec.name + " frame is missing");
+
+		if (it->second != codec.frame(i))
+			throw runtime_error(codec.name + " frame differs after round trip");
+	}
+}
+
+void test_round_trip(const Codec &codec) {
+	const int Count = 6;
+
+	// In order
+	{
+		auto frames = packetize(codec, Count, 0);
+		Packets packets;
+		for (const auto &frame : frames)
+			packets.insert(packets.end(), frame.begin(), frame.end());
+
+		auto depacketizer = codec.depacketizer();
+		check_frames(codec, depacketize(*depacketizer, packets), Count, 0);
+	}
+
+	// Reordered within frames and across frame boundaries
+	{
+		auto frames = packetize(codec, Count, 0);
+		for (auto &frame : frames)
+			std::swap(frame[0], frame[1]);
+
+		// Until a marker bit is seen, a frame is assumed complete once a newer one starts, so the
+		// first frame boundary is kept in order
+		Packets packets;
+		for (size_t i = 0; i < frames.size(); ++i) {
+			packets.insert(packets.end(), frames[i].begin(), frames[i].end());
+			if (i > 1)
+				std::swap(packets[packets.size() - frames[i].size()],
+				          packets[packets.size() - frames[i].size() - 1]);
+		}
+
+		auto depacketizer = codec.depacketizer();
+		check_frames(codec, depacketize(*depacketizer, packets), Count, 0);
+	}
+
+	// A lost packet only affects its frame
+	{
+		const int Lost = 2;
+		auto frames = packetize(codec, Count, 0);
+		frames[Lost].erase(frames[Lost].begin() + 1);
+
+		Packets packets;
+		for (const auto &frame : frames)
+			packets.insert(packets.end(), frame.begin(), frame.end());
+
+		auto depacketizer = codec.depacketizer();
+		check_frames(codec, depacketize(*depacketizer, packets), Count, 0, Lost);
+	}
+
+	// A large backward timestamp jump, like on sender restart, resynchronizes the stream
+	{
+		auto depacketizer = codec.depacketizer();
+		const uint32_t Restart = 1000000;
+		for (uint32_t timestamp : {Restart + 90000 * 20, Restart}) {
+			Packets packets;
+			for (const auto &frame : packetize(codec, Count, timestamp))
+				packets.insert(packets.end(), frame.begin(), frame.end());
+
+			check_frames(codec, depacketize(*depacketizer, packets), Count, timestamp);
+		}
+	}
+}
+
+} // namespace
+
+void test_packetization() {
+	InitLogger(LogLevel::Debug);
+
+	const auto LongStartSequence = NalUnit::Separator::LongStartSequence;
+
+	// Parameter sets are aggregated in a STAP-A packet, then the slice is fragmented in FU-A
+	// packets with contiguous sequence numbers and the marker bit on the last one
+	{
+		auto rtpConfig = make_shared<RtpPacketizationConfig>(42, "cname", 96, 90000);
+		rtpConfig->timestamp = 1234;
+		H264RtpPacketizer packetizer(LongStartSequence, rtpConfig, MaxFragmentSize);
+		auto frame = make_h264_frame(0);
+		message_vector packets{make_message(frame.begin(), frame.end())};
+		packetizer.outgoing(packets, [](message_ptr) {});
+
+		if (packets.size() != 5)
+			throw runtime_error("Unexpected number of H264 packets");
+
+		binary slice = {byte(0x65)};
+		for (size_t i = 0; i < packets.size(); ++i) {
+			const auto rtp = header(packets[i]);
+			if (rtp->ssrc() != 42 || rtp->payloadType() != 96 || rtp->timestamp() != 1234)
+				throw runtime_error("Unexpected H264 packet header");
+
+			if (rtp->seqNumber() != uint16_t(header(packets[0])->seqNumber() + i))
+				throw runtime_error("H264 packet sequence numbers are not contiguous");
+
+			if (bool(rtp->marker()) != (i + 1 == packets.size()))
+				throw runtime_error("Unexpected H264 packet marker bit");
+
+			if (i == 0) {
+				// STAP-A with the highest NRI, then 16-bit sizes before each unit
+				if (payload_byte(packets[i], 0) != 0x78 || payload_byte(packets[i], 2) != 12 ||
+				    payload_byte(packets[i], 3) != 0x67 || payload_byte(packets[i], 16) != 6 ||
+				    payload_byte(packets[i], 17) != 0x68 ||
+				    packets[i]->size() != rtp->getSize() + 1 + 2 + 12 + 2 + 6)
+					throw runtime_error("Unexpected H264 STAP-A payload");
+			} else {
+				// FU indicator with the NRI, then FU header with start and end bits and the type
+				const uint8_t start = i == 1 ? 0x80 : 0;
+				const uint8_t end = i + 1 == packets.size() ? 0x40 : 0;
+				if (payload_byte(packets[i], 0) != 0x7C ||
+				    payload_byte(packets[i], 1) != (start | end | 0x05))
+					throw runtime_error("Unexpected H264 FU-A header");
+
+				slice.insert(slice.end(), packets[i]->begin() + rtp->getSize() + 2,
+				             packets[i]->end());
+			}
+		}
+
+		if (slice != binary(frame.end() - 3000, frame.end()))
+			throw runtime_error("H264 FU-A payloads don't match the slice");
+	}
+
+	// Custom packetizers see every packet through the in-place overload
+	{
+		auto rtpConfig = make_shared<RtpPacketizationConfig>(42, "cname", 111, 48000);
+		CountingPacketizer packetizer(rtpConfig);
+		binary payload(100, byte(1));
+		message_vector messages{make_message(payload.begin(), payload.end()),
+		                        make_message(payload.begin(), payload.end())};
+		packetizer.outgoing(messages, [](message_ptr) {});
+		if (packetizer.count != 2 || messages.size() != 2 ||
+		    messages[1]->size() != header(messages[1])->getSize() + payload.size())
+			throw runtime_error("Custom packetizer did not see all packets");
+	}
+	vector<Codec> codecs = {
+	    {"H264",
+	     [&](shared_ptr<RtpPacketizationConfig> config) {
+		     return make_shared<H264RtpPacketizer>(LongStartSequence, config, MaxFragmentSize);
+	     },
+	     [&]() { return make_shared<H264RtpDepacketizer>(LongStartSequence); }, make_h264_frame},
+	    {"H265",
+	     [&](shared_ptr<RtpPacketizationConfig> config) {
+		     return make_shared<H265RtpPacketizer>(LongStartSequence, config, MaxFragmentSize);
+	     },
+	     [&]() { return make_shared<H265RtpDepacketizer>(LongStartSequence); }, make_h265_frame},
+	    {"AV1",
+	     [](shared_ptr<RtpPacketizationConfig> config) {
+		     return make_shared<AV1RtpPacketizer>(AV1RtpPacketizer::Packetization::TemporalUnit,
+		                                          config, MaxFragmentSize);
+	     },
+	     []() { return make_shared<AV1RtpDepacketizer>(); }, make_av1_frame},
+	};
+
+	for (const auto &codec : codecs)
+		test_round_trip(codec);
+
+	// Packets without any usable unit don't produce frames
+	{
+		auto packet = [](std::initializer_list<uint8_t> payload) {
+			binary data(sizeof(RtpHeader));
+			auto rtp = reinterpret_cast<RtpHeader *>(data.data());
+			rtp->preparePacket();
+			rtp->setPayloadType(96);
+			rtp->setSsrc(42);
+			rtp->setMarker(true);
+			for (uint8_t b : payload)
+				data.push_back(byte(b));
+
+			return Packets{make_message(std::move(data))};
+		};
+
+		H265RtpDepacketizer h265(LongStartSequence);
+		AV1RtpDepacketizer av1;
+		auto unknown = packet({50 << 1, 0x01, 0xAA}); // PACI packet
+		auto delimiter = packet({0x10, 0x12, 0x00}); // temporal delimiter only
+		if (!depacketize(h265, unknown).empty() || !depacketize(av1, delimiter).empty())
+			throw runtime_error("Unexpected frame without any unit");
+	}
+
+	cout << "Packetization test successful" << endl;
+}
@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "rtc/rtc.hpp"
+
+#include "impl/probepacket.hpp"
+#include "impl/track.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace rtc;
+using namespace std;
+using namespace chrono_literals;
+
+namespace {
+
+// Records packets sent on a track instead of sending them
+class Recorder final : public MediaHandler {
+public:
+	void outgoing(message_vector &messages, const message_callback &) override {
+		std::lock_guard lock(mMutex);
+		for (auto &message : messages)
+			if (message->type != Message::Control)
+				mPackets.push_back(std::move(message));
+
+		messages.clear();
+	}
+
+	vector<message_ptr> wait(size_t count) {
+		for (int i = 0; i < 200; ++i) {
+			{
+				std::lock_guard lock(mMutex);
+				if (mPackets.size() >= count)
+					return mPackets;
+			}
+			this_thread::sleep_for(10ms);
+		}
+		throw runtime_error("Timeout waiting for forwarded packets");
+	}
+
+private:
+	std::mutex mMutex;
+	vector<message_ptr> mPackets;
+};
+
+// Counts keyframe requests reaching the end of the publisher chain
+class KeyframeCounter final : public MediaHandler {
+public:
+	bool requestKeyframe(const message_callback &) override {
+		++count;
+		return true;
+	}
+
+	std::atomic<int> count = 0;
+};
+
+shared_ptr<Track> make_track(const string &mid, Description::Direction direction,
+                             optional<SSRC> ssrc, const vector<pair<int, string>> &codecs) {
+	Description::Video video(mid, direction);
+	for (const auto &[pt, profile] : codecs)
+		video.addH264Codec(pt, profile);
+
+	if (ssrc)
+		video.addSSRC(*ssrc, "cname");
+
+	return make_shared<Track>(make_shared<impl::Track>(weak_ptr<impl::PeerConnection>(), video));
+}
+
+void receive(const shared_ptr<Track> &track, message_ptr message) {
+	message_vector messages{std::move(message)};
+	track->getMediaHandler()->incomingChain(messages, [](message_ptr) {});
+}
+
+message_ptr make_rtp(SSRC ssrc, uint16_t seq, uint32_t timestamp, bool keyframe) {
+	auto message = make_message(sizeof(RtpHeader) + 10);
+	auto rtp = reinterpret_cast<RtpHeader *>(message->data());
+	rtp->preparePacket();
+	rtp->setPayloadType(96);
+	rtp->setSsrc(ssrc);
+	rtp->setSeqNumber(seq);
+	rtp->setTimestamp(timestamp);
+	message->at(sizeof(RtpHeader)) = byte(keyframe ? 5 : 1); // H264 IDR or non-IDR slice
+	return message;
+}
+
+message_ptr make_pli(SSRC ssrc) {
+	auto message = make_message(RtcpPli::Size(), Message::Control);
+	reinterpret_cast<RtcpPli *>(message->data())->preparePacket(ssrc);
+	return message;
+}
+
+} // namespace
+
+void test_router() {
+	InitLogger(LogLevel::Debug);
+	Preload(); // packets are fanned out on the thread pool
+
+	const string Mode0 = "profile-level-id=42e01f;packetization-mode=0";
+	const string Mode1 = "profile-level-id=42e01f;packetization-mode=1";
+	const auto RecvOnly = Description::Direction::RecvOnly;
+	const auto SendOnly = Description::Direction::SendOnly;
+
+	// Switching publishers keeps the output sequence numbers and timestamps continuous
+	{
+		auto pubA = make_track("a", RecvOnly, nullopt, {{96, Mode1}});
+		auto pubB = make_track("b", RecvOnly, nullopt, {{96, Mode1}});
+
+		// The first payload type doesn't match the packetization mode of the publishers
+		auto sub = make_track("s", SendOnly, 42, {{100, Mode0}, {102, Mode1}});
+		auto recorder = make_shared<Recorder>();
+		sub->setMediaHandler(recorder);
+
+		auto router = make_shared<Router>();
+		router->addPublisher(pubA);
+		router->addPublisher(pubB);
+		router->subscribe(sub, pubA);
+
+		receive(pubA, make_rtp(1000, 99, 0, false)); // not forwarded before a keyframe
+		receive(pubA, make_rtp(1000, 100, 3000, true));
+		receive(pubA, make_rtp(1000, 101, 6000, false));
+
+		router->subscribe(sub, pubB);
+		receive(pubB, make_rtp(2000, 5000, 777, false)); // still waiting for a keyframe
+		receive(pubA, make_rtp(1000, 102, 9000, false));
+		this_thread::sleep_for(20ms);
+		receive(pubB, make_rtp(2000, 5001, 90777, true));
+		receive(pubA, make_rtp(1000, 103, 12000, false)); // not forwarded after the switch
+		receive(pubB, make_rtp(2000, 5002, 93777, false));
+
+		auto packets = recorder->wait(5);
+		if (packets.size() != 5)
+			throw runtime_error("Unexpected number of forwarded packets");
+
+		vector<const RtpHeader *> rtps;
+		for (const auto &packet : packets)
+			rtps.push_back(reinterpret_cast<const RtpHeader *>(packet->data()));
+
+		for (size_t i = 0; i < rtps.size(); ++i) {
+			if (rtps[i]->ssrc() != 42 || rtps[i]->payloadType() != 102)
+				throw runtime_error("Forwarded packet has wrong SSRC or payload type");
+
+			if (rtps[i]->seqNumber() != uint16_t(rtps[0]->seqNumber() + i))
+				throw runtime_error("Forwarded sequence numbers are not continuous");
+		}
+
+		if (rtps[1]->timestamp() - rtps[0]->timestamp() != 3000 ||
+		    rtps[2]->timestamp() - rtps[1]->timestamp() != 3000)
+			throw runtime_error("Forwarded timestamps are not preserved");
+
+		// After the switch, the timestamp advances by the elapsed time, then follows the source
+		if (int32_t(rtps[3]->timestamp() - rtps[2]->timestamp()) <= 0)
+			throw runtime_error("Timestamp does not advance on switch");
+
+		if (rtps[4]->timestamp() - rtps[3]->timestamp() != 3000)
+			throw runtime_error("Forwarded timestamps are not preserved after switch");
+
+		router.reset();
+		if (sub->getMediaHandler() != recorder)
+			throw runtime_error("Router handler was not removed");
+	}
+
+	// Probes on the publisher stream are not forwarded and leave no gap in sequence numbers
+	{
+		auto pub = make_track("p", RecvOnly, nullopt, {{96, Mode1}});
+		auto sub = make_track("s", SendOnly, 45, {{96, Mode1}});
+		auto recorder = make_shared<Recorder>();
+		sub->setMediaHandler(recorder);
+
+		auto router = make_shared<Router>();
+		router->addPublisher(pub);
+		router->subscribe(sub, pub);
+
+		const impl::ProbeInfo probe{1, 1000000};
+		receive(pub, make_rtp(3000, 200, 0, true));
+		receive(pub, impl::MakeProbePacket(3000, 96, 201, 0, probe));
+		receive(pub, impl::MakeProbePacket(3000, 96, 202, 0, probe));
+		receive(pub, make_rtp(3000, 203, 3000, false));
+		receive(pub, impl::MakeProbePacket(3000, 96, 204, 3000, probe));
+		receive(pub, make_rtp(3000, 205, 6000, false));
+
+		recorder->wait(3);
+		this_thread::sleep_for(20ms);
+		auto packets = recorder->wait(3);
+		if (packets.size() != 3)
+			throw runtime_error("Probes were forwarded");
+
+		auto first = reinterpret_cast<const RtpHeader *>(packets[0]->data());
+		for (size_t i = 0; i < packets.size(); ++i) {
+			auto rtp = reinterpret_cast<const RtpHeader *>(packets[i]->data());
+			if (rtp->seqNumber() != uint16_t(first->seqNumber() + i))
+				throw runtime_error("Forwarded sequence numbers are not continuous with probes");
+		}
+	}
+
+	// Keyframe requests from subscribers are aggregated and rate limited
+	{
+		auto pub = make_track("p", RecvOnly, nullopt, {{96, Mode1}});
+		auto counter = make_shared<KeyframeCounter>();
+		pub->setMediaHandler(counter);
+
+		auto sub1 = make_track("s1", SendOnly, 43, {{96, Mode1}});
+		auto sub2 = make_track("s2", SendOnly, 44, {{96, Mode1}});
+
+		auto router = make_shared<Router>(200ms);
+		router->addPublisher(pub);
+		router->subscribe(sub1, pub);
+		router->subscribe(sub2, pub);
+		receive(sub1, make_pli(43));
+		receive(sub2, make_pli(44));
+		if (counter->count != 1)
+			throw runtime_error("Keyframe requests were not aggregated");
+
+		this_thread::sleep_for(300ms);
+		receive(sub1, make_pli(43));
+		receive(sub2, make_pli(44));
+		if (counter->count != 2)
+			throw runtime_error("Keyframe request was not sent after the interval");
+	}
+
+	cout << "Router test successful" << endl;
+}
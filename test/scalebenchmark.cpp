@@ -0,0 +1,507 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// Scale benchmark: sets up N local peer pairs in one process over loopback, then reports memory
+// per connection, setup time percentiles, CPU usage and thread pool queue latency at idle and
+// under load, as JSON.
+// Usage: scalebenchmark [--pairs <n>] [--channels <n>] [--tracks <n>] [--concurrency <n>]
+//                       [--duration <s>] [--rate <messages/s>] [--size <bytes>]
+//                       [--certificate-pool <n>] [--certificate-lifetime <s>] [--fanout]
+//                       [--srtp-profile <cm80|cm32|gcm128|gcm256>] [--output <file>]
+// With --fanout, the same RTP packet is sent to all tracks at once with rtc::Track::Fanout(), like
+// an SFU forwarding a packet to its subscribers. Tracks with the same index then share their SSRC
+// across pairs, and one packet per SSRC is fanned out. With --srtp-profile, both peers prefer the
+// given SRTP profile, which allows to compare the CPU usage of profiles under load.
+
+#include "rtc/rtc.hpp"
+
+#include "impl/threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace rtc;
+using namespace std;
+using namespace chrono_literals;
+
+using chrono::duration_cast;
+using chrono::microseconds;
+using chrono::milliseconds;
+using chrono::steady_clock;
+
+namespace {
+
+struct Options {
+	size_t pairs = 100;
+	size_t channels = 1;
+	size_t tracks = 0;
+	size_t concurrency = 32; // simultaneous setups
+	chrono::seconds duration = 10s;
+	size_t rate = 10;  // messages per second per channel or track under load
+	size_t size = 200; // message size in bytes
+	size_t certificatePool = 0;
+	chrono::seconds certificateLifetime = 0s;
+	bool fanout = false;
+	std::vector<SrtpProfile> srtpProfiles; // empty for default
+	string output;
+};
+
+template <class T> weak_ptr<T> make_weak_ptr(shared_ptr<T> ptr) { return ptr; }
+
+// Resident set size in bytes, 0 if unavailable
+size_t residentSetSize() {
+#ifdef __linux__
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	if (statm >> pages >> resident)
+		return resident * size_t(sysconf(_SC_PAGESIZE));
+#endif
+	return 0;
+}
+
+// Number of threads in the process, 0 if unavailable
+size_t threadCount() {
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	string line;
+	while (std::getline(status, line))
+		if (line.rfind("Threads:", 0) == 0)
+			return std::stoul(line.substr(8));
+#endif
+	return 0;
+}
+
+// Process CPU time (user and system)
+microseconds cpuTime() {
+#ifndef _WIN32
+	struct rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		auto tv = [](const struct timeval &t) {
+			return microseconds(int64_t(t.tv_sec) * 1000000 + t.tv_usec);
+		};
+		return tv(usage.ru_utime) + tv(usage.ru_stime);
+	}
+#endif
+	return microseconds(0);
+}
+
+template <typename T> T percentile(vector<T> values, double p) {
+	if (values.empty())
+		return T{};
+
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, size_t(p * double(values.size() - 1) + 0.5));
+	return values[index];
+}
+
+template <typename T> string percentilesJson(const vector<T> &values) {
+	std::ostringstream oss;
+	oss << fixed << setprecision(3) << "{\"count\": " << values.size()
+	    << ", \"p50\": " << percentile(values, 0.50) << ", \"p90\": " << percentile(values, 0.90)
+	    << ", \"p99\": " << percentile(values, 0.99) << ", \"max\": " << percentile(values, 1.)
+	    << "}";
+	return oss.str();
+}
+
+// Measures how long a task waits in the thread pool queue before running
+class ThreadPoolProbe {
+public:
+	void start() {
+		mRunning = true;
+		mThread = std::thread([this]() {
+			while (mRunning) {
+				auto enqueued = steady_clock::now();
+				auto future = impl::ThreadPool::Instance().enqueue([enqueued]() {
+					return double(duration_cast<microseconds>(steady_clock::now() - enqueued)
+					                  .count());
+				});
+				double latency = future.get();
+				{
+					std::lock_guard lock(mMutex);
+					mLatencies.push_back(latency);
+				}
+				std::this_thread::sleep_for(10ms);
+			}
+		});
+	}
+
+	vector<double> stop() {
+		mRunning = false;
+		if (mThread.joinable())
+			mThread.join();
+
+		std::lock_guard lock(mMutex);
+		return std::exchange(mLatencies, {});
+	}
+
+private:
+	std::thread mThread;
+	std::atomic<bool> mRunning = false;
+	std::mutex mMutex;
+	vector<double> mLatencies; // in microseconds
+};
+
+struct Pair {
+	shared_ptr<PeerConnection> pc1, pc2;
+	vector<shared_ptr<DataChannel>> channels;
+	vector<shared_ptr<Track>> tracks;
+	std::atomic<size_t> pending = 0; // remaining open events
+	steady_clock::time_point start;
+	std::atomic<double> setupMs = -1.;
+};
+
+std::atomic<size_t> received = 0;
+
+void setup(Pair &pair, size_t index, const Options &options) {
+	Configuration config1;
+	config1.disableAutoNegotiation = true; // offer once everything is added
+	config1.srtpProfiles = options.srtpProfiles;
+	Configuration config2;
+	config2.srtpProfiles = options.srtpProfiles;
+	pair.pc1 = make_shared<PeerConnection>(config1);
+	pair.pc2 = make_shared<PeerConnection>(config2);
+
+	auto &pc1 = pair.pc1;
+	auto &pc2 = pair.pc2;
+
+	pc1->onLocalDescription([wpc2 = make_weak_ptr(pc2)](Description sdp) {
+		if (auto pc2 = wpc2.lock())
+			pc2->setRemoteDescription(std::move(sdp));
+	});
+	pc1->onLocalCandidate([wpc2 = make_weak_ptr(pc2)](Candidate candidate) {
+		if (auto pc2 = wpc2.lock())
+			pc2->addRemoteCandidate(std::move(candidate));
+	});
+	pc2->onLocalDescription([wpc1 = make_weak_ptr(pc1)](Description sdp) {
+		if (auto pc1 = wpc1.lock())
+			pc1->setRemoteDescription(std::move(sdp));
+	});
+	pc2->onLocalCandidate([wpc1 = make_weak_ptr(pc1)](Candidate candidate) {
+		if (auto pc1 = wpc1.lock())
+			pc1->addRemoteCandidate(std::move(candidate));
+	});
+
+	auto onMessage = [](message_variant) {
+		received.fetch_add(1, std::memory_order_relaxed);
+	};
+	pc2->onDataChannel([onMessage](shared_ptr<DataChannel> dc) { dc->onMessage(onMessage); });
+	pc2->onTrack([onMessage](shared_ptr<Track> track) { track->onMessage(onMessage); });
+
+	auto opened = [&pair]() {
+		if (--pair.pending == 0)
+			pair.setupMs = double(duration_cast<microseconds>(steady_clock::now() - pair.start)
+			                          .count()) /
+			               1000.;
+	};
+
+	pair.pending = options.channels + options.tracks;
+	pair.start = steady_clock::now();
+
+	for (size_t i = 0; i < options.channels; ++i) {
+		auto dc = pc1->createDataChannel("channel-" + to_string(i));
+		dc->onOpen(opened);
+		pair.channels.push_back(std::move(dc));
+	}
+
+	for (size_t i = 0; i < options.tracks; ++i) {
+		Description::Video media("video-" + to_string(i), Description::Direction::SendOnly);
+		media.addH264Codec(96);
+		// With fan-out, pairs receive the same packets so tracks share their SSRC across pairs
+		media.addSSRC(uint32_t(options.fanout ? i + 1 : index * options.tracks + i + 1),
+		              "video-send");
+		auto track = pc1->addTrack(media);
+		track->onOpen(opened);
+		pair.tracks.push_back(std::move(track));
+	}
+
+	pc1->setLocalDescription();
+}
+
+binary makeRtpPacket(uint32_t ssrc, size_t size) {
+	binary packet(std::max(size, sizeof(RtpHeader)));
+	auto rtp = reinterpret_cast<RtpHeader *>(packet.data());
+	rtp->preparePacket();
+	rtp->setPayloadType(96);
+	rtp->setSsrc(ssrc);
+	return packet;
+}
+
+struct Phase {
+	double cpuPercent;
+	vector<double> queueLatencies;
+	size_t messagesSent;
+	size_t messagesReceived;
+};
+
+Phase measure(vector<unique_ptr<Pair>> &pairs, const Options &options, bool load) {
+	ThreadPoolProbe probe;
+	probe.start();
+
+	size_t sent = 0;
+	size_t receivedBefore = received.load();
+	auto cpuStart = cpuTime();
+	auto start = steady_clock::now();
+	auto end = start + options.duration;
+
+	if (load) {
+		binary message(options.size);
+		const auto interval = microseconds(1000000 / std::max<size_t>(options.rate, 1));
+		auto next = start;
+		uint16_t seq = 0;
+		while (steady_clock::now() < end) {
+			++seq;
+			std::map<uint32_t, vector<shared_ptr<Track>>> fanoutTracks; // by SSRC
+			for (auto &pair : pairs) {
+				for (auto &dc : pair->channels) {
+					if (dc->isOpen()) {
+						dc->send(message);
+						++sent;
+					}
+				}
+				for (auto &track : pair->tracks) {
+					if (!track->isOpen())
+						continue;
+
+					auto ssrcs = track->description().getSSRCs();
+					const uint32_t ssrc = ssrcs.empty() ? 0 : ssrcs[0];
+					if (options.fanout) {
+						fanoutTracks[ssrc].push_back(track);
+						continue;
+					}
+
+					auto packet = makeRtpPacket(ssrc, options.size);
+					reinterpret_cast<RtpHeader *>(packet.data())->setSeqNumber(seq);
+					track->send(std::move(packet));
+					++sent;
+				}
+			}
+			for (auto &[ssrc, tracks] : fanoutTracks) {
+				auto packet = makeRtpPacket(ssrc, options.size);
+				reinterpret_cast<RtpHeader *>(packet.data())->setSeqNumber(seq);
+				Track::Fanout(tracks, std::move(packet));
+				sent += tracks.size();
+			}
+			next += interval;
+			std::this_thread::sleep_until(next);
+		}
+	} else {
+		std::this_thread::sleep_until(end);
+	}
+
+	auto elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+	auto cpu = cpuTime() - cpuStart;
+	return Phase{100. * double(cpu.count()) / double(std::max<int64_t>(elapsed.count(), 1)),
+	             probe.stop(), sent, received.load() - receivedBefore};
+}
+
+string phaseJson(const Phase &phase) {
+	std::ostringstream oss;
+	oss << fixed << setprecision(2) << "{\"cpu_percent\": " << phase.cpuPercent
+	    << ", \"messages_sent\": " << phase.messagesSent
+	    << ", \"messages_received\": " << phase.messagesReceived
+	    << ", \"threadpool_latency_us\": " << percentilesJson(phase.queueLatencies) << "}";
+	return oss.str();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		auto value = [&]() -> size_t {
+			if (i + 1 >= argc)
+				throw invalid_argument("Missing value for " + arg);
+			return std::stoul(argv[++i]);
+		};
+		try {
+			if (arg == "--pairs")
+				options.pairs = value();
+			else if (arg == "--channels")
+				options.channels = value();
+			else if (arg == "--tracks")
+				options.tracks = value();
+			else if (arg == "--concurrency")
+				options.concurrency = std::max<size_t>(value(), 1);
+			else if (arg == "--duration")
+				options.duration = chrono::seconds(value());
+			else if (arg == "--rate")
+				options.rate = value();
+			else if (arg == "--size")
+				options.size = value();
+			else if (arg == "--certificate-pool")
+				options.certificatePool = value();
+			else if (arg == "--certificate-lifetime")
+				options.certificateLifetime = chrono::seconds(value());
+			else if (arg == "--fanout")
+				options.fanout = true;
+			else if (arg == "--srtp-profile" && i + 1 < argc) {
+				string name = argv[++i];
+				if (name == "cm80")
+					options.srtpProfiles = {SrtpProfile::Aes128CmHmacSha1_80};
+				else if (name == "cm32")
+					options.srtpProfiles = {SrtpProfile::Aes128CmHmacSha1_32};
+				else if (name == "gcm128")
+					options.srtpProfiles = {SrtpProfile::AeadAes128Gcm};
+				else if (name == "gcm256")
+					options.srtpProfiles = {SrtpProfile::AeadAes256Gcm};
+				else
+					throw invalid_argument("Unknown SRTP profile " + name);
+			} else if (arg == "--output" && i + 1 < argc)
+				options.output = argv[++i];
+			else
+				throw invalid_argument("Unknown argument " + arg);
+
+		} catch (const exception &e) {
+			cerr << e.what() << endl;
+			cerr << "Usage: " << argv[0]
+			     << " [--pairs <n>] [--channels <n>] [--tracks <n>] [--concurrency <n>]"
+			     << " [--duration <s>] [--rate <messages/s>] [--size <bytes>]"
+			     << " [--certificate-pool <n>] [--certificate-lifetime <s>] [--fanout]"
+			     << " [--srtp-profile <cm80|cm32|gcm128|gcm256>] [--output <file>]"
+			     << endl;
+			return 1;
+		}
+	}
+
+	if (options.channels + options.tracks == 0) {
+		cerr << "At least one data channel or track per pair is required" << endl;
+		return 1;
+	}
+
+	try {
+		rtc::InitLogger(LogLevel::Error);
+		rtc::Preload();
+
+		CertificateCacheSettings certificateCacheSettings;
+		certificateCacheSettings.poolSize = options.certificatePool;
+		certificateCacheSettings.lifetime = options.certificateLifetime;
+		SetCertificateCacheSettings(certificateCacheSettings);
+
+		const size_t baselineRss = residentSetSize();
+		const size_t baselineThreads = threadCount();
+
+		// Setup with bounded concurrency
+		cerr << "Setting up " << options.pairs << " peer pairs..." << endl;
+		vector<unique_ptr<Pair>> pairs;
+		pairs.reserve(options.pairs);
+		auto setupStart = steady_clock::now();
+		const auto setupTimeout = 30s;
+		size_t next = 0;
+		while (true) {
+			size_t inProgress = 0;
+			for (const auto &pair : pairs)
+				if (pair->setupMs < 0. && steady_clock::now() - pair->start < setupTimeout)
+					++inProgress;
+
+			if (next == options.pairs && inProgress == 0)
+				break;
+
+			while (next < options.pairs && inProgress < options.concurrency) {
+				auto pair = std::make_unique<Pair>();
+				setup(*pair, next++, options);
+				pairs.push_back(std::move(pair));
+				++inProgress;
+			}
+
+			std::this_thread::sleep_for(10ms);
+		}
+		auto setupDuration = duration_cast<milliseconds>(steady_clock::now() - setupStart);
+
+		vector<double> setupTimes;
+		for (const auto &pair : pairs)
+			if (pair->setupMs >= 0.)
+				setupTimes.push_back(pair->setupMs);
+
+		const size_t connectedRss = residentSetSize();
+		const size_t connectedThreads = threadCount();
+		const size_t connections = 2 * pairs.size();
+		cerr << setupTimes.size() << "/" << pairs.size() << " pairs connected in "
+		     << setupDuration.count() << "ms" << endl;
+
+		cerr << "Measuring idle state..." << endl;
+		auto idle = measure(pairs, options, false);
+
+		cerr << "Measuring under load..." << endl;
+		auto load = measure(pairs, options, true);
+
+		std::ostringstream json;
+		json << fixed << setprecision(2);
+		json << "{\n";
+		json << "  \"version\": \"" << RTC_VERSION << "\",\n";
+		json << "  \"pairs\": " << pairs.size() << ",\n";
+		json << "  \"peer_connections\": " << connections << ",\n";
+		json << "  \"channels_per_pair\": " << options.channels << ",\n";
+		json << "  \"tracks_per_pair\": " << options.tracks << ",\n";
+		json << "  \"connected_pairs\": " << setupTimes.size() << ",\n";
+		json << "  \"setup_duration_ms\": " << setupDuration.count() << ",\n";
+		json << "  \"setup_time_ms\": " << percentilesJson(setupTimes) << ",\n";
+		json << "  \"rss_bytes_baseline\": " << baselineRss << ",\n";
+		json << "  \"rss_bytes_connected\": " << connectedRss << ",\n";
+		json << "  \"rss_bytes_per_connection\": "
+		     << (connections > 0 && connectedRss > baselineRss
+		             ? (connectedRss - baselineRss) / connections
+		             : 0)
+		     << ",\n";
+		json << "  \"threads_baseline\": " << baselineThreads << ",\n";
+		json << "  \"threads_connected\": " << connectedThreads << ",\n";
+		auto certificateCacheStats = GetCertificateCacheStats();
+		json << "  \"certificate_cache_hits\": " << certificateCacheStats.hits << ",\n";
+		json << "  \"certificate_cache_misses\": " << certificateCacheStats.misses << ",\n";
+		auto cryptoStats = GetCryptoStats();
+		json << "  \"crypto_tasks\": " << cryptoStats.tasks << ",\n";
+		json << "  \"crypto_queue_wait_us_avg\": " << cryptoStats.averageQueueWait.count() << ",\n";
+		json << "  \"crypto_queue_wait_us_max\": " << cryptoStats.maxQueueWait.count() << ",\n";
+		json << "  \"idle\": " << phaseJson(idle) << ",\n";
+		json << "  \"load\": " << phaseJson(load) << "\n";
+		json << "}\n";
+
+		if (options.output.empty()) {
+			cout << json.str();
+		} else {
+			std::ofstream file(options.output);
+			if (!file)
+				throw runtime_error("Unable to open " + options.output);
+			file << json.str();
+		}
+
+		cerr << "Closing..." << endl;
+		for (auto &pair : pairs) {
+			pair->pc1->close();
+			pair->pc2->close();
+		}
+		pairs.clear();
+
+	} catch (const exception &e) {
+		cerr << "Scale benchmark failed: " << e.what() << endl;
+		return -1;
+	}
+
+	if (rtc::Cleanup().wait_for(30s) == future_status::timeout) {
+		cerr << "Cleanup timeout" << endl;
+		return -1;
+	}
+
+	return 0;
+}
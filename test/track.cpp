@@ -118,6 +118,16 @@ void test_track() {
 	if (!at2 || !at2->isOpen() || !t1->isOpen())
 		throw runtime_error("Track is not open");
 
+	// Test that dropping one of two handles on the same mid does not close the track
+	{
+		auto other = pc2.addTrack(at2->description());
+		if (other->mid() != at2->mid() || !other->isOpen())
+			throw runtime_error("Track with the same mid is not shared");
+	}
+
+	if (!at2->isOpen())
+		throw runtime_error("Track is closed after dropping another handle");
+
 	// Test renegotiation
 	newTrackMid = "added";
 
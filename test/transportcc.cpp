@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2024 Paul-Louis Ageneau
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "rtc/rtc.hpp"
+
+#include "impl/rtpextension.hpp"
+#include "impl/transportccfeedback.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace rtc;
+using namespace std;
+using namespace chrono_literals;
+
+using impl::TransportCcFeedback;
+
+namespace {
+
+uint16_t first_chunk(const message_ptr &message) {
+	auto p = reinterpret_cast<const uint8_t *>(message->data()) + sizeof(RtcpFbHeader) + 8;
+	return uint16_t((p[0] << 8) | p[1]);
+}
+
+// Encodes then decodes the feedback, and returns the first packet chunk
+uint16_t round_trip(const TransportCcFeedback &feedback) {
+	auto message = impl::MakeTransportCcFeedback(1234, feedback);
+	if (message->size() % 4 != 0)
+		throw runtime_error("Transport-wide feedback is not padded");
+
+	auto parsed = impl::ParseTransportCcFeedback(message->data(), message->size());
+	if (!parsed)
+		throw runtime_error("Transport-wide feedback failed to parse");
+
+	if (parsed->baseSequenceNumber != feedback.baseSequenceNumber ||
+	    parsed->referenceTime != feedback.referenceTime ||
+	    parsed->feedbackCount != feedback.feedbackCount)
+		throw runtime_error("Transport-wide feedback header mismatch");
+
+	if (parsed->arrivals != feedback.arrivals)
+		throw runtime_error("Transport-wide feedback arrivals mismatch");
+
+	return first_chunk(message);
+}
+
+} // namespace
+
+void test_transportcc() {
+	InitLogger(LogLevel::Debug);
+
+	// Runs of received then lost packets are encoded as run-length chunks
+	{
+		TransportCcFeedback feedback;
+		feedback.baseSequenceNumber = 100;
+		feedback.referenceTime = 10;
+		feedback.feedbackCount = 1;
+		auto arrival = 640ms + 0us;
+		for (int i = 0; i < 20; ++i)
+			feedback.arrivals.push_back(arrival += 1ms);
+		for (int i = 0; i < 10; ++i)
+			feedback.arrivals.push_back(nullopt);
+		feedback.arrivals.push_back(arrival += 5ms);
+
+		if (round_trip(feedback) & 0x8000)
+			throw runtime_error("Expected a run-length chunk");
+	}
+
+	// Alternating small deltas and losses are encoded as 1-bit status vectors
+	{
+		TransportCcFeedback feedback;
+		feedback.baseSequenceNumber = 200;
+		feedback.referenceTime = 20;
+		feedback.feedbackCount = 2;
+		auto arrival = 1280ms + 0us;
+		for (int i = 0; i < 30; ++i)
+			feedback.arrivals.push_back(i % 3 ? optional(arrival += 250us) : nullopt);
+
+		if ((round_trip(feedback) & 0xC000) != 0x8000)
+			throw runtime_error("Expected a 1-bit status vector chunk");
+	}
+
+	// Large and negative deltas are encoded as 2-bit status vectors
+	{
+		TransportCcFeedback feedback;
+		feedback.baseSequenceNumber = 300;
+		feedback.referenceTime = 30;
+		feedback.feedbackCount = 3;
+		auto arrival = 1920ms + 0us;
+		feedback.arrivals.push_back(arrival += 100ms); // more than 255 * 250us
+		feedback.arrivals.push_back(arrival -= 2ms);   // reordered
+		feedback.arrivals.push_back(nullopt);
+		feedback.arrivals.push_back(arrival += 1ms);
+		feedback.arrivals.push_back(arrival += 8s); // the largest possible delta is about 8.2s
+		feedback.arrivals.push_back(arrival -= 8s);
+
+		if ((round_trip(feedback) & 0xC000) != 0xC000)
+			throw runtime_error("Expected a 2-bit status vector chunk");
+	}
+
+	// Sequence numbers wrap around and the reference time is signed
+	{
+		TransportCcFeedback feedback;
+		feedback.baseSequenceNumber = 65530;
+		feedback.referenceTime = -2;
+		feedback.feedbackCount = 255;
+		auto arrival = -128ms + 0us;
+		for (int i = 0; i < 12; ++i)
+			feedback.arrivals.push_back(i == 6 ? nullopt : optional(arrival += 500us));
+
+		round_trip(feedback);
+	}
+
+	// End to end, feedback stays contiguous when transport-wide sequence numbers wrap around
+	{
+		Description::Video video("0");
+		video.addExtMap(Description::Entry::ExtMap(
+		    3, "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01"));
+
+		auto sender = make_shared<TransportCcSender>();
+		auto receiver = make_shared<TransportCcReceiver>(0ms);
+		sender->media(video);
+		receiver->media(video);
+
+		optional<uint16_t> expected;
+		size_t reported = 0;
+		for (int i = 0; i < 70000; ++i) {
+			auto packet = make_message(sizeof(RtpHeader) + 100);
+			auto rtp = reinterpret_cast<RtpHeader *>(packet->data());
+			rtp->preparePacket();
+			rtp->setPayloadType(96);
+			rtp->setSsrc(42);
+			rtp->setSeqNumber(uint16_t(i));
+
+			message_vector messages{packet};
+			sender->outgoing(messages, [](message_ptr) {});
+
+			message_vector feedbacks;
+			receiver->incoming(messages, [&](message_ptr m) { feedbacks.push_back(m); });
+			for (const auto &message : feedbacks) {
+				auto parsed = impl::ParseTransportCcFeedback(message->data(), message->size());
+				if (!parsed)
+					throw runtime_error("Transport-wide feedback failed to parse");
+
+				if (expected && parsed->baseSequenceNumber != *expected)
+					throw runtime_error("Transport-wide feedback is not contiguous");
+
+				for (const auto &arrival : parsed->arrivals)
+					if (!arrival)
+						throw runtime_error("Transport-wide feedback reports a lost packet");
+
+				expected = uint16_t(parsed->baseSequenceNumber + parsed->arrivals.size());
+				reported += parsed->arrivals.size();
+			}
+
+			sender->incoming(feedbacks, [](message_ptr) {});
+		}
+
+		if (reported != 70000)
+			throw runtime_error("Transport-wide feedback is missing packets");
+
+		if (!sender->targetBitrate())
+			throw runtime_error("No target bitrate");
+	}
+
+	// Packetizers reserve the extensions, then the sender shared by tracks numbers their packets
+	{
+		Description::Video video("0");
+		video.addExtMap(Description::Entry::ExtMap(
+		    3, "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01"));
+		video.addExtMap(Description::Entry::ExtMap(
+		    4, "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time"));
+
+		auto sender = make_shared<TransportCcSender>();
+		sender->media(video);
+
+		vector<shared_ptr<RtpPacketizer>> packetizers;
+		for (SSRC ssrc : {42, 43}) {
+			auto rtpConfig = make_shared<RtpPacketizationConfig>(ssrc, "cname", 96, 90000);
+			rtpConfig->transportCcId = 3;
+			rtpConfig->absSendTimeId = 4;
+			packetizers.push_back(make_shared<H264RtpPacketizer>(
+			    NalUnit::Separator::LongStartSequence, rtpConfig));
+		}
+
+		vector<uint16_t> numbers;
+		for (int i = 0; i < 4; ++i) {
+			binary frame = {byte(0), byte(0), byte(0), byte(1), byte(0x65), byte(1), byte(2)};
+			message_vector messages{make_message(frame.begin(), frame.end())};
+			packetizers[i % 2]->outgoing(messages, [](message_ptr) {});
+			sender->outgoing(messages, [](message_ptr) {});
+			for (const auto &message : messages) {
+				auto found = impl::FindRtpExtension(message->data(), message->size(), 3);
+				if (!found || found->second != 2)
+					throw runtime_error("Transport-wide sequence number is missing");
+
+				auto value = reinterpret_cast<const uint8_t *>(message->data() + found->first);
+				numbers.push_back(uint16_t((value[0] << 8) | value[1]));
+
+				if (!impl::FindRtpExtension(message->data(), message->size(), 4))
+					throw runtime_error("Absolute send time is missing");
+			}
+		}
+
+		if (numbers != vector<uint16_t>{0, 1, 2, 3})
+			throw runtime_error("Transport-wide sequence numbers are not shared by tracks");
+	}
+
+	// A pacer and a sender shared by two tracks are linked once when adding them to both chains
+	{
+		auto pacer = make_shared<PacingHandler>(1000000, 5ms);
+		auto sender = make_shared<TransportCcSender>();
+		vector<shared_ptr<MediaHandler>> chains;
+		for (int i = 0; i < 2; ++i) {
+			auto chain = make_shared<MediaHandler>();
+			chain->addToChain(pacer);
+			chain->addToChain(sender);
+			chains.push_back(chain);
+		}
+
+		for (const auto &chain : chains)
+			if (chain->next() != pacer)
+				throw runtime_error("Shared pacer is not linked");
+
+		if (pacer->next() != sender || sender->next())
+			throw runtime_error("Shared handlers are linked more than once");
+	}
+
+	// Packets dropped by the pacer are not retransmitted by the NACK responder preceding it
+	{
+		auto responder = make_shared<RtcpNackResponder>();
+		auto pacer = make_shared<PacingHandler>(8000, 1ms); // 1000 bytes per second
+		pacer->setMaxQueueDelay(20ms);
+		responder->addToChain(pacer);
+
+		auto send = [&](uint16_t seq) {
+			auto packet = make_message(sizeof(RtpHeader) + 1000);
+			auto rtp = reinterpret_cast<RtpHeader *>(packet->data());
+			rtp->preparePacket();
+			rtp->setPayloadType(96);
+			rtp->setSsrc(42);
+			rtp->setSeqNumber(seq);
+			rtp->setTimestamp(seq * 3000);
+			message_vector messages{packet};
+			responder->outgoingChain(messages, [](message_ptr) {});
+		};
+
+		for (uint16_t seq = 0; seq < 10; ++seq)
+			send(seq); // the first one is sent, the others wait in queue
+
+		this_thread::sleep_for(50ms);
+		send(10); // the queued packets are now stale
+		const size_t queued = pacer->queuedBytes();
+
+		auto message = make_message(RtcpNack::Size(1), Message::Control);
+		auto nack = reinterpret_cast<RtcpNack *>(message->data());
+		nack->preparePacket(42, 1);
+		unsigned int fciCount = 0;
+		uint16_t fciPid = 0;
+		for (uint16_t seq = 1; seq < 10; ++seq)
+			nack->addMissingPacket(&fciCount, &fciPid, seq);
+
+		message_vector messages{message};
+		responder->incoming(messages, [](message_ptr) {});
+		if (pacer->queuedBytes() != queued)
+			throw runtime_error("Packets dropped by the pacer were retransmitted");
+	}
+
+	cout << "Transport-wide congestion control test successful" << endl;
+}